@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+
+/**
+ * @file bench/bench_connection_options.cpp
+ * @brief Connection Options Preset Benchmark
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Builds a large synthetic logbook with each connection_options preset and
+ * times three workloads on it:
+ *
+ * - import: bulk_import() of all dives and profiles, 500 dives per batch
+ * - commit: load, modify and commit single dives one transaction at a time
+ * - scan: load every dive, then read every raw profile blob
+ *
+ * The read_only_analytics() preset cannot create a logbook, so it only runs
+ * the scan workload against the logbook built with the default options.
+ *
+ * Usage: bench_connection_options [dives] [raw profile KiB] [directory]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <benthos/logbook/logbook.hpp>
+#include <benthos/logbook/dive.hpp>
+#include <benthos/logbook/dive_site.hpp>
+#include <benthos/logbook/profile.hpp>
+
+using namespace benthos::logbook;
+
+typedef std::chrono::steady_clock bench_clock;
+
+//! @return Milliseconds elapsed since the Start Time
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+//! Remove a Logbook File and its WAL and Shared Memory Files
+static void remove_logbook(const std::string & filename)
+{
+	std::remove(filename.c_str());
+	std::remove((filename + "-wal").c_str());
+	std::remove((filename + "-shm").c_str());
+}
+
+//! Build a Synthetic Dive Profile with one Waypoint every 10 Seconds
+static std::list<waypoint> make_waypoints(int duration, double max_depth)
+{
+	std::list<waypoint> result;
+	for (int t = 0; t <= duration; t += 10)
+	{
+		waypoint w;
+		w.time = t;
+		w.data["depth"] = max_depth * (t < duration / 2 ? 2.0 * t / duration : 2.0 * (duration - t) / duration);
+		w.data["temperature"] = 24.0 - w.data["depth"] / 10.0;
+		result.push_back(w);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Import Workload
+ * @return Imported Dive Identifiers
+ *
+ * Imports n_dives dives, each with one profile carrying raw_kb KiB of raw
+ * data, spread over 50 dive sites.
+ */
+static std::vector<int64_t> run_import(Logbook::Ptr lb, int n_dives, int raw_kb, double & ms)
+{
+	const int batch_size = 500;
+	const time_t base = 1300000000;
+
+	std::vector<DiveSite::Ptr> sites;
+	for (int i = 0; i < 50; i++)
+	{
+		DiveSite::Ptr site(new DiveSite);
+		site->setName("Site " + std::to_string(i));
+		sites.push_back(site);
+	}
+
+	std::vector<unsigned char> raw(raw_kb * 1024);
+	for (size_t i = 0; i < raw.size(); i++)
+		raw[i] = (unsigned char)(i * 31);
+
+	std::vector<int64_t> ids;
+	std::vector<Dive::Ptr> dives;
+	bench_clock::time_point start = bench_clock::now();
+
+	for (int i = 0; i < n_dives; )
+	{
+		AbstractMapper::Batch batch;
+		dives.clear();
+
+		for (int j = 0; (j < batch_size) && (i < n_dives); j++, i++)
+		{
+			Dive::Ptr d(new Dive);
+			d->setDateTime(base + i * 28800);
+			d->setDuration(2700);
+			d->setMaxDepth(10.0 + (i % 30));
+			d->setSite(sites[i % sites.size()]);
+
+			Profile::Ptr p(new Profile);
+			p->setDive(d);
+			p->setImported(base + i * 28800);
+			p->setProfile(make_waypoints(2700, d->max_depth()));
+			p->setRawProfile(raw);
+
+			batch.push_back(d);
+			batch.push_back(p);
+			dives.push_back(d);
+		}
+
+		lb->session()->bulk_import(batch);
+
+		std::vector<Dive::Ptr>::const_iterator it;
+		for (it = dives.begin(); it != dives.end(); it++)
+			ids.push_back((* it)->id());
+	}
+
+	ms = elapsed_ms(start);
+	return ids;
+}
+
+/**
+ * @brief Commit Workload
+ * @return Commits per Second
+ *
+ * Loads, modifies and commits n_commits dives in separate transactions,
+ * which is dominated by the journal and synchronous settings.
+ */
+static double run_commits(Logbook::Ptr lb, const std::vector<int64_t> & ids, int n_commits)
+{
+	Session::Ptr s = lb->session();
+	bench_clock::time_point start = bench_clock::now();
+
+	for (int i = 0; i < n_commits; i++)
+	{
+		Dive::Ptr d = s->finder<Dive>()->find(ids[(i * 7919) % ids.size()]);
+		d->setRating(i % 5);
+		s->commit();
+	}
+
+	return n_commits / (elapsed_ms(start) / 1000.0);
+}
+
+/**
+ * @brief Scan Workload
+ * @return Milliseconds taken
+ *
+ * Loads every dive through the Dive finder in a fresh Session, then reads
+ * every raw profile blob, which is dominated by the page cache and memory
+ * map settings.
+ */
+static double run_scan(Logbook::Ptr lb)
+{
+	bench_clock::time_point start = bench_clock::now();
+
+	Session::Ptr s = Session::Create(lb->connection());
+	std::vector<Dive::Ptr> dives = s->finder<Dive>()->find();
+
+	size_t n_bytes = 0;
+	dbapi::statement::ptr stmt = lb->connection()->prepare("select raw_profile from profiles");
+	dbapi::cursor::ptr c = stmt->exec();
+	for ( ; ! c->at_end(); c->next())
+		n_bytes += c->current().blob(0).size;
+
+	return elapsed_ms(start);
+}
+
+int main(int argc, char ** argv)
+{
+	int n_dives = (argc > 1) ? atoi(argv[1]) : 5000;
+	int raw_kb = (argc > 2) ? atoi(argv[2]) : 16;
+	std::string dir = (argc > 3) ? argv[3] : ".";
+	int n_commits = 200;
+
+	if ((n_dives <= 0) || (raw_kb < 0))
+	{
+		fprintf(stderr, "Usage: %s [dives] [raw profile KiB] [directory]\n", argv[0]);
+		return 1;
+	}
+
+	struct preset_t
+	{
+		const char *				name;
+		dbapi::connection_options	options;
+	};
+
+	preset_t presets[] = {
+		{ "default", dbapi::connection_options() },
+		{ "bulk_import", dbapi::connection_options::bulk_import() },
+		{ "interactive", dbapi::connection_options::interactive() },
+	};
+
+	printf("%d dives, %d KiB raw profile each, %d single-dive commits\n\n", n_dives, raw_kb, n_commits);
+	printf("%-20s %12s %12s %12s\n", "preset", "import [ms]", "commits/s", "scan [ms]");
+
+	try
+	{
+		std::string baseline;
+		for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++)
+		{
+			std::string filename = dir + "/bench_" + presets[i].name + ".lbk";
+			remove_logbook(filename);
+
+			double import_ms = 0;
+			std::vector<int64_t> ids;
+			double commits = 0;
+			double scan_ms = 0;
+
+			{
+				Logbook::Ptr lb = Logbook::Create(filename, "bench", 0, presets[i].options);
+				ids = run_import(lb, n_dives, raw_kb, import_ms);
+				commits = run_commits(lb, ids, n_commits);
+			}
+
+			{
+				Logbook::Ptr lb = Logbook::Open(filename, presets[i].options);
+				scan_ms = run_scan(lb);
+			}
+
+			printf("%-20s %12.1f %12.1f %12.1f\n", presets[i].name, import_ms, commits, scan_ms);
+
+			if (i == 0)
+				baseline = filename;
+			else
+				remove_logbook(filename);
+		}
+
+		{
+			Logbook::Ptr lb = Logbook::Open(baseline, dbapi::connection_options::read_only_analytics());
+			double scan_ms = run_scan(lb);
+			printf("%-20s %12s %12s %12.1f\n", "read_only_analytics", "-", "-", scan_ms);
+		}
+
+		remove_logbook(baseline);
+	}
+	catch (std::exception & e)
+	{
+		fprintf(stderr, "Benchmark failed: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
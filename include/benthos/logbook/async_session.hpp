@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef LOGBOOK_ASYNC_SESSION_HPP_
+#define LOGBOOK_ASYNC_SESSION_HPP_
+
+/**
+ * @file include/benthos/logbook/async_session.hpp
+ * @brief Asynchronous Session and Finder Classes
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <ctime>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <benthos/logbook/dbapi.hpp>
+#include <benthos/logbook/country.hpp>
+#include <benthos/logbook/dive.hpp>
+#include <benthos/logbook/dive_site.hpp>
+#include <benthos/logbook/persistent.hpp>
+#include <benthos/logbook/session.hpp>
+
+namespace benthos { namespace logbook {
+
+/**
+ * @brief Asynchronous Finder Class
+ *
+ * Wraps a finder interface so that its lookups run on the executor thread of
+ * an AsyncSession and return std::future results.  The find() methods of
+ * IFinder<D> are exposed directly; any other finder method can be run with
+ * call().
+ *
+ * The lazy references of the objects returned by find() (see
+ * Persistent::reference_names()) are resolved on the executor before the
+ * future is fulfilled, so getters such as Dive::site() do not touch the
+ * Session from the caller's thread.  Results of call() are not resolved.
+ */
+template <class D, class F = IFinder<D> >
+class AsyncFinder
+{
+public:
+	typedef boost::shared_ptr<AsyncFinder<D, F> >	Ptr;
+	typedef boost::shared_ptr<F>					FinderPtr;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Finder belonging to the Executor's Session
+	 * @param[in] Executor
+	 */
+	AsyncFinder(FinderPtr finder, dbapi::executor::ptr ex)
+		: m_finder(finder), m_executor(ex)
+	{
+	}
+
+	//! Class Destructor
+	virtual ~AsyncFinder()
+	{
+	}
+
+public:
+
+	/**
+	 * @brief Run a Finder Method on the Executor
+	 * @param[in] Function which is passed the Finder
+	 * @return Future for the Result
+	 */
+	template <typename R>
+	std::future<R> call(boost::function<R (FinderPtr)> fn)
+	{
+		return m_executor->submit<R>(boost::bind(fn, m_finder));
+	}
+
+	//! @return Future List of all Mapped Objects
+	std::future<std::vector<typename D::Ptr> > find()
+	{
+		typedef std::vector<typename D::Ptr> (IFinder<D>::*pmf_t)();
+		return m_executor->submit<std::vector<typename D::Ptr> >(boost::bind(& AsyncFinder::resolved,
+			boost::bind(static_cast<pmf_t>(& IFinder<D>::find), m_finder)));
+	}
+
+	//! @return Future Mapped Object with the given Id
+	std::future<typename D::Ptr> find(int64_t id)
+	{
+		typedef typename D::Ptr (IFinder<D>::*pmf_t)(int64_t);
+		return m_executor->submit<typename D::Ptr>(boost::bind(& AsyncFinder::resolvedOne,
+			boost::bind(static_cast<pmf_t>(& IFinder<D>::find), m_finder, id)));
+	}
+
+protected:
+
+	/**
+	 * @brief Resolve the Lazy References of Loaded Objects
+	 * @param[in] Objects loaded on the Executor
+	 * @return The same Objects
+	 *
+	 * Runs on the executor thread, as part of the task which loaded the
+	 * objects.
+	 */
+	static std::vector<typename D::Ptr> resolved(const std::vector<typename D::Ptr> & objects)
+	{
+		if (! objects.empty() && objects.front() && objects.front()->session())
+			objects.front()->session()->prefetch(AbstractMapper::Batch(objects.begin(), objects.end()));
+		return objects;
+	}
+
+	//! @return Object with its Lazy References resolved
+	static typename D::Ptr resolvedOne(typename D::Ptr object)
+	{
+		resolved(std::vector<typename D::Ptr>(1, object));
+		return object;
+	}
+
+protected:
+	FinderPtr				m_finder;		///< Synchronous Finder
+	dbapi::executor::ptr	m_executor;		///< Executor
+
+};
+
+/**
+ * @brief Asynchronous Dive Finder
+ *
+ * Asynchronous counterpart of IDiveFinder.
+ */
+class AsyncDiveFinder: public AsyncFinder<Dive, IDiveFinder>
+{
+public:
+	typedef boost::shared_ptr<AsyncDiveFinder>	Ptr;
+
+public:
+
+	//! Class Constructor
+	AsyncDiveFinder(IDiveFinder::Ptr finder, dbapi::executor::ptr ex);
+
+	//! Class Destructor
+	virtual ~AsyncDiveFinder();
+
+public:
+	std::future<std::vector<std::string> > allTags();
+	std::future<unsigned int> countByComputer(int64_t computer_id);
+	std::future<unsigned int> countBySite(int64_t site_id);
+	std::future<std::vector<Dive::Ptr> > findRecentlyImported(unsigned int days, int max, const dbapi::cancellation_token & token = dbapi::cancellation_token());
+	std::future<std::vector<Dive::Ptr> > findByComputer(int64_t computer_id);
+	std::future<std::vector<Dive::Ptr> > findByCountry(const country & country_, const dbapi::cancellation_token & token = dbapi::cancellation_token());
+	std::future<std::vector<Dive::Ptr> > findByDates(time_t start, time_t end, const dbapi::cancellation_token & token = dbapi::cancellation_token());
+	std::future<std::vector<Dive::Ptr> > findBySite(int64_t site_id);
+	std::future<boost::optional<double> > avgDepthForSite(int64_t site_id);
+	std::future<boost::optional<double> > avgTempForSite(int64_t site_id);
+	std::future<boost::optional<double> > maxDepthForSite(int64_t site_id);
+	std::future<boost::optional<double> > ratingForSite(int64_t site_id);
+
+};
+
+/**
+ * @brief Asynchronous Dive Site Finder
+ *
+ * Asynchronous counterpart of IDiveSiteFinder.
+ */
+class AsyncDiveSiteFinder: public AsyncFinder<DiveSite, IDiveSiteFinder>
+{
+public:
+	typedef boost::shared_ptr<AsyncDiveSiteFinder>	Ptr;
+
+public:
+
+	//! Class Constructor
+	AsyncDiveSiteFinder(IDiveSiteFinder::Ptr finder, dbapi::executor::ptr ex);
+
+	//! Class Destructor
+	virtual ~AsyncDiveSiteFinder();
+
+public:
+	std::future<std::vector<country> > countries();
+	std::future<std::vector<std::string> > bottomValues();
+	std::future<std::vector<std::string> > platformValues();
+	std::future<std::vector<std::string> > waterBodyValues();
+
+};
+
+/**
+ * @brief Asynchronous Session Class
+ *
+ * Binds a Session to a dbapi::executor so that all database access through
+ * the Session happens on the executor's worker thread.  Lookups are made
+ * through the asynchronous finders, which return futures, or by submitting
+ * arbitrary work with submit().
+ *
+ * Objects returned through the futures belong to the wrapped Session.  Their
+ * lazy references are resolved on the executor, so they may be read freely
+ * from the caller's thread, but anything which loads further data through
+ * the Session (for instance Dive::profiles() or Profile::raw_profile()) must
+ * be done inside a task passed to submit().  The executor owns the Session's
+ * connection while the AsyncSession exists, so such loads from any other
+ * thread throw a dbapi_error rather than racing with queued tasks.
+ */
+class AsyncSession: public boost::noncopyable
+{
+public:
+	typedef boost::shared_ptr<AsyncSession>	Ptr;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Session to run on the Executor Thread
+	 *
+	 * Starts a new executor on the Session's connection.
+	 */
+	AsyncSession(Session::Ptr session);
+
+	//! Class Destructor; waits for pending tasks to complete
+	~AsyncSession();
+
+public:
+
+	//! @return Asynchronous Dive Finder
+	AsyncDiveFinder::Ptr diveFinder() const;
+
+	//! @return Asynchronous Dive Site Finder
+	AsyncDiveSiteFinder::Ptr diveSiteFinder() const;
+
+	//! @return Executor
+	inline dbapi::executor::ptr executor() const { return m_executor; }
+
+	/**
+	 * @brief Get an Asynchronous Finder for a Domain Model Class
+	 * @return Asynchronous Finder
+	 */
+	template <class D>
+	typename AsyncFinder<D>::Ptr finder() const
+	{
+		return typename AsyncFinder<D>::Ptr(new AsyncFinder<D>(m_session->finder<D>(), m_executor));
+	}
+
+	//! @return Wrapped Session
+	inline Session::Ptr session() const { return m_session; }
+
+	/**
+	 * @brief Run a Task against the Session on the Executor
+	 * @param[in] Function which is passed the Session
+	 * @return Future for the Result
+	 */
+	template <typename R>
+	std::future<R> submit(boost::function<R (Session::Ptr)> fn)
+	{
+		return m_executor->submit<R>(boost::bind(fn, m_session));
+	}
+
+private:
+	Session::Ptr			m_session;		///< Wrapped Session
+	dbapi::executor::ptr	m_executor;		///< Executor
+
+};
+
+} } /* benthos::logbook */
+
+#endif /* LOGBOOK_ASYNC_SESSION_HPP_ */
@@ -37,10 +37,21 @@
  * @author Jonathan Krauss <jkrauss@asymworks.com>
  */
 
+#include <benthos/logbook/dbapi/backup.hpp>
+#include <benthos/logbook/dbapi/blob.hpp>
+#include <benthos/logbook/dbapi/cancellation_token.hpp>
 #include <benthos/logbook/dbapi/connection.hpp>
+#include <benthos/logbook/dbapi/connection_options.hpp>
+#include <benthos/logbook/dbapi/connection_pool.hpp>
 #include <benthos/logbook/dbapi/cursor.hpp>
 #include <benthos/logbook/dbapi/dbapi_error.hpp>
+#include <benthos/logbook/dbapi/executor.hpp>
+#include <benthos/logbook/dbapi/function.hpp>
+#include <benthos/logbook/dbapi/profiler.hpp>
+#include <benthos/logbook/dbapi/row_view.hpp>
+#include <benthos/logbook/dbapi/snapshot.hpp>
 #include <benthos/logbook/dbapi/statement.hpp>
+#include <benthos/logbook/dbapi/statement_cache.hpp>
 #include <benthos/logbook/dbapi/variant.hpp>
 
 #endif /* LIBLOGBOOK_DBAPI_HPP_ */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_BACKUP_HPP_
+#define DBAPI_BACKUP_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/backup.hpp
+ * @brief DBAPI Online Backup Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <benthos/logbook/dbapi/connection.hpp>
+
+#include <sqlite3.h>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Online Backup Class
+ *
+ * Copies the contents of one database into another while the source
+ * database remains open and in use, wrapping the SQLite3 Online Backup API
+ * (sqlite3_backup_init() and friends).  The copy is made a few pages at a
+ * time by step(); the source is only locked while a step is running, so
+ * writers are blocked for at most one step and never for the whole copy.
+ * If the source is written by another connection between steps the backup
+ * restarts automatically, and writes made through the source connection
+ * itself are carried into the copy, so the finished copy is always a
+ * consistent snapshot of the source.
+ *
+ * Uses the RAII pattern: the backup is started by the constructor and
+ * released by finish() or the destructor.  Neither connection may be used
+ * from another thread while a step is running.
+ */
+class backup: public boost::noncopyable
+{
+public:
+	typedef boost::shared_ptr<backup>	ptr;
+
+	/**
+	 * @brief Backup Progress Handler Function
+	 *
+	 * The Progress Handler, if passed to run(), is invoked after each step of
+	 * the backup.  The first argument is the number of pages left to copy and
+	 * the second is the total number of pages in the source database.  If the
+	 * handler returns false, the backup is abandoned.
+	 */
+	typedef boost::function<bool (int, int)> progress_handler;
+
+	//! Default Number of Pages copied per Step
+	static const int default_pages = 64;
+
+	//! Default Time to sleep between Steps (milliseconds)
+	static const int default_sleep_ms = 10;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Destination Connection
+	 * @param[in] Source Connection
+	 * @param[in] Destination Database Name
+	 * @param[in] Source Database Name
+	 * @throws dbapi_error
+	 *
+	 * Starts a backup of the source database into the destination database,
+	 * whose existing contents will be replaced.  The destination connection
+	 * must not be used while the backup is in progress.
+	 */
+	backup(connection::ptr dest, connection::ptr src,
+		const std::string & dest_db = "main", const std::string & src_db = "main");
+
+	//! Class Destructor; abandons the Backup if it is not finished
+	~backup();
+
+	//! @return True if all Pages have been copied
+	bool done() const;
+
+	/**
+	 * @brief Release the Backup
+	 * @throws dbapi_error if the Backup failed
+	 *
+	 * Releases the resources associated with the backup.  If the backup is
+	 * not done, the destination is left partially written.
+	 */
+	void finish();
+
+	//! @return Total Number of Pages in the Source Database as of the last Step
+	int page_count() const;
+
+	//! @return Number of Pages left to copy as of the last Step
+	int remaining() const;
+
+	/**
+	 * @brief Run the Backup to Completion
+	 * @param[in] Number of Pages to copy per Step, or -1 for all at once
+	 * @param[in] Time to sleep between Steps in milliseconds
+	 * @param[in] Progress Handler
+	 * @return True if the Backup finished, False if the Handler abandoned it
+	 * @throws dbapi_error
+	 *
+	 * Steps the backup until every page has been copied, sleeping between
+	 * steps to let other connections write to the source database.  Steps
+	 * which find the source or destination locked are retried after the
+	 * sleep.  The backup is released with finish() when run() returns.
+	 */
+	bool run(int pages = default_pages, int sleep_ms = default_sleep_ms,
+		progress_handler h = progress_handler());
+
+	/**
+	 * @brief Copy the next Pages
+	 * @param[in] Number of Pages to copy, or -1 for all remaining Pages
+	 * @return True if all Pages have been copied
+	 * @throws dbapi_error
+	 *
+	 * Copies up to the given number of pages.  If the source or destination
+	 * database is locked, nothing is copied and false is returned so that
+	 * the step may be retried later.
+	 */
+	bool step(int pages = default_pages);
+
+private:
+	connection::ptr		m_dest;			///< Destination Connection
+	connection::ptr		m_src;			///< Source Connection
+	sqlite3_backup *	m_backup;		///< SQLite3 Backup Handle
+	bool				m_done;			///< All Pages copied
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_BACKUP_HPP_ */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_BLOB_HPP_
+#define DBAPI_BLOB_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/blob.hpp
+ * @brief DBAPI Incremental BLOB I/O Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <benthos/logbook/dbapi/connection.hpp>
+
+#include <sqlite3.h>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Incremental BLOB Handle
+ *
+ * Wraps an SQLite3 BLOB handle (sqlite3_blob_open) which gives random access
+ * to a single BLOB column value without reading it into memory through a
+ * prepared statement.  Large values can be streamed in pieces with read() and
+ * overwritten in place with write(); the size of a BLOB cannot be changed
+ * through the handle.
+ *
+ * Uses the RAII pattern like dbapi::connection; the handle is opened by the
+ * constructor and closed by the destructor.  If the row is modified or
+ * deleted while the handle is open, the handle expires and further reads or
+ * writes raise a dbapi_error with the SQLITE_ABORT error code.
+ */
+class blob: public boost::noncopyable
+{
+public:
+	typedef boost::shared_ptr<blob>		ptr;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Database Connection
+	 * @param[in] Table Name
+	 * @param[in] Column Name
+	 * @param[in] Row Identifier
+	 * @param[in] Open for Writing
+	 * @param[in] Database Name
+	 * @throws dbapi_error
+	 *
+	 * Opens the BLOB stored in the given table and column of the given row.
+	 * An error is thrown if the row does not exist or the column value is
+	 * not a BLOB or TEXT value (i.e. it is NULL).
+	 */
+	blob(connection::ptr conn, const std::string & table, const std::string & column,
+		int64_t rowid, bool writable = false, const std::string & db = "main");
+
+	//! Class Destructor; closes the BLOB Handle
+	~blob();
+
+	//! @return SQLite3 BLOB Handle
+	sqlite3_blob * handle();
+
+	/**
+	 * @brief Read from the BLOB
+	 * @param[out] Destination Buffer
+	 * @param[in] Number of Bytes to Read
+	 * @param[in] Offset from the Start of the BLOB
+	 * @return Number of Bytes Read
+	 * @throws dbapi_error
+	 *
+	 * Reads up to the given number of bytes starting at the given offset.
+	 * Reads which extend past the end of the BLOB are truncated, so a short
+	 * (or zero) count indicates the end of the BLOB.
+	 */
+	size_t read(void * buf, size_t n, size_t offset) const;
+
+	/**
+	 * @brief Read the entire BLOB
+	 * @return BLOB Data
+	 * @throws dbapi_error
+	 */
+	std::vector<unsigned char> read_all() const;
+
+	/**
+	 * @brief Move the Handle to a different Row
+	 * @param[in] Row Identifier
+	 * @throws dbapi_error
+	 *
+	 * Points the handle at the same column of a different row, which is
+	 * faster than opening a new handle.  If the new row cannot be opened
+	 * the handle is left unusable and subsequent reads and writes fail.
+	 */
+	void reopen(int64_t rowid);
+
+	//! @return Row Identifier
+	int64_t rowid() const;
+
+	//! @return BLOB Size in Bytes
+	size_t size() const;
+
+	/**
+	 * @brief Write to the BLOB
+	 * @param[in] Source Buffer
+	 * @param[in] Number of Bytes to Write
+	 * @param[in] Offset from the Start of the BLOB
+	 * @throws dbapi_error
+	 *
+	 * Overwrites the given range of the BLOB.  The handle must have been
+	 * opened for writing, and the range must lie within the existing BLOB
+	 * since writes cannot change its size.
+	 */
+	void write(const void * buf, size_t n, size_t offset);
+
+private:
+	connection::ptr		m_conn;			///< Database Connection
+	sqlite3_blob *		m_blob;			///< SQLite3 BLOB Handle
+	int64_t				m_rowid;		///< Row Identifier
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_BLOB_HPP_ */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_CANCELLATION_TOKEN_HPP_
+#define DBAPI_CANCELLATION_TOKEN_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/cancellation_token.hpp
+ * @brief DBAPI Cancellation Token Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <atomic>
+#include <chrono>
+
+#include <boost/shared_ptr.hpp>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Query Cancellation Token
+ *
+ * Signals that the database work it is attached to should be abandoned,
+ * either because cancel() was called or because its deadline has passed.
+ * Copies of a token share the same state, so a token can be handed to a
+ * query running on another thread and cancelled from the original thread;
+ * cancel() and is_cancelled() are thread-safe.
+ *
+ * Tokens are attached to a connection with a cancellation_scope, which
+ * makes the connection's progress handler interrupt the running statement
+ * once the token is cancelled.  A default-constructed token is never
+ * cancelled unless cancel() is called.
+ */
+class cancellation_token
+{
+public:
+	typedef std::chrono::steady_clock	clock_type;
+
+public:
+
+	//! Class Constructor; creates a Token without a Deadline
+	cancellation_token();
+
+	/**
+	 * @brief Create a Token with a Deadline
+	 * @param[in] Deadline
+	 * @return Cancellation Token
+	 *
+	 * The token is cancelled automatically once the deadline passes.
+	 */
+	static cancellation_token deadline(clock_type::time_point tp);
+
+	/**
+	 * @brief Create a Token with a Timeout
+	 * @param[in] Timeout in milliseconds from now
+	 * @return Cancellation Token
+	 */
+	static cancellation_token timeout(unsigned int ms);
+
+	//! @brief Cancel the Token (and all of its Copies)
+	void cancel();
+
+	//! @return True if the Token has a Deadline
+	bool has_deadline() const;
+
+	//! @return True if the Token was cancelled or its Deadline has passed
+	bool is_cancelled() const;
+
+private:
+
+	//! Shared Token State
+	struct state_t
+	{
+		std::atomic<bool>			cancelled;		///< Cancelled Flag
+		bool						has_deadline;	///< Deadline is set
+		clock_type::time_point		deadline;		///< Deadline
+	};
+
+	boost::shared_ptr<state_t>		m_state;		///< Shared Token State
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_CANCELLATION_TOKEN_HPP_ */
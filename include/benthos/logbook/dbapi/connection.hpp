@@ -37,16 +37,29 @@
  * @author Jonathan Krauss <jkrauss@asymworks.com>
  */
 
+#include <atomic>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 
+#include <benthos/logbook/dbapi/cancellation_token.hpp>
+#include <benthos/logbook/dbapi/function.hpp>
+#include <benthos/logbook/dbapi/profiler.hpp>
+#include <benthos/logbook/dbapi/statement_cache.hpp>
+
 #include <sqlite3.h>
 
 namespace benthos { namespace logbook { namespace dbapi {
 
 class cursor;
+class statement;
 
 /**
  * @brief Database Connection Class
@@ -100,6 +113,17 @@ public:
 	 */
 	typedef boost::function<int ()> commit_handler;
 
+	/**
+	 * @brief Database Committed Handler Function
+	 *
+	 * The Committed Handler, if registered with the connection, is invoked
+	 * after the sqlite3_step() call which committed a transaction has
+	 * returned, so the changes are visible to other connections.  Unlike the
+	 * Commit Handler it may use the connection, and it is not invoked if the
+	 * commit fails.
+	 */
+	typedef boost::function<void ()> committed_handler;
+
 	/**
 	 * @brief Database Rollback Hook Handler Function
 	 *
@@ -145,6 +169,32 @@ public:
 	 */
 	typedef boost::function<int (int, char const*, char const*, char const*, char const*)> authorize_handler;
 
+	/**
+	 * @brief Statement Trace Handler Function
+	 *
+	 * The Trace Handler, if registered with the connection, is invoked each
+	 * time a prepared statement finishes running (i.e. when it is reset or
+	 * finalized after being stepped).  The first argument is the prepared
+	 * statement, which may be inspected with sqlite3_sql() or
+	 * sqlite3_expanded_sql() but must not be stepped or reset.  The second
+	 * argument is the wall-clock time the statement ran for in nanoseconds.
+	 */
+	typedef boost::function<void (sqlite3_stmt *, int64_t)> trace_handler;
+
+	/**
+	 * @brief Query Progress Handler Function
+	 *
+	 * The Progress Handler, if registered with the connection, is invoked
+	 * periodically during long-running statements (every N virtual machine
+	 * instructions, see set_progress_handler()).  If the handler returns non-
+	 * zero, the running statement is interrupted and statement::step() will
+	 * raise an interrupted_error.  The handler must not use the connection.
+	 */
+	typedef boost::function<int ()> progress_handler;
+
+	//! Default Number of VM Instructions between Progress Handler Calls
+	static const int default_progress_ops = 1000;
+
 public:
 
 	/**
@@ -162,6 +212,18 @@ public:
 	 */
 	connection(const char * dbname = 0);
 
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Database Name or NULL for in-memory (temporary) database
+	 * @param[in] SQLite3 Open Flags (SQLITE_OPEN_READONLY, etc)
+	 * @throws sqlitekit::db_error
+	 *
+	 * Opens a new SQLite3 connection with sqlite3_open_v2() and the given
+	 * open flags.  This is used to open read-only connections to a database
+	 * file, for instance by dbapi::connection_pool.
+	 */
+	connection(const char * dbname, int flags);
+
 	/**
 	 * @brief Class Destructor
 	 *
@@ -173,9 +235,74 @@ public:
 	//! @brief Begin a Transaction
 	void begin();
 
+	/**
+	 * @brief Check that the Calling Thread may use the Connection
+	 * @throws dbapi_error if the Connection is owned by another Thread
+	 * @see set_owner_thread
+	 */
+	void check_thread() const;
+
 	//! @brief Commit the current Transaction
 	void commit();
 
+	/**
+	 * @brief Register an Aggregate SQL Function
+	 * @param[in] Function Name
+	 * @param[in] Number of Arguments, or -1 for any Number
+	 * @param[in] Aggregate Factory
+	 * @param[in] True if the Function always gives the same Result for the
+	 *   same Inputs
+	 * @throws dbapi_error
+	 * @see aggregate
+	 *
+	 * Registers an aggregate function with sqlite3_create_function_v2(),
+	 * replacing any function with the same name and number of arguments.
+	 * Functions cannot be registered while statements are running on the
+	 * connection.
+	 */
+	void create_aggregate(const std::string & name, int nargs, aggregate_factory f,
+		bool deterministic = true);
+
+	/**
+	 * @brief Register a Scalar SQL Function
+	 * @param[in] Function Name
+	 * @param[in] Number of Arguments, or -1 for any Number
+	 * @param[in] Function
+	 * @param[in] True if the Function always gives the same Result for the
+	 *   same Inputs
+	 * @throws dbapi_error
+	 * @see scalar_function
+	 *
+	 * Registers a scalar function with sqlite3_create_function_v2(),
+	 * replacing any function with the same name and number of arguments.
+	 * Deterministic functions may be used in indexes and are evaluated once
+	 * for constant arguments.  Functions cannot be registered while
+	 * statements are running on the connection.
+	 */
+	void create_function(const std::string & name, int nargs, scalar_function f,
+		bool deterministic = true);
+
+	/**
+	 * @brief Register a typed Scalar SQL Function
+	 * @param[in] Function Name
+	 * @param[in] Typed Function
+	 * @param[in] True if the Function always gives the same Result for the
+	 *   same Inputs
+	 * @throws dbapi_error
+	 * @see make_scalar_function
+	 *
+	 * Registers a function taking sizeof...(Args) typed arguments, e.g.
+	 * boost::function<double (double, double)>.  Arguments declared as
+	 * boost::optional receive none for NULL, and an optional result which
+	 * is none returns NULL to SQLite.
+	 */
+	template <typename R, typename... Args>
+	void create_function(const std::string & name, boost::function<R (Args...)> f,
+		bool deterministic = true)
+	{
+		create_function(name, sizeof...(Args), make_scalar_function(f), deterministic);
+	}
+
 	//! @return SQLite3 Error Code
 	int error_code();
 
@@ -185,17 +312,102 @@ public:
 	/**
 	 * @brief Execute an SQL string and return result
 	 * @param[in] SQL String
+	 * @param[in] Use the Statement Cache
 	 * @return Cursor
 	 *
-	 * Creates a prepared statement for the given SQL string and executes it,
-	 * returing the cursor result.  This is shorthand for creating the statement
-	 * and calling statement::exec().
+	 * Prepares the given SQL string and executes it, returing the cursor
+	 * result.  This is shorthand for calling prepare(sql, cached) and
+	 * statement::exec(), so repeated queries skip sqlite3_prepare_v2() once
+	 * they are cached.  Pass false for one-off statements such as DDL and
+	 * pragmas so they do not evict statements which are reused.
 	 */
-	boost::shared_ptr<cursor> exec_sql(const std::string & sql);
+	boost::shared_ptr<cursor> exec_sql(const std::string & sql, bool cached = true);
 
 	//! @return SQLite3 Database Handle
 	sqlite3 * handle();
 
+	/**
+	 * @brief Check if a SQL Function is registered
+	 * @param[in] Function Name
+	 * @param[in] Number of Arguments
+	 * @return True if the Function was registered through this Connection
+	 */
+	bool has_function(const std::string & name, int nargs) const;
+
+	/**
+	 * @brief Interrupt the running Statement
+	 *
+	 * Causes any statement currently running on the connection to abort at
+	 * its earliest opportunity with an interrupted_error.  This is the only
+	 * connection method which is safe to call from a thread other than the
+	 * one using the connection.
+	 */
+	void interrupt();
+
+	/**
+	 * @brief Check if the Connection is in the middle of a Read
+	 * @return True if a Transaction is open or a Statement is being stepped
+	 *
+	 * While this is true, statements read from the snapshot of the database
+	 * taken when the transaction started, which may miss changes committed
+	 * since by other connections.
+	 */
+	bool is_busy() const;
+
+	//! @return True if the Connection was opened Read-Only
+	bool is_readonly() const;
+
+	//! @return True if Statement Profiling is enabled
+	bool is_profiling() const;
+
+	//! @return Owning Thread, or a default Thread Id if any Thread may use the Connection
+	std::thread::id owner_thread() const;
+
+	/**
+	 * @brief Remove the most recently pushed Cancellation Token
+	 * @see push_cancellation
+	 */
+	void pop_cancellation();
+
+	/**
+	 * @brief Check out a cached Prepared Statement
+	 * @param[in] SQL String
+	 * @param[in] True to use the Statement Cache
+	 * @return Prepared Statement
+	 * @throws sql_error
+	 *
+	 * Returns a prepared statement for the given SQL string, reusing an idle
+	 * statement from the connection's statement cache if one is available
+	 * and preparing a new one otherwise.  The statement belongs exclusively
+	 * to the caller until the last reference to it is released, at which
+	 * point it is reset and returned to the cache.
+	 *
+	 * If cached is false the cache is neither searched nor filled and the
+	 * statement is finalized when it is released.  Use this for statements
+	 * which are run once or whose SQL text varies, so they do not evict
+	 * frequently used statements from the cache.
+	 */
+	boost::shared_ptr<statement> prepare(const std::string & sql, bool cached = true);
+
+	/**
+	 * @brief Attach a Cancellation Token to the Connection
+	 * @param[in] Cancellation Token
+	 *
+	 * While the token is attached, statements on the connection are
+	 * interrupted as soon as the token is cancelled or its deadline passes.
+	 * Tokens nest, so a statement is interrupted if any attached token is
+	 * cancelled.  Prefer using cancellation_scope over calling this directly.
+	 */
+	void push_cancellation(const cancellation_token & token);
+
+	/**
+	 * @brief Remove a SQL Function
+	 * @param[in] Function Name
+	 * @param[in] Number of Arguments
+	 * @throws dbapi_error
+	 */
+	void remove_function(const std::string & name, int nargs);
+
 	//! @brief Roll Back the current Transaction
 	void rollback();
 
@@ -237,6 +449,49 @@ public:
 	 */
 	void set_commit_handler(commit_handler h);
 
+	/**
+	 * @brief Set the Committed Handler
+	 * @param[in] Handler Function
+	 * @see committed_handler
+	 *
+	 * Sets a new Committed handler for the connection.
+	 */
+	void set_committed_handler(committed_handler h);
+
+	/**
+	 * @brief Set the Owning Thread
+	 * @param[in] Thread Id, or a default Thread Id to allow any Thread
+	 *
+	 * Once a connection is owned by a thread, preparing or executing a
+	 * statement and opening a blob from any other thread throw a dbapi_error
+	 * instead of racing with the owner.  dbapi::executor sets itself as the owner of its connection.
+	 */
+	void set_owner_thread(std::thread::id id);
+
+	/**
+	 * @brief Enable or Disable Statement Profiling
+	 * @param[in] Enable Profiling
+	 * @see profiler
+	 *
+	 * Starts or stops collecting per-statement statistics into the
+	 * connection's profiler.  Collected statistics are kept when profiling
+	 * is disabled; use stmt_profiler().reset() to discard them.  Profiling
+	 * adds a small overhead to every statement step.
+	 */
+	void set_profiling(bool enable);
+
+	/**
+	 * @brief Set the Progress Handler
+	 * @param[in] Handler Function
+	 * @param[in] Number of VM Instructions between Handler Calls
+	 * @see progress_handler
+	 *
+	 * Sets a new Progress handler for the connection.  The handler runs in
+	 * addition to any attached cancellation tokens; the instruction count
+	 * applies to both.
+	 */
+	void set_progress_handler(progress_handler h, int n_ops = default_progress_ops);
+
 	/**
 	 * @brief Set the Rollback Handler
 	 * @param[in] Handler Function
@@ -246,6 +501,15 @@ public:
 	 */
 	void set_rollback_handler(rollback_handler h);
 
+	/**
+	 * @brief Set the Trace Handler
+	 * @param[in] Handler Function
+	 * @see trace_handler
+	 *
+	 * Sets a new Trace handler for the connection.
+	 */
+	void set_trace_handler(trace_handler h);
+
 	/**
 	 * @brief Set the Update Handler
 	 * @param[in] Handler Function
@@ -255,6 +519,12 @@ public:
 	 */
 	void set_update_handler(update_handler h);
 
+	//! @return Prepared Statement Cache
+	statement_cache & stmt_cache();
+
+	//! @return Statement Profiler
+	profiler & stmt_profiler();
+
 	//! @return Check if a Transaction is Active
 	bool transaction_active() const;
 
@@ -263,15 +533,93 @@ private:
 
 	busy_handler		m_bh;			///< Database Busy Handler
 	commit_handler		m_ch;			///< Commit Handler
+	committed_handler	m_cdh;			///< Committed Handler
+	bool				m_committing;	///< Commit Hook ran during the current Step
 	rollback_handler	m_rh;			///< Rollback Handler
 	update_handler		m_uh;			///< Update Handler
 	authorize_handler	m_ah;			///< Authorize Handler
+	trace_handler		m_th;			///< Trace Handler
+	progress_handler	m_ph;			///< Progress Handler
+	int					m_ph_ops;		///< Progress Handler Instruction Count
 
+	std::vector<cancellation_token>	m_tokens;	///< Attached Cancellation Tokens
+
+	std::set<std::pair<std::string, int> >	m_functions;	///< Registered SQL Functions
+
+	std::atomic<std::thread::id>	m_owner;	///< Owning Thread
+
+	bool				m_readonly;		///< Opened Read-Only
 	bool				m_transaction;	///< Transaction Active
 	sqlite3_stmt *		s_begin;		///< Begin Transaction Statement
 	sqlite3_stmt *		s_commit;		///< Commit Transaction Statement
 	sqlite3_stmt *		s_rollback;		///< Rollback Transaction Statement
 
+	statement_cache		m_cache;		///< Prepared Statement Cache
+	profiler			m_profiler;		///< Statement Profiler
+	bool				m_profiling;	///< Statement Profiling Enabled
+
+private:
+	friend class statement;
+
+	//! Prepare the Transaction Statements
+	void init();
+
+	//! Run the Committed Handler if the last Step committed a Transaction
+	void after_step(int rc);
+
+	//! Register or remove the SQLite3 Commit Callback
+	void update_commit();
+
+	//! Register or remove the SQLite3 Progress Callback
+	void update_progress();
+
+	//! Register or remove the SQLite3 Trace Callback
+	void update_trace();
+
+	//! SQLite3 Commit Callback
+	static int commit_callback(void * p);
+
+	//! SQLite3 Progress Callback
+	static int progress_callback(void * p);
+
+	//! SQLite3 Trace Callback
+	static int trace_callback(unsigned int evt, void * p, void * stmt, void * x);
+
+};
+
+/**
+ * @brief Cancellation Scope
+ *
+ * Attaches a cancellation token to a connection for the lifetime of the
+ * scope object, so that any statement run inside the scope is interrupted
+ * once the token is cancelled:
+ *
+ * @code
+ * dbapi::cancellation_token t = dbapi::cancellation_token::timeout(500);
+ * {
+ *     dbapi::cancellation_scope scope(conn, t);
+ *     conn->exec_sql("SELECT ...");	// throws interrupted_error after 500ms
+ * }
+ * @endcode
+ */
+class cancellation_scope: public boost::noncopyable
+{
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Database Connection
+	 * @param[in] Cancellation Token
+	 * @throws interrupted_error if the Token is already cancelled
+	 */
+	cancellation_scope(connection::ptr conn, const cancellation_token & token);
+
+	//! Class Destructor
+	~cancellation_scope();
+
+private:
+	connection::ptr		m_conn;
+
 };
 
 } } } /* benthos::logbook::dbapi */
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_CONNECTION_OPTIONS_HPP_
+#define DBAPI_CONNECTION_OPTIONS_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/connection_options.hpp
+ * @brief DBAPI Connection Options Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstdint>
+
+#include <boost/optional.hpp>
+
+#include <benthos/logbook/dbapi/connection.hpp>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Database Connection Options
+ *
+ * Typed set of SQLite3 tuning pragmas which are applied to a connection just
+ * after it is opened.  Each option is optional; options which are not set
+ * leave the SQLite3 default (or the value stored in the database file) in
+ * place.  See the SQLite3 PRAGMA documentation for the exact meaning of each
+ * setting.
+ *
+ * Three presets are provided for the common ways the Logbook is used:
+ * bulk_import() trades durability for write throughput while importing many
+ * dives at once, interactive() is a balanced setting for a desktop logbook,
+ * and read_only_analytics() opens the database read-only with a large page
+ * cache and memory map for report generation.
+ */
+struct connection_options
+{
+	//! Journal Modes (pragma journal_mode)
+	enum journal_mode_t
+	{
+		journal_delete,				///< Delete the Rollback Journal on Commit
+		journal_truncate,			///< Truncate the Rollback Journal on Commit
+		journal_persist,			///< Zero the Rollback Journal Header on Commit
+		journal_memory,				///< Keep the Rollback Journal in Memory
+		journal_wal,				///< Write-Ahead Logging
+		journal_off				///< No Rollback Journal
+	};
+
+	//! Synchronous Modes (pragma synchronous)
+	enum synchronous_t
+	{
+		synchronous_off = 0,		///< Never wait for data to reach the Disk
+		synchronous_normal = 1,		///< Sync at critical moments only
+		synchronous_full = 2,		///< Sync on every Transaction
+		synchronous_extra = 3		///< Also Sync the Directory on Journal Deletion
+	};
+
+	//! Temporary Storage Locations (pragma temp_store)
+	enum temp_store_t
+	{
+		temp_store_default = 0,		///< Compile-Time Default
+		temp_store_file = 1,		///< Temporary Files
+		temp_store_memory = 2		///< Memory
+	};
+
+	//! Locking Modes (pragma locking_mode)
+	enum locking_mode_t
+	{
+		locking_normal,				///< Release Locks after each Transaction
+		locking_exclusive			///< Hold Locks until the Connection is closed
+	};
+
+	boost::optional<int64_t>		mmap_size;		///< Memory Map Size [bytes]
+	boost::optional<int>			cache_size;		///< Page Cache Size [pages, or KiB if negative]
+	boost::optional<int>			page_size;		///< Page Size [bytes] (new databases only)
+	boost::optional<journal_mode_t>	journal_mode;	///< Journal Mode
+	boost::optional<synchronous_t>	synchronous;	///< Synchronous Mode
+	boost::optional<temp_store_t>	temp_store;		///< Temporary Storage Location
+	boost::optional<locking_mode_t>	locking_mode;	///< Locking Mode
+	bool							read_only;		///< Open the Database Read-Only
+
+	//! Class Constructor; all Options unset
+	connection_options();
+
+	/**
+	 * @brief Bulk Import Preset
+	 *
+	 * Large page cache and memory map, temporary storage in memory and no
+	 * fsync() calls.  A power loss during an import may lose the most recent
+	 * transactions (but will not corrupt a WAL database), which is acceptable
+	 * since the import can simply be re-run.
+	 */
+	static connection_options bulk_import();
+
+	/**
+	 * @brief Interactive Preset
+	 *
+	 * Moderate page cache and memory map with synchronous=normal, which is
+	 * durable in WAL mode and avoids an fsync() on every commit.
+	 */
+	static connection_options interactive();
+
+	/**
+	 * @brief Read-Only Analytics Preset
+	 *
+	 * Opens the database read-only with a very large memory map and page
+	 * cache and temporary storage in memory, for queries which scan most of
+	 * the logbook.
+	 */
+	static connection_options read_only_analytics();
+
+	/**
+	 * @brief Apply the Options to a Connection
+	 * @param[in] Database Connection
+	 * @throws dbapi_error if the Journal Mode cannot be changed
+	 *
+	 * Executes the pragma for each option which is set.  The page size is
+	 * set first since it only takes effect before the database file is
+	 * initialized; the journal mode cannot be changed while the connection
+	 * has statements in progress.
+	 */
+	void apply(connection::ptr conn) const;
+
+	//! @return Flags to pass to sqlite3_open_v2()
+	int open_flags() const;
+
+	/**
+	 * @brief Return the Options which apply to Pooled Readers
+	 * @return Reader Options
+	 *
+	 * Returns a copy which only holds the per-connection cache settings
+	 * (mmap_size, cache_size and temp_store) and is marked read-only.  The
+	 * remaining options are properties of the database file or only matter
+	 * for connections which write to it.
+	 */
+	connection_options reader_options() const;
+
+	/**
+	 * @brief Check if the Options allow Write-Ahead Logging
+	 * @return True unless a non-WAL journal mode or exclusive locking is set
+	 */
+	bool allows_wal() const;
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_CONNECTION_OPTIONS_HPP_ */
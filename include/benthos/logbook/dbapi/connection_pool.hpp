@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_CONNECTION_POOL_HPP_
+#define DBAPI_CONNECTION_POOL_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/connection_pool.hpp
+ * @brief DBAPI Connection Pool Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <benthos/logbook/dbapi/connection.hpp>
+#include <benthos/logbook/dbapi/connection_options.hpp>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Database Connection Pool Class
+ *
+ * Manages a single read-write connection to a database file along with a
+ * pool of read-only connections to the same file.  When the pool is created
+ * the database is switched to write-ahead logging (WAL) mode, which allows
+ * the readers to query the database concurrently with each other and with
+ * the writer.  The pool must therefore be created before the writer has any
+ * statements in progress.
+ *
+ * Readers are leased with acquire_reader() and are returned to the pool
+ * automatically when the last reference to the lease is released.  Up to
+ * max_idle() idle readers are kept open for reuse; if every reader is in
+ * use a new one is opened, and it is closed on release if the pool already
+ * holds enough idle readers.  acquire_reader() therefore never blocks.
+ *
+ * Each leased reader must only be used from one thread at a time.  The pool
+ * itself may be used from any thread, but must be owned by a shared pointer.
+ * In-memory databases cannot be shared between connections, so readers are
+ * not available for them.
+ */
+class connection_pool: public boost::noncopyable,
+	public boost::enable_shared_from_this<connection_pool>
+{
+public:
+	typedef boost::shared_ptr<connection_pool>	ptr;
+
+	//! Default Maximum Number of Idle Readers
+	static const size_t default_max_idle = 4;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Database File Name
+	 * @param[in] Read-Write Connection to the Database
+	 * @param[in] Maximum Number of Idle Readers
+	 * @param[in] Options the Writer was opened with
+	 * @throws dbapi_error if WAL mode cannot be enabled
+	 *
+	 * Enables WAL mode on the writer unless the database is in-memory or the
+	 * options select a different journal mode or exclusive locking, in which
+	 * case readers are not available.  If the writer is read-only, readers
+	 * are only available if the database is already in WAL mode.  Readers
+	 * are opened with the cache settings from connection_options::
+	 * reader_options().
+	 */
+	connection_pool(const std::string & dbname, connection::ptr writer,
+			size_t max_idle = default_max_idle,
+			const connection_options & options = connection_options());
+
+	//! Class Destructor; closes all idle Readers
+	~connection_pool();
+
+	/**
+	 * @brief Lease a Read-Only Connection
+	 * @return Read-Only Connection
+	 * @throws dbapi_error if the database is not in WAL mode
+	 *
+	 * Returns an idle reader from the pool, opening a new one if none are
+	 * available.  The reader is returned to the pool when the returned
+	 * pointer and all copies of it (including those held by statements) are
+	 * released.  Any transaction left open on the reader is rolled back when
+	 * it is returned.
+	 */
+	connection::ptr acquire_reader();
+
+	//! @return Database File Name
+	const std::string & dbname() const;
+
+	//! @return True if Readers are available (the Database is in WAL mode)
+	bool has_readers() const;
+
+	//! @return Number of Idle Readers
+	size_t idle_count() const;
+
+	//! @return Maximum Number of Idle Readers
+	size_t max_idle() const;
+
+	//! @return Number of Open Readers (Idle and Leased)
+	size_t reader_count() const;
+
+	/**
+	 * @brief Set the Maximum Number of Idle Readers
+	 * @param[in] Maximum Number of Idle Readers
+	 *
+	 * Closes idle readers in excess of the new maximum.
+	 */
+	void set_max_idle(size_t n);
+
+	//! @return Read-Write Connection
+	connection::ptr writer() const;
+
+protected:
+
+	//! Switch the Database to Write-Ahead Logging
+	void enable_wal();
+
+	//! Return a Reader to the Pool
+	void release(connection * c);
+
+private:
+
+	//! Deleter which returns a leased Reader to the Pool
+	struct releaser
+	{
+		boost::weak_ptr<connection_pool>	pool;
+		void operator() (connection * c) const;
+	};
+
+private:
+	std::string					m_dbname;		///< Database File Name
+	connection::ptr				m_writer;		///< Read-Write Connection
+	connection_options			m_options;		///< Reader Connection Options
+
+	std::list<connection *>		m_idle;			///< Idle Readers
+	size_t						m_max_idle;		///< Maximum Number of Idle Readers
+	size_t						m_nreaders;		///< Number of Open Readers
+	bool						m_wal;			///< WAL Mode Enabled
+
+	mutable std::mutex			m_mutex;		///< Pool Mutex
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_CONNECTION_POOL_HPP_ */
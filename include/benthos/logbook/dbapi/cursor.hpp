@@ -37,9 +37,14 @@
  * @author Jonathan Krauss <jkrauss@asymworks.com>
  */
 
+#include <cstddef>
+#include <iterator>
+#include <tuple>
 #include <vector>
+#include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <benthos/logbook/dbapi/row_view.hpp>
 #include <benthos/logbook/dbapi/statement.hpp>
 #include <benthos/logbook/dbapi/variant.hpp>
 
@@ -51,7 +56,10 @@ namespace benthos { namespace logbook { namespace dbapi {
  * Presets the results of a query as an iterable set of rows.  Cursors may
  * not be created directly; instead they must be accessed by executing a
  * prepared statement via statement::exec().  Data may be accessed by using the
- * cursor::fetchone(), cursor::fetchmany() and cursor::fetchall() methods.
+ * cursor::fetchone(), cursor::fetchmany() and cursor::fetchall() methods,
+ * which copy each row into a vector of variants, or in place through the
+ * cursor::current() and cursor::next() methods, which expose the current row
+ * as a row_view without copying.
  *
  * The cursor implements boost::noncopyable and is accessed only as a shared
  * pointer returned by the statement::exec() function.
@@ -61,6 +69,49 @@ class cursor: public boost::noncopyable
 public:
 	typedef boost::shared_ptr<cursor>	ptr;
 	typedef std::vector<variant>		row_t;
+	typedef dbapi::row_view				row_view;
+
+	/**
+	 * @brief Cursor Row Iterator
+	 *
+	 * Single-pass input iterator over the rows remaining in a cursor.  Each
+	 * increment steps the underlying statement, so only the current row is
+	 * ever held in memory.  Dereferencing yields a row_view which is valid
+	 * until the iterator is next incremented.  All iterators obtained from a
+	 * cursor share its position; a default-constructed iterator compares
+	 * equal to any iterator whose cursor is at the end.
+	 */
+	class iterator
+	{
+	public:
+		typedef std::input_iterator_tag		iterator_category;
+		typedef row_view					value_type;
+		typedef std::ptrdiff_t				difference_type;
+		typedef const row_view *			pointer;
+		typedef const row_view &			reference;
+
+	public:
+
+		//! Construct an End Iterator
+		iterator();
+
+		//! Construct an Iterator at the Cursor's current Row
+		explicit iterator(cursor * c);
+
+		reference operator* () const;
+		pointer operator-> () const;
+
+		iterator & operator++ ();
+		iterator operator++ (int);
+
+		bool operator== (const iterator & other) const;
+		bool operator!= (const iterator & other) const;
+
+	private:
+		cursor *		m_cursor;		///< Cursor or NULL at End
+		row_view		m_row;			///< Current Row View
+
+	};
 
 protected:
 
@@ -76,6 +127,20 @@ public:
 	//! Class Destructor
 	~cursor();
 
+	//! @return True if the Cursor has no more Rows
+	bool at_end() const;
+
+	/**
+	 * @brief Iterate over the remaining Rows
+	 * @return Iterator at the current Row
+	 *
+	 * Provides range-style access to the cursor so that results can be
+	 * processed one row at a time without calling fetchall().  Iteration
+	 * consumes the cursor; it cannot be restarted without re-executing the
+	 * statement.
+	 */
+	iterator begin();
+
 	//! @return Number of Columns in the Result Set
 	int column_count() const;
 
@@ -88,6 +153,32 @@ public:
 	//! @return Unaliased Names of the Columns
 	const std::vector<std::string> & column_origin_names() const;
 
+	/**
+	 * @brief Access the current Row in place
+	 * @return Row View
+	 * @throws std::runtime_error if the Cursor is at the end
+	 *
+	 * Returns a view of the current row which reads column values directly
+	 * from the underlying statement.  The view is invalidated by next(),
+	 * any of the fetch methods, and by resetting the statement.
+	 */
+	row_view current() const;
+
+	//! @return End Iterator
+	iterator end();
+
+	/**
+	 * @brief Fetch the next Row in the Cursor as a Tuple
+	 * @return Tuple of Column Values, or none if the Cursor is at the end
+	 *
+	 * Decodes the current row directly into a std::tuple<Ts...> with the
+	 * column access functions selected at compile time (see
+	 * row_view::as_tuple()) and advances the cursor.  Use boost::optional
+	 * column types for nullable columns.
+	 */
+	template <typename... Ts>
+	boost::optional<std::tuple<Ts...> > fetch();
+
 	/**
 	 * @brief Fetch the next Row in the Cursor
 	 * @return Row
@@ -138,6 +229,15 @@ public:
 	 */
 	std::vector<row_t> fetchall();
 
+	/**
+	 * @brief Advance the Cursor to the next Row
+	 * @return True if the Cursor has another Row
+	 *
+	 * Steps the underlying statement without copying the current row.  Use
+	 * current() to access the new row if this method returns true.
+	 */
+	bool next();
+
 	/**
 	 * @brief Return the last inserted rowid
 	 * @return Row Id
@@ -179,4 +279,6 @@ private:
 
 } } } /* bethos::logbook::dbapi */
 
+#include "cursor_impl.hpp"
+
 #endif /* DBAPI_CURSOR_HPP_ */
@@ -109,6 +109,21 @@ public:
 	virtual ~bind_error() throw () { }
 };
 
+/**
+ * @brief Interrupted Error Class
+ *
+ * Raised when a statement is aborted by connection::interrupt(), by a
+ * cancelled cancellation_token or by a progress handler.
+ */
+class interrupted_error: public dbapi_error
+{
+public:
+	interrupted_error(const std::string & msg) : dbapi_error(msg) { }
+	interrupted_error(dbapi::connection * db) : dbapi_error(db) { }
+	interrupted_error(connection_ptr db) : dbapi_error(db) { }
+	virtual ~interrupted_error() throw () { }
+};
+
 } } } /* benthos::logbook::dbapi */
 
 #endif /* DBAPI_ERROR_HPP_ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_EXECUTOR_HPP_
+#define DBAPI_EXECUTOR_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/executor.hpp
+ * @brief DBAPI Asynchronous Query Executor Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <benthos/logbook/dbapi/connection.hpp>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Asynchronous Query Executor
+ *
+ * Owns a dedicated worker thread for a database connection and runs queued
+ * tasks on it one at a time, in submission order.  Tasks are submitted with
+ * submit(), which returns a std::future for the task's result, or with post()
+ * for fire-and-forget tasks which report their results through a callback.
+ *
+ * Once a connection has been handed to an executor it (and any statements,
+ * cursors or sessions built on it) must only be used from tasks running on
+ * the executor, since dbapi objects are not themselves thread-safe.  The
+ * executor enforces this by making its worker thread the owner of the
+ * connection (see connection::set_owner_thread()) until it is shut down.
+ *
+ * The destructor runs any tasks which are still queued and then joins the
+ * worker thread, so futures obtained from submit() are always satisfied.
+ */
+class executor: public boost::noncopyable
+{
+public:
+	typedef boost::shared_ptr<executor>		ptr;
+	typedef boost::function<void ()>		task_t;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Database Connection
+	 *
+	 * Starts the worker thread for the connection.
+	 */
+	executor(connection::ptr conn);
+
+	//! Class Destructor; drains the Queue and joins the Worker Thread
+	~executor();
+
+	//! @return Database Connection
+	connection::ptr conn() const;
+
+	//! @return Number of Tasks waiting to be run
+	size_t pending() const;
+
+	/**
+	 * @brief Queue a Task without a Result
+	 * @param[in] Task
+	 *
+	 * Queues the task to run on the worker thread.  Exceptions thrown by the
+	 * task are caught and discarded so that the worker thread keeps running;
+	 * tasks should deliver results and errors through their own callbacks.
+	 */
+	void post(task_t t);
+
+	/**
+	 * @brief Queue a Task and return a Future for its Result
+	 * @param[in] Task
+	 * @return Future for the Task Result
+	 *
+	 * Queues the task to run on the worker thread.  The returned future
+	 * receives the task's return value, or the exception it threw.
+	 */
+	template <typename R>
+	std::future<R> submit(boost::function<R ()> fn);
+
+	/**
+	 * @brief Stop the Worker Thread
+	 *
+	 * Runs any queued tasks, then stops and joins the worker thread.  Tasks
+	 * posted after shutdown() throw std::runtime_error.  Called automatically
+	 * by the destructor.
+	 */
+	void shutdown();
+
+private:
+
+	//! Queue State shared with the Worker Thread
+	struct queue_state
+	{
+		std::deque<task_t>			tasks;		///< Pending Tasks
+		std::mutex					mutex;		///< Queue Mutex
+		std::condition_variable		cond;		///< Queue Condition
+		bool						stop;		///< Stop Requested
+
+		queue_state() : tasks(), mutex(), cond(), stop(false) { }
+	};
+
+	//! Worker Thread Main Loop
+	static void run(boost::shared_ptr<queue_state> q);
+
+	//! Packaged Task Runner used by submit()
+	template <typename R>
+	struct task_runner
+	{
+		boost::shared_ptr<std::packaged_task<R ()> >	task;
+		void operator() () { (* task)(); }
+	};
+
+private:
+	connection::ptr					m_conn;			///< Database Connection
+	boost::shared_ptr<queue_state>	m_queue;		///< Task Queue
+	std::thread						m_thread;		///< Worker Thread
+
+};
+
+template <typename R>
+std::future<R> executor::submit(boost::function<R ()> fn)
+{
+	task_runner<R> r;
+	r.task.reset(new std::packaged_task<R ()>(fn));
+
+	std::future<R> result = r.task->get_future();
+	post(r);
+	return result;
+}
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_EXECUTOR_HPP_ */
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_FUNCTION_HPP_
+#define DBAPI_FUNCTION_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/function.hpp
+ * @brief DBAPI SQL Function Classes
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+
+#include <benthos/logbook/dbapi/row_view.hpp>
+#include <benthos/logbook/dbapi/variant.hpp>
+
+#include <sqlite3.h>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief SQL Function Arguments
+ *
+ * Provides typed access to the arguments passed to a user-defined SQL
+ * function, in the same way row_view provides access to the columns of a
+ * result row.  TEXT and BLOB arguments may be accessed in place through
+ * text() and blob(); the references are only valid until the function
+ * returns.
+ */
+class function_args
+{
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Number of Arguments
+	 * @param[in] SQLite3 Argument Values
+	 */
+	function_args(int argc, sqlite3_value ** argv);
+
+	/**
+	 * @brief Get an Argument Value
+	 * @param[in] Argument Index
+	 * @return Argument Value
+	 * @throws std::out_of_range
+	 *
+	 * Reads the argument as the requested type, using SQLite's type
+	 * conversion rules.  A NULL argument returns a default-constructed value;
+	 * use is_null() or get_optional() to distinguish NULL values.
+	 */
+	template <typename T>
+	T as(int idx) const;
+
+	/**
+	 * @brief Get an Argument Value
+	 * @param[in] Argument Index
+	 * @return Argument Value or none if the Argument is NULL
+	 * @throws std::out_of_range
+	 */
+	template <typename T>
+	boost::optional<T> get_optional(int idx) const;
+
+	/**
+	 * @brief Get a BLOB Argument in place
+	 * @param[in] Argument Index
+	 * @return Blob Reference
+	 * @throws std::out_of_range
+	 */
+	blob_ref blob(int idx) const;
+
+	//! @return SQLite3 Value Handle for an Argument
+	sqlite3_value * handle(int idx) const;
+
+	//! @return Check whether an Argument is NULL
+	bool is_null(int idx) const;
+
+	//! @return Number of Arguments
+	int size() const;
+
+	/**
+	 * @brief Get a TEXT Argument in place
+	 * @param[in] Argument Index
+	 * @return Text Reference
+	 * @throws std::out_of_range
+	 */
+	text_ref text(int idx) const;
+
+	//! @return SQLite3 Fundamental Type of an Argument
+	int type(int idx) const;
+
+	/**
+	 * @brief Get an Argument Value as a Variant
+	 * @param[in] Argument Index
+	 * @return Argument Value
+	 * @throws std::out_of_range
+	 *
+	 * TEXT and BLOB values are returned as borrowed variants which must not
+	 * be used after the function returns.
+	 */
+	variant value(int idx) const;
+
+protected:
+
+	//! Check an Argument Index
+	void check_index(int idx) const;
+
+private:
+	int					m_argc;			///< Number of Arguments
+	sqlite3_value **	m_argv;			///< Argument Values
+
+};
+
+/**
+ * @brief Scalar SQL Function
+ *
+ * Called once per invocation of a scalar SQL function with the function
+ * arguments, returning the function result.  A null variant returns NULL to
+ * SQLite.  Exceptions thrown by the function are reported to SQLite as an
+ * error in the calling statement.
+ */
+typedef boost::function<variant (const function_args &)> scalar_function;
+
+/**
+ * @brief Aggregate SQL Function State
+ *
+ * Holds the running state of one evaluation of an aggregate SQL function.
+ * A new instance is created by the aggregate_factory for each group; step()
+ * is called for every row in the group and finish() once at the end to get
+ * the result.  The instance is deleted after finish() returns.  If the group
+ * is empty, finish() is called without any calls to step().
+ */
+class aggregate
+{
+public:
+
+	//! Class Destructor
+	virtual ~aggregate();
+
+	/**
+	 * @brief Accumulate a Row
+	 * @param[in] Function Arguments
+	 */
+	virtual void step(const function_args & args) = 0;
+
+	/**
+	 * @brief Compute the Result
+	 * @return Aggregate Result
+	 */
+	virtual variant finish() = 0;
+
+};
+
+//! Aggregate SQL Function Factory
+typedef boost::function<aggregate * ()> aggregate_factory;
+
+/**
+ * @brief Create a Scalar Function from a typed Function
+ * @param[in] Typed Function
+ * @return Scalar Function
+ *
+ * Wraps a function taking typed arguments into a scalar_function which
+ * reads each SQL argument with function_args::as<>() (or get_optional<>()
+ * for boost::optional arguments) and converts the result to a variant.
+ */
+template <typename R, typename... Args>
+scalar_function make_scalar_function(boost::function<R (Args...)> f);
+
+} } } /* benthos::logbook::dbapi */
+
+#include "function_impl.hpp"
+
+#endif /* DBAPI_FUNCTION_HPP_ */
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_FUNCTION_IMPL_HPP_
+#define DBAPI_FUNCTION_IMPL_HPP_
+
+#include <stdexcept>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Typed Argument Reader
+ *
+ * Reads a single function argument with the sqlite3_value_* function
+ * matching the requested C++ type.  The catch-all is left undefined so that
+ * unsupported types fail at compile time.
+ */
+template <typename T>
+struct value_reader;
+
+// INTEGER reader
+template <>
+struct value_reader<int>
+{
+	static int read(sqlite3_value * v)
+	{
+		return sqlite3_value_int(v);
+	}
+};
+
+// INT64 reader (int64_t and time_t are one of long or long long)
+template <>
+struct value_reader<long>
+{
+	static long read(sqlite3_value * v)
+	{
+		return sqlite3_value_int64(v);
+	}
+};
+
+template <>
+struct value_reader<long long>
+{
+	static long long read(sqlite3_value * v)
+	{
+		return sqlite3_value_int64(v);
+	}
+};
+
+// BOOLEAN reader
+template <>
+struct value_reader<bool>
+{
+	static bool read(sqlite3_value * v)
+	{
+		return sqlite3_value_int(v) != 0;
+	}
+};
+
+// FLOAT reader
+template <>
+struct value_reader<double>
+{
+	static double read(sqlite3_value * v)
+	{
+		return sqlite3_value_double(v);
+	}
+};
+
+// TEXT reference reader
+template <>
+struct value_reader<text_ref>
+{
+	static text_ref read(sqlite3_value * v)
+	{
+		const char * p = (const char *)sqlite3_value_text(v);
+		return text_ref(p, sqlite3_value_bytes(v));
+	}
+};
+
+// TEXT reader
+template <>
+struct value_reader<std::string>
+{
+	static std::string read(sqlite3_value * v)
+	{
+		text_ref t = value_reader<text_ref>::read(v);
+		return t.data ? std::string(t.data, t.size) : std::string();
+	}
+};
+
+// BLOB reference reader
+template <>
+struct value_reader<blob_ref>
+{
+	static blob_ref read(sqlite3_value * v)
+	{
+		const unsigned char * p = (const unsigned char *)sqlite3_value_blob(v);
+		return blob_ref(p, sqlite3_value_bytes(v));
+	}
+};
+
+// BLOB reader
+template <>
+struct value_reader<std::vector<unsigned char> >
+{
+	static std::vector<unsigned char> read(sqlite3_value * v)
+	{
+		blob_ref b = value_reader<blob_ref>::read(v);
+		return b.data ? std::vector<unsigned char>(b.data, b.data + b.size) : std::vector<unsigned char>();
+	}
+};
+
+template <typename T>
+T function_args::as(int idx) const
+{
+	check_index(idx);
+	if (sqlite3_value_type(m_argv[idx]) == SQLITE_NULL)
+		return T();
+	return value_reader<T>::read(m_argv[idx]);
+}
+
+template <typename T>
+boost::optional<T> function_args::get_optional(int idx) const
+{
+	check_index(idx);
+	if (sqlite3_value_type(m_argv[idx]) == SQLITE_NULL)
+		return boost::optional<T>();
+	return boost::optional<T>(value_reader<T>::read(m_argv[idx]));
+}
+
+/**
+ * @brief Typed Argument Accessor
+ *
+ * Selects function_args::as<>() or function_args::get_optional<>() for an
+ * argument depending on whether the parameter type is a boost::optional.
+ */
+template <typename T>
+struct argument_reader
+{
+	static T read(const function_args & args, int idx)
+	{
+		return args.as<T>(idx);
+	}
+};
+
+template <typename T>
+struct argument_reader<boost::optional<T> >
+{
+	static boost::optional<T> read(const function_args & args, int idx)
+	{
+		return args.get_optional<T>(idx);
+	}
+};
+
+template <typename T>
+struct argument_reader<const T &>: argument_reader<T> { };
+
+/**
+ * @brief Typed Function Adapter
+ *
+ * Unpacks the function arguments into the parameters of a typed function
+ * and wraps its result in a variant.
+ */
+template <typename R, typename... Args>
+struct typed_function
+{
+	boost::function<R (Args...)>	fn;
+
+	variant operator() (const function_args & args) const
+	{
+		if (args.size() != (int)sizeof...(Args))
+			throw std::invalid_argument("Wrong number of arguments to SQL function");
+		return call(args, typename make_index_list<sizeof...(Args)>::type());
+	}
+
+	template <int... Is>
+	variant call(const function_args & args, index_list<Is...>) const
+	{
+		return variant(fn(argument_reader<Args>::read(args, Is)...));
+	}
+};
+
+template <typename R, typename... Args>
+scalar_function make_scalar_function(boost::function<R (Args...)> f)
+{
+	typed_function<R, Args...> tf;
+	tf.fn = f;
+	return scalar_function(tf);
+}
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_FUNCTION_IMPL_HPP_ */
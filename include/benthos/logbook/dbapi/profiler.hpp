@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_PROFILER_HPP_
+#define DBAPI_PROFILER_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/profiler.hpp
+ * @brief DBAPI Statement Profiler Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <sqlite3.h>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Statement Profile Statistics
+ *
+ * Execution statistics accumulated for all runs of one SQL string.  Times
+ * are wall-clock nanoseconds measured from the first step of a statement to
+ * the point where it completes or is reset.  The percentile values are
+ * computed over the most recent profiler::sample_capacity runs.
+ */
+struct statement_stats
+{
+	std::string		sql;				///< SQL Text
+	uint64_t		calls;				///< Number of Executions
+	uint64_t		rows;				///< Number of Result Rows Stepped
+	uint64_t		total_ns;			///< Total Execution Time
+	uint64_t		min_ns;				///< Fastest Execution Time
+	uint64_t		max_ns;				///< Slowest Execution Time
+	uint64_t		p50_ns;				///< Median Execution Time
+	uint64_t		p90_ns;				///< 90th Percentile Execution Time
+	uint64_t		p99_ns;				///< 99th Percentile Execution Time
+	uint64_t		fullscan_steps;		///< Full Table Scan Steps (SQLITE_STMTSTATUS_FULLSCAN_STEP)
+	uint64_t		sorts;				///< Sort Operations (SQLITE_STMTSTATUS_SORT)
+	uint64_t		autoindex;			///< Automatic Index Rows (SQLITE_STMTSTATUS_AUTOINDEX)
+	uint64_t		vm_steps;			///< Virtual Machine Steps (SQLITE_STMTSTATUS_VM_STEP)
+
+	//! Class Constructor
+	statement_stats();
+
+};
+
+/**
+ * @brief Statement Profiler
+ *
+ * Collects per-SQL execution statistics from the SQLite3 trace interface
+ * (sqlite3_trace_v2) for a single connection.  Statistics are keyed by the
+ * SQL text the statement was prepared with, so all statements prepared from
+ * the same SQL (for instance by different Sessions) share one entry.  The
+ * sqlite3_stmt_status() counters are read and reset each time a statement
+ * completes, so they accumulate per run rather than per handle.
+ *
+ * A high call count for a cheap statement usually points to an N+1 query
+ * pattern, while non-zero full-scan or automatic index counters point to a
+ * missing index.
+ *
+ * The profiler is owned by a dbapi::connection and is enabled with
+ * connection::set_profiling(); like the connection itself it must only be
+ * used from one thread at a time.
+ */
+class profiler: public boost::noncopyable
+{
+public:
+
+	//! Number of recent Execution Times kept for Percentiles
+	static const size_t sample_capacity = 1024;
+
+public:
+
+	//! Class Constructor
+	profiler();
+
+	//! Class Destructor
+	~profiler();
+
+	//! @brief Discard all collected Statistics
+	void reset();
+
+	/**
+	 * @brief Return the collected Statistics
+	 * @return List of Statement Statistics, slowest (by total time) first
+	 */
+	std::vector<statement_stats> snapshot() const;
+
+	/**
+	 * @brief Return the collected Statistics as JSON
+	 * @param[in] Pretty-Print the Output
+	 * @return JSON String
+	 *
+	 * Returns a JSON array with one object per statement, in the same order
+	 * as snapshot(), using the statement_stats member names as keys.
+	 */
+	std::string to_json(bool beautify = false) const;
+
+	/**
+	 * @internal
+	 * @brief Process an SQLite3 Trace Event
+	 * @param[in] Trace Event Code (SQLITE_TRACE_STMT, etc)
+	 * @param[in] Prepared Statement
+	 * @param[in] Event Argument
+	 * @return Elapsed Time in nanoseconds for SQLITE_TRACE_PROFILE events
+	 */
+	int64_t trace(unsigned int evt, sqlite3_stmt * stmt, void * x);
+
+protected:
+	typedef std::chrono::steady_clock	clock_type;
+
+	//! Statement currently being executed
+	struct pending_t
+	{
+		clock_type::time_point		start;		///< First Step Time
+		uint64_t				rows;		///< Rows Stepped so far
+	};
+
+	//! Accumulated Statistics for one SQL String
+	struct entry_t
+	{
+		statement_stats			stats;		///< Statistics
+		std::vector<uint64_t>	samples;	///< Recent Execution Times
+		size_t					next;		///< Next Sample to Overwrite
+	};
+
+	//! Record a completed Statement
+	int64_t finish(sqlite3_stmt * stmt, int64_t sqlite_ns);
+
+private:
+	std::map<sqlite3_stmt *, pending_t>		m_pending;	///< Running Statements
+	std::map<std::string, entry_t>			m_entries;	///< Statistics by SQL Text
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_PROFILER_HPP_ */
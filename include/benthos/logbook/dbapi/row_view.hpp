@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_ROW_VIEW_HPP_
+#define DBAPI_ROW_VIEW_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/row_view.hpp
+ * @brief DBAPI Row View Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include <benthos/logbook/dbapi/variant.hpp>
+
+#include <sqlite3.h>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Database Row View Class
+ *
+ * Lightweight accessor for the current row of an executing statement.  Column
+ * values are read directly from the SQLite statement with the typed
+ * sqlite3_column_* functions, so no intermediate variant objects are built.
+ * TEXT and BLOB columns may be accessed in place through text() and blob(),
+ * which return references into SQLite-owned memory.
+ *
+ * A row_view is only valid while the statement it was created from remains
+ * on the same row; once the cursor is advanced or the statement is reset the
+ * view and any references obtained from it must not be used.
+ *
+ * A row_view may also be created over a row which was copied into variants
+ * (e.g. by cursor::fetchone()), in which case the values are read from the
+ * variants with the same conversions and the view is valid as long as the
+ * copied row.  This lets code which loads objects from a row_view load them
+ * from cached rows as well.
+ */
+class row_view
+{
+public:
+
+	//! Construct an empty Row View with no Columns
+	row_view();
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Statement Handle
+	 * @param[in] Number of Columns
+	 */
+	row_view(sqlite3_stmt * stmt, int ncols);
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Copied Row Values
+	 */
+	explicit row_view(const std::vector<variant> & values);
+
+	/**
+	 * @brief Get a Column Value
+	 * @param[in] Column Index
+	 * @return Column Value
+	 * @throws std::out_of_range
+	 *
+	 * Reads the column directly as the requested type, using SQLite's type
+	 * conversion rules.  A NULL column returns a default-constructed value;
+	 * use is_null() or get_optional() to distinguish NULL values.
+	 */
+	template <typename T>
+	T as(int idx) const;
+
+	/**
+	 * @brief Get the leading Columns as a Tuple
+	 * @return Tuple of Column Values
+	 * @throws std::out_of_range
+	 *
+	 * Decodes columns 0 through sizeof...(Ts)-1 into a std::tuple, with the
+	 * column access functions chosen at compile time from the requested
+	 * types.  NULL columns decode to a default value unless the type is a
+	 * boost::optional, in which case they decode to none.
+	 */
+	template <typename... Ts>
+	std::tuple<Ts...> as_tuple() const;
+
+	/**
+	 * @brief Get a Column Value
+	 * @param[in] Column Index
+	 * @return Column Value or none if the Column is NULL
+	 * @throws std::out_of_range
+	 */
+	template <typename T>
+	boost::optional<T> get_optional(int idx) const;
+
+	/**
+	 * @brief Get a BLOB Column in place
+	 * @param[in] Column Index
+	 * @return Blob Reference
+	 * @throws std::out_of_range
+	 */
+	blob_ref blob(int idx) const;
+
+	//! @return Number of Columns in the Row
+	int column_count() const;
+
+	//! @return Statement Handle, or NULL for a View of copied Values
+	sqlite3_stmt * handle() const;
+
+	//! @return Check whether a Column is NULL
+	bool is_null(int idx) const;
+
+	/**
+	 * @brief Get a TEXT Column in place
+	 * @param[in] Column Index
+	 * @return Text Reference
+	 * @throws std::out_of_range
+	 */
+	text_ref text(int idx) const;
+
+	//! @return SQLite3 Fundamental Type of a Column (SQLITE_INTEGER, etc)
+	int type(int idx) const;
+
+	/**
+	 * @brief Get a Column as a Variant
+	 * @param[in] Column Index
+	 * @return Column Value
+	 * @throws std::out_of_range
+	 *
+	 * Copies the column value into a variant.  This is the slow path used by
+	 * cursor::fetchone() and friends; prefer the typed accessors.
+	 */
+	variant value(int idx) const;
+
+protected:
+
+	//! Check a Column Index for Validity
+	void check_index(int idx) const;
+
+private:
+	sqlite3_stmt *		m_stmt;		///< Statement Handle
+	const variant *		m_values;	///< Copied Row Values
+	int					m_ncols;	///< Number of Columns
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#include "row_view_impl.hpp"
+
+#endif /* DBAPI_ROW_VIEW_HPP_ */
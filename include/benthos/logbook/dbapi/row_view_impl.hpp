@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_ROW_VIEW_IMPL_HPP_
+#define DBAPI_ROW_VIEW_IMPL_HPP_
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Typed Column Reader
+ *
+ * Reads a single column of the current row with the sqlite3_column_* function
+ * matching the requested C++ type.  The catch-all is left undefined so that
+ * unsupported types fail at compile time.
+ */
+template <typename T>
+struct column_reader;
+
+// INTEGER reader
+template <>
+struct column_reader<int>
+{
+	static int read(sqlite3_stmt * s, int idx)
+	{
+		return sqlite3_column_int(s, idx);
+	}
+};
+
+// INT64 reader (int64_t and time_t are one of long or long long)
+template <>
+struct column_reader<long>
+{
+	static long read(sqlite3_stmt * s, int idx)
+	{
+		return sqlite3_column_int64(s, idx);
+	}
+};
+
+template <>
+struct column_reader<long long>
+{
+	static long long read(sqlite3_stmt * s, int idx)
+	{
+		return sqlite3_column_int64(s, idx);
+	}
+};
+
+// BOOLEAN reader
+template <>
+struct column_reader<bool>
+{
+	static bool read(sqlite3_stmt * s, int idx)
+	{
+		return sqlite3_column_int(s, idx) != 0;
+	}
+};
+
+// FLOAT reader
+template <>
+struct column_reader<double>
+{
+	static double read(sqlite3_stmt * s, int idx)
+	{
+		return sqlite3_column_double(s, idx);
+	}
+};
+
+// TEXT reference reader
+template <>
+struct column_reader<text_ref>
+{
+	static text_ref read(sqlite3_stmt * s, int idx)
+	{
+		const char * p = (const char *)sqlite3_column_text(s, idx);
+		return text_ref(p, sqlite3_column_bytes(s, idx));
+	}
+};
+
+// TEXT reader
+template <>
+struct column_reader<std::string>
+{
+	static std::string read(sqlite3_stmt * s, int idx)
+	{
+		text_ref t = column_reader<text_ref>::read(s, idx);
+		return t.data ? std::string(t.data, t.size) : std::string();
+	}
+};
+
+// BLOB reference reader
+template <>
+struct column_reader<blob_ref>
+{
+	static blob_ref read(sqlite3_stmt * s, int idx)
+	{
+		const unsigned char * p = (const unsigned char *)sqlite3_column_blob(s, idx);
+		return blob_ref(p, sqlite3_column_bytes(s, idx));
+	}
+};
+
+// BLOB reader
+template <>
+struct column_reader<std::vector<unsigned char> >
+{
+	static std::vector<unsigned char> read(sqlite3_stmt * s, int idx)
+	{
+		blob_ref b = column_reader<blob_ref>::read(s, idx);
+		return b.data ? std::vector<unsigned char>(b.data, b.data + b.size) : std::vector<unsigned char>();
+	}
+};
+
+// Nullable reader
+template <typename T>
+struct column_reader<boost::optional<T> >
+{
+	static boost::optional<T> read(sqlite3_stmt * s, int idx)
+	{
+		if (sqlite3_column_type(s, idx) == SQLITE_NULL)
+			return boost::optional<T>();
+		return boost::optional<T>(column_reader<T>::read(s, idx));
+	}
+};
+
+/**
+ * @brief Typed Variant Reader
+ *
+ * Reads a single column of a copied row from its variant, following the
+ * conversions of the matching column_reader where the variant does not
+ * provide them itself.
+ */
+template <typename T>
+struct variant_reader
+{
+	static T read(const variant & v)
+	{
+		return v.as<T>();
+	}
+};
+
+// INT64 reader (int64_t and time_t are one of long or long long)
+template <>
+struct variant_reader<long>
+{
+	static long read(const variant & v)
+	{
+		return (long)v.as<int64_t>();
+	}
+};
+
+template <>
+struct variant_reader<long long>
+{
+	static long long read(const variant & v)
+	{
+		return (long long)v.as<int64_t>();
+	}
+};
+
+// BOOLEAN reader
+template <>
+struct variant_reader<bool>
+{
+	static bool read(const variant & v)
+	{
+		return v.as<int64_t>() != 0;
+	}
+};
+
+// TEXT reference reader
+template <>
+struct variant_reader<text_ref>
+{
+	static text_ref read(const variant & v)
+	{
+		return v.is_null() ? text_ref() : v.text();
+	}
+};
+
+// BLOB reference reader
+template <>
+struct variant_reader<blob_ref>
+{
+	static blob_ref read(const variant & v)
+	{
+		return v.is_null() ? blob_ref() : v.blob();
+	}
+};
+
+// Nullable reader
+template <typename T>
+struct variant_reader<boost::optional<T> >
+{
+	static boost::optional<T> read(const variant & v)
+	{
+		if (v.is_null())
+			return boost::optional<T>();
+		return boost::optional<T>(variant_reader<T>::read(v));
+	}
+};
+
+/**
+ * @brief Compile-Time Column Index List
+ *
+ * Used to expand a parameter pack of column types into the sequence of
+ * column_reader calls 0, 1, ..., N-1 when decoding a row into a tuple.
+ */
+template <int... Is>
+struct index_list { };
+
+template <int N, int... Is>
+struct make_index_list: make_index_list<N - 1, N - 1, Is...> { };
+
+template <int... Is>
+struct make_index_list<0, Is...>
+{
+	typedef index_list<Is...> type;
+};
+
+/**
+ * @brief Typed Row Reader
+ *
+ * Decodes the first sizeof...(Ts) columns of the current row into a tuple,
+ * selecting the sqlite3_column_* function for each column at compile time.
+ */
+template <typename... Ts>
+struct tuple_reader
+{
+	typedef std::tuple<Ts...> result_type;
+
+	static result_type read(sqlite3_stmt * s)
+	{
+		return read(s, typename make_index_list<sizeof...(Ts)>::type());
+	}
+
+	static result_type read(const variant * v)
+	{
+		return read(v, typename make_index_list<sizeof...(Ts)>::type());
+	}
+
+	template <int... Is>
+	static result_type read(sqlite3_stmt * s, index_list<Is...>)
+	{
+		return result_type(column_reader<Ts>::read(s, Is)...);
+	}
+
+	template <int... Is>
+	static result_type read(const variant * v, index_list<Is...>)
+	{
+		return result_type(variant_reader<Ts>::read(v[Is])...);
+	}
+};
+
+template <typename T>
+T row_view::as(int idx) const
+{
+	check_index(idx);
+	if (m_values)
+		return m_values[idx].is_null() ? T() : variant_reader<T>::read(m_values[idx]);
+	if (sqlite3_column_type(m_stmt, idx) == SQLITE_NULL)
+		return T();
+	return column_reader<T>::read(m_stmt, idx);
+}
+
+template <typename T>
+boost::optional<T> row_view::get_optional(int idx) const
+{
+	check_index(idx);
+	if (m_values)
+		return variant_reader<boost::optional<T> >::read(m_values[idx]);
+	if (sqlite3_column_type(m_stmt, idx) == SQLITE_NULL)
+		return boost::optional<T>();
+	return boost::optional<T>(column_reader<T>::read(m_stmt, idx));
+}
+
+template <typename... Ts>
+std::tuple<Ts...> row_view::as_tuple() const
+{
+	if ((int)sizeof...(Ts) > m_ncols)
+		throw std::out_of_range("Too many columns requested from the row");
+	if (m_values)
+		return tuple_reader<Ts...>::read(m_values);
+	return tuple_reader<Ts...>::read(m_stmt);
+}
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_ROW_VIEW_IMPL_HPP_ */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_SNAPSHOT_HPP_
+#define DBAPI_SNAPSHOT_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/snapshot.hpp
+ * @brief DBAPI Read Snapshot Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <benthos/logbook/config.hpp>
+#include <benthos/logbook/dbapi/connection.hpp>
+
+#include <sqlite3.h>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Read Snapshot Class
+ *
+ * Pins a consistent, read-only view of a WAL-mode database.  The snapshot
+ * opens a read transaction on its connection and keeps it open for its
+ * lifetime, so every query run on that connection sees the database as it
+ * was when the snapshot was taken, regardless of what writers commit in
+ * the meantime.  Writers are never blocked by the snapshot, though the WAL
+ * cannot be checkpointed past it, so snapshots should not be held longer
+ * than necessary.
+ *
+ * When the SQLite3 library is built with SQLITE_ENABLE_SNAPSHOT, the view
+ * can be shared with other connections to the same database with open(),
+ * which uses sqlite3_snapshot_get() and sqlite3_snapshot_open().  Without
+ * it, supported() returns false and the view is only available through the
+ * snapshot's own connection.
+ *
+ * The read transaction is started with a plain BEGIN rather than through
+ * connection::begin(), so Sessions bound to the connection do not roll it
+ * back when they are destroyed.  It is ended when the snapshot is destroyed
+ * if the snapshot holds the last reference to the connection, and otherwise
+ * when the connection is returned to its connection_pool.
+ */
+class snapshot: public boost::noncopyable
+{
+public:
+	typedef boost::shared_ptr<snapshot>	ptr;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Database Connection
+	 * @param[in] Database Name
+	 * @throws dbapi_error
+	 *
+	 * Starts a read transaction on the connection, which must not have a
+	 * transaction open, and pins the current state of the database.
+	 */
+	snapshot(connection::ptr conn, const std::string & db = "main");
+
+	//! Class Destructor
+	~snapshot();
+
+	//! @return Snapshot Connection
+	connection::ptr conn() const;
+
+	/**
+	 * @brief Open the Snapshot on another Connection
+	 * @param[in] Database Connection
+	 * @throws dbapi_error if snapshots are not supported or the Snapshot is
+	 *   no longer available
+	 *
+	 * Starts a read transaction on the connection which sees the same state
+	 * of the database as this snapshot.  The connection must be open on the
+	 * same database file and must not have a transaction open.
+	 */
+	void open(connection::ptr conn) const;
+
+	//! @return True if Snapshots can be shared between Connections
+	static bool supported();
+
+private:
+	connection::ptr		m_conn;			///< Snapshot Connection
+	std::string			m_db;			///< Database Name
+
+#ifdef HAVE_SQLITE3_SNAPSHOT
+	sqlite3_snapshot *	m_snapshot;		///< SQLite3 Snapshot Handle
+#endif
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_SNAPSHOT_HPP_ */
@@ -39,13 +39,17 @@
 
 #include <cstdint>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 
 #include <benthos/logbook/dbapi/connection.hpp>
+#include <benthos/logbook/dbapi/row_view.hpp>
 #include <benthos/logbook/dbapi/variant.hpp>
 
 #include <sqlite3.h>
@@ -85,6 +89,18 @@ class statement: public boost::noncopyable,
 public:
 	typedef boost::shared_ptr<statement>	ptr;
 
+	//! Parameter Values for one Execution of the Statement
+	typedef std::vector<variant>			params_t;
+
+	/**
+	 * @brief Parameter Generator Function
+	 *
+	 * Called by executemany() before each execution of the statement.  The
+	 * generator should bind the parameters for the next execution and return
+	 * true, or return false when there are no more parameter sets.
+	 */
+	typedef boost::function<bool (statement &)>	param_generator;
+
 public:
 
 	/**
@@ -98,7 +114,12 @@ public:
 	 */
 	statement(connection::ptr conn, const std::string & sql);
 
-	//! @brief Class Destructor
+	/**
+	 * @brief Class Destructor
+	 *
+	 * Finalizes the statement, or returns it to the connection's statement
+	 * cache if it was obtained through connection::prepare().
+	 */
 	virtual ~statement();
 
 	/**@{
@@ -154,6 +175,42 @@ public:
 	void bind(int idx);
 	/*@}*/
 
+	/**@{
+	 * @brief Bind a Reference-Counted Text or Blob Parameter without Copying
+	 * @param[in] Parameter Index
+	 * @param[in] Shared Buffer (NULL binds a NULL value)
+	 * @throws bind_error
+	 *
+	 * Binds the buffer in place and keeps a reference to it, so SQLite never
+	 * copies the data and the buffer stays alive for as long as SQLite may
+	 * read it.  The reference is released when the parameter is bound to
+	 * another shared buffer, when clear_bindings() is called or when the
+	 * statement is destroyed.  The buffer must not be modified meanwhile.
+	 */
+	void bind_shared(int idx, boost::shared_ptr<const std::string> value);
+	void bind_shared(int idx, boost::shared_ptr<const std::vector<unsigned char> > value);
+	/*@}*/
+
+	/**@{
+	 * @brief Bind a Caller-Owned Text or Blob Parameter without Copying
+	 * @param[in] Parameter Index
+	 * @param[in] Bind Value
+	 * @throws bind_error
+	 *
+	 * Binds the value with SQLITE_STATIC, so SQLite reads the caller's buffer
+	 * in place instead of copying it.  The caller must keep the buffer alive
+	 * and unchanged until the statement has been executed and the parameter
+	 * has been rebound or the bindings cleared with clear_bindings().  This
+	 * is intended for values owned by domain objects which are bound and
+	 * executed in one step, such as by Mapper::bindUpdate().
+	 */
+	void bind_static(int idx, const text_ref & value);
+	void bind_static(int idx, const blob_ref & value);
+	void bind_static(int idx, const std::string & value);
+	void bind_static(int idx, const std::vector<unsigned char> & value);
+	void bind_static(int idx, const boost::optional<std::string> & value);
+	/*@}*/
+
 	/**
 	 * @brief Execute the Prepared Statement
 	 * @return Database Cursor
@@ -163,6 +220,36 @@ public:
 	 */
 	boost::shared_ptr<cursor> exec();
 
+	/**
+	 * @brief Execute the Prepared Statement to Completion
+	 * @return Number of Rows Changed
+	 * @throws sql_error
+	 *
+	 * Steps the statement until it is done, discarding any result rows, and
+	 * resets it.  Bound parameters are retained.  Unlike exec(), no cursor is
+	 * allocated, so this is the preferred way to run INSERT, UPDATE and
+	 * DELETE statements.
+	 */
+	size_t execute();
+
+	/**@{
+	 * @brief Execute the Prepared Statement for a Batch of Parameters
+	 * @param[in] Batch of Parameter Sets, or Parameter Generator
+	 * @return Total Number of Rows Changed
+	 * @throws sql_error, bind_error
+	 *
+	 * Executes the statement once for each set of parameters, in a tight
+	 * bind/step/reset loop which does not allocate a cursor per execution.
+	 * Bindings are cleared before each execution, so parameters which are
+	 * not supplied are bound as NULL.  Parameter sets in a batch are bound
+	 * by index starting from 1, in place since the batch outlives the call,
+	 * and the bindings are cleared afterwards.  Any result rows are
+	 * discarded.
+	 */
+	size_t executemany(const std::vector<params_t> & batch);
+	size_t executemany(param_generator gen);
+	/*@}*/
+
 	/**
 	 * @brief Execute the Prepared Statement and return a Scalar
 	 * @return Scalar Value
@@ -176,6 +263,31 @@ public:
 	 */
 	variant exec_scalar();
 
+	/**
+	 * @brief Execute the Prepared Statement and decode all Rows
+	 * @return List of Tuples, one per Row
+	 * @throws sql_error
+	 *
+	 * Executes the statement with the currently bound parameters and decodes
+	 * each result row directly into a std::tuple<Ts...>, choosing the column
+	 * access functions at compile time.  Use boost::optional column types for
+	 * nullable columns.  The statement is reset afterwards.
+	 */
+	template <typename... Ts>
+	std::vector<std::tuple<Ts...> > query();
+
+	/**
+	 * @brief Execute the Prepared Statement and decode a Scalar
+	 * @return Value of the first Column of the first Row
+	 * @throws sql_error
+	 *
+	 * Typed counterpart to exec_scalar().  Returns a default-constructed
+	 * value (none for a boost::optional type) if there are no rows.  The
+	 * statement is reset afterwards.
+	 */
+	template <typename T>
+	T query_scalar();
+
 	/**
 	 * @brief Get the Parameter Index for a Parameter Name
 	 * @param[in] Parameter Name
@@ -190,6 +302,9 @@ public:
 	//! @return Statement Handle
 	sqlite3_stmt * handle() const;
 
+	//! @return Row Id of the most recently inserted Row on the Connection
+	int64_t last_rowid() const;
+
 	//! @return True if the Statement is a delete statement
 	bool is_delete() const;
 
@@ -234,20 +349,36 @@ public:
 	 */
 	std::string param_name(int index);
 
+	//! @brief Set all Bind Parameters to NULL
+	void clear_bindings();
+
 	//! @brief Reset the Bind Parameters
 	void reset();
 
+	/**
+	 * @brief Skip Bindings to Parameters the Statement does not use
+	 * @param[in] True to skip unused Parameter Indices
+	 *
+	 * Normally binding an index which is out of range raises a bind_error.
+	 * With this set, binds to any index the SQL text does not reference are
+	 * silently dropped, so a binder written for a wider statement (such as
+	 * Mapper::bindUpdate() for a partial UPDATE) can be reused as-is.
+	 */
+	void skip_unused(bool skip);
+
 	//! @return Statement SQL
 	const std::string & sql() const;
 
 	/**
 	 * @brief Advance the Result Set to the next Result
 	 * @return True if the Result has another Row
-	 * @throws sql_error
+	 * @throws sql_error, dbapi_error
 	 *
 	 * Calls sqlite3_step on the statement.  If SQLITE_ROW is returned, the
 	 * return value is true; if SQLITE_DONE is returned, the return value is
-	 * false.  If an error occurs, a sql_error is raised.
+	 * false.  If an error occurs, a sql_error is raised.  A dbapi_error is
+	 * raised if the connection is owned by another thread (see
+	 * connection::set_owner_thread()).
 	 */
 	bool step();
 
@@ -256,21 +387,63 @@ public:
 
 protected:
 
+	/**
+	 * @brief Cached Statement Constructor
+	 * @param[in] Database Connection
+	 * @param[in] SQL Statement
+	 * @param[in] Cached Statement Handle or NULL to prepare a new one
+	 * @throws sql_error
+	 *
+	 * Used by connection::prepare() to wrap a statement handle checked out
+	 * of the statement cache.  The handle is checked back in to the cache
+	 * when the statement is destroyed.
+	 */
+	statement(connection::ptr conn, const std::string & sql, sqlite3_stmt * stmt);
+
+	/**
+	 * @brief Prepare the Statement and cache its Parameters
+	 * @param[in] SQL Statement
+	 * @throws sql_error
+	 */
+	void init(const std::string & sql);
+
 	/**
 	 * @brief Check a Parameter Index for Validity
 	 * @param[in] Parameter Index
+	 * @return False if the Binding should be skipped
 	 * @throws bind_error
 	 *
 	 * Checks that the given parameter is in range for this statement and throws
-	 * an error if not.
+	 * an error if not.  Returns false instead of throwing for indices the
+	 * statement does not use when skip_unused() is set.
 	 */
-	void check_index(int index) const;
+	bool check_index(int index) const;
+
+	//! @return True if the SQL text references the Parameter Index
+	bool is_used(int index) const;
+
+	/**
+	 * @brief Bind a Variant with the given Text and Blob Destructor
+	 * @param[in] Parameter Index
+	 * @param[in] Bind Value
+	 * @param[in] SQLite3 Destructor (SQLITE_STATIC or SQLITE_TRANSIENT)
+	 *
+	 * Variants holding a shared buffer are always bound in place, with the
+	 * buffer owner kept alive as for bind_shared().
+	 */
+	void bind_value(int idx, const variant & value, sqlite3_destructor_type dtor);
+
+	//! Keep a Buffer bound to the given Parameter alive
+	void pin(int idx, boost::shared_ptr<const void> owner);
 
 private:
+	friend class connection;
 	friend class cursor;
 
 	connection::ptr				m_conn;
 	sqlite3_stmt * 				m_stmt;
+	bool						m_cached;
+	std::string					m_key;
 
 	std::string					m_sql;
 	std::string					m_tail;
@@ -279,6 +452,9 @@ private:
 	int 						m_nparams;
 	bool						m_readonly;
 	int							m_type;
+	bool						m_skip_unused;
+
+	std::vector<boost::shared_ptr<const void> >	m_pins;	///< Buffers bound in place
 
 };
 
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef DBAPI_STATEMENT_CACHE_HPP_
+#define DBAPI_STATEMENT_CACHE_HPP_
+
+/**
+ * @file include/benthos/logbook/dbapi/statement_cache.hpp
+ * @brief DBAPI Prepared Statement Cache Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <boost/utility.hpp>
+
+#include <sqlite3.h>
+
+namespace benthos { namespace logbook { namespace dbapi {
+
+/**
+ * @brief Prepared Statement Cache
+ *
+ * Bounded least-recently-used cache of idle SQLite3 prepared statement
+ * handles, keyed by the SQL text used to prepare them.  A handle is removed
+ * from the cache when it is checked out and is only put back when it is
+ * checked in again, so the same cached handle can never be stepped by two
+ * users at once.  If the same SQL is checked out twice, the second checkout
+ * is a miss and the caller must prepare a new handle.
+ *
+ * The cache is owned by a dbapi::connection and is normally used through
+ * connection::prepare(); it is not intended to be used directly.
+ */
+class statement_cache: public boost::noncopyable
+{
+public:
+
+	//! Default Maximum Number of Idle Statements
+	static const size_t default_capacity = 32;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Maximum Number of Idle Statements
+	 */
+	statement_cache(size_t capacity = default_capacity);
+
+	//! Class Destructor; finalizes all idle Statements
+	~statement_cache();
+
+	//! @return Maximum Number of Idle Statements
+	size_t capacity() const;
+
+	/**
+	 * @brief Check a Statement Handle back into the Cache
+	 * @param[in] SQL Text used to prepare the Statement
+	 * @param[in] Statement Handle
+	 *
+	 * Resets the statement and clears its bindings, then stores it as the
+	 * most recently used entry.  If an idle handle for the same SQL is
+	 * already cached, or the cache is disabled, the handle is finalized.
+	 * The least recently used handle is finalized if the cache is full.
+	 */
+	void checkin(const std::string & sql, sqlite3_stmt * stmt);
+
+	/**
+	 * @brief Check a Statement Handle out of the Cache
+	 * @param[in] SQL Text
+	 * @return Statement Handle or NULL on a Cache Miss
+	 *
+	 * Removes and returns the idle handle for the given SQL, updating the
+	 * hit and miss counters accordingly.
+	 */
+	sqlite3_stmt * checkout(const std::string & sql);
+
+	//! @brief Finalize all idle Statements
+	void clear();
+
+	//! @return Number of Cache Hits
+	size_t hits() const;
+
+	//! @return Number of Cache Misses
+	size_t misses() const;
+
+	//! @brief Reset the Hit and Miss Counters
+	void reset_stats();
+
+	/**
+	 * @brief Set the Maximum Number of Idle Statements
+	 * @param[in] Capacity
+	 *
+	 * Shrinking the cache finalizes the least recently used handles.  A
+	 * capacity of zero disables caching.
+	 */
+	void set_capacity(size_t capacity);
+
+	//! @return Number of idle Statements in the Cache
+	size_t size() const;
+
+protected:
+
+	//! Finalize least recently used Statements until the Cache fits
+	void evict(size_t capacity);
+
+private:
+	typedef std::pair<std::string, sqlite3_stmt *>		entry_t;
+	typedef std::list<entry_t>							lru_t;
+	typedef std::map<std::string, lru_t::iterator>		index_t;
+
+	lru_t				m_lru;			///< Idle Statements, most recent first
+	index_t				m_index;		///< SQL Text to LRU Entry Index
+
+	size_t				m_capacity;		///< Maximum Number of Idle Statements
+	size_t				m_hits;			///< Cache Hit Counter
+	size_t				m_misses;		///< Cache Miss Counter
+
+};
+
+} } } /* benthos::logbook::dbapi */
+
+#endif /* DBAPI_STATEMENT_CACHE_HPP_ */
@@ -37,21 +37,35 @@ using namespace benthos::logbook::dbapi;
 
 /**
  * @brief Parameter Bind Helper Class
+ *
+ * Binds a value directly with the matching sqlite3_bind_* function.  Values
+ * are passed through by reference (text and blob values as text_ref and
+ * blob_ref when coming from a variant), so binding does not build any
+ * intermediate copies.  Text and blob data is copied by SQLite unless the
+ * binder is given SQLITE_STATIC, in which case the caller guarantees that
+ * the data outlives the binding.
  */
 struct binder: public boost::static_visitor<int>
 {
 	mutable sqlite3_stmt * 	stmt;
 	int						colidx;
+	sqlite3_destructor_type	dtor;
+
+	binder(sqlite3_stmt * s, int idx, sqlite3_destructor_type d = SQLITE_TRANSIENT)
+		: stmt(s), colidx(idx), dtor(d)
+	{
+	}
 
-	binder(sqlite3_stmt * s, int idx)
-		: stmt(s), colidx(idx)
+	// BLOB binder
+	int operator() (const blob_ref & v) const
 	{
+		return sqlite3_bind_blob(stmt, colidx, v.data, v.size, dtor);
 	}
 
 	// BLOB binder
 	int operator() (const std::vector<unsigned char> & v) const
 	{
-		return sqlite3_bind_blob(stmt, colidx, & v[0], v.size(), SQLITE_TRANSIENT);
+		return sqlite3_bind_blob(stmt, colidx, v.empty() ? 0 : & v[0], v.size(), dtor);
 	}
 
 	// FLOAT binder
@@ -60,37 +74,91 @@ struct binder: public boost::static_visitor<int>
 		return sqlite3_bind_double(stmt, colidx, v);
 	}
 
+	// FLOAT binder
+	int operator() (const float & v) const
+	{
+		return sqlite3_bind_double(stmt, colidx, v);
+	}
+
 	// INTEGER binder
 	int operator() (const int & v) const
 	{
 		return sqlite3_bind_int(stmt, colidx, v);
 	}
 
-	// INT64 binder
-	int operator() (const int64_t & v) const
+	// INTEGER binder (bool and short are promoted to int)
+	int operator() (const bool & v) const
+	{
+		return sqlite3_bind_int(stmt, colidx, v ? 1 : 0);
+	}
+
+	int operator() (const short & v) const
+	{
+		return sqlite3_bind_int(stmt, colidx, v);
+	}
+
+	int operator() (const unsigned short & v) const
+	{
+		return sqlite3_bind_int(stmt, colidx, v);
+	}
+
+	// INT64 binder (int64_t and time_t are one of long or long long)
+	int operator() (const long & v) const
 	{
 		return sqlite3_bind_int64(stmt, colidx, v);
 	}
 
+	int operator() (const long long & v) const
+	{
+		return sqlite3_bind_int64(stmt, colidx, v);
+	}
+
+	int operator() (const unsigned int & v) const
+	{
+		return sqlite3_bind_int64(stmt, colidx, v);
+	}
+
+	int operator() (const unsigned long & v) const
+	{
+		return sqlite3_bind_int64(stmt, colidx, (sqlite3_int64)v);
+	}
+
+	int operator() (const unsigned long long & v) const
+	{
+		return sqlite3_bind_int64(stmt, colidx, (sqlite3_int64)v);
+	}
+
 	// NULL binder
 	int operator() () const
 	{
 		return sqlite3_bind_null(stmt, colidx);
 	}
 
+	// TEXT binder
+	int operator() (const text_ref & v) const
+	{
+		return sqlite3_bind_text(stmt, colidx, v.data, v.size, dtor);
+	}
+
 	// TEXT binder
 	int operator() (const std::string & v) const
 	{
-		return sqlite3_bind_text(stmt, colidx, v.c_str(), v.size(), SQLITE_TRANSIENT);
+		return sqlite3_bind_text(stmt, colidx, v.c_str(), v.size(), dtor);
+	}
+
+	// TEXT binder
+	int operator() (const char * v) const
+	{
+		return sqlite3_bind_text(stmt, colidx, v, -1, dtor);
 	}
 };
 
 template <typename T>
 void statement::bind(int idx, const T & value)
 {
-	check_index(idx);
-	sqlite_value v(value);
-	int rc = boost::apply_visitor(binder(m_stmt, idx), v);
+	if (! check_index(idx))
+		return;
+	int rc = binder(m_stmt, idx)(value);
 	if (rc != SQLITE_OK)
 		throw bind_error(m_conn);
 }
@@ -98,7 +166,8 @@ void statement::bind(int idx, const T & value)
 template <typename T>
 void statement::bind(int idx, const boost::optional<T> & value)
 {
-	check_index(idx);
+	if (! check_index(idx))
+		return;
 	if (! value.is_initialized())
 		bind(idx);
 	else
@@ -117,4 +186,49 @@ void statement::bind(const std::string & name, const boost::optional<T> & value)
 	bind<boost::optional<T> >(find_index(name), value);
 }
 
+template <typename... Ts>
+std::vector<std::tuple<Ts...> > statement::query()
+{
+	std::vector<std::tuple<Ts...> > result;
+	if ((int)sizeof...(Ts) > m_ncolumns)
+		throw std::out_of_range("Too many columns requested from the statement");
+
+	try
+	{
+		while (step())
+			result.push_back(tuple_reader<Ts...>::read(m_stmt));
+	}
+	catch (...)
+	{
+		// Do not leave the statement holding its read transaction open
+		sqlite3_reset(m_stmt);
+		throw;
+	}
+
+	sqlite3_reset(m_stmt);
+	return result;
+}
+
+template <typename T>
+T statement::query_scalar()
+{
+	if (m_ncolumns < 1)
+		throw std::out_of_range("Statement does not return any columns");
+
+	T result = T();
+	try
+	{
+		if (step())
+			result = column_reader<T>::read(m_stmt, 0);
+	}
+	catch (...)
+	{
+		sqlite3_reset(m_stmt);
+		throw;
+	}
+
+	sqlite3_reset(m_stmt);
+	return result;
+}
+
 #endif /* DBAPI_STATEMENT_IMPL_HPP_ */
@@ -40,44 +40,103 @@
  * SQLite supports integer, float, text, and blob types natively; this class
  * provides support for all four along with conversion convenience functions.
  *
- * This class employs boost::optional and boost::variant as the underlying
- * value holder.  Note that strings may be either ASCII or UTF-8 formatted;
- * UTF-16 is not supported by sqlitekit.
+ * The value is held in a tagged union with a null tag, so no additional
+ * discriminator or optional wrapper is needed.  Short text and blob values
+ * are stored inline; longer values are held in an immutable heap buffer
+ * which is shared between copies, or may be borrowed from storage owned by
+ * someone else (e.g. SQLite column data).  Note that strings may be either
+ * ASCII or UTF-8 formatted; UTF-16 is not supported by sqlitekit.
  */
 
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <boost/optional.hpp>
-#include <boost/variant.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/variant/get.hpp>
+#include <boost/variant/static_visitor.hpp>
 
 namespace benthos { namespace logbook { namespace dbapi {
 
 /**
- * @brief SQLite Value Variant
+ * @brief Text Reference
  *
- * Value holder type which can hold either an integer (or int64), floating
- * point, string, or binary blob type.  Due to the "never empty" guarantee of
- * boost::variant, this class will always contain a value (cannot be null).
+ * Non-owning reference to a TEXT value, for instance one held by SQLite for
+ * the current row of a statement.  Text references returned by row_view are
+ * only valid until the statement is stepped, reset or finalized.
  */
-typedef boost::variant<int, int64_t, double, std::string, std::vector<unsigned char> > sqlite_value;
+struct text_ref
+{
+	const char *	data;		///< Pointer to the UTF-8 Text (not NUL-terminated)
+	size_t			size;		///< Length of the Text in Bytes
+
+	text_ref() : data(0), size(0) { }
+	text_ref(const char * d, size_t n) : data(d), size(n) { }
+
+	//! @return True if the Text is empty
+	bool empty() const { return size == 0; }
+
+	//! @return Copy of the Text as a std::string
+	std::string str() const { return std::string(data, size); }
+};
 
 /**
- * @brief SQLite Optional Value Variant
+ * @brief Blob Reference
  *
- * Wrapper class around sqlite_value which allows the value to be NULL.
+ * Non-owning reference to a BLOB value, for instance one held by SQLite for
+ * the current row of a statement.  Blob references returned by row_view are
+ * only valid until the statement is stepped, reset or finalized.
  */
-typedef boost::optional<sqlite_value> sqlite_variant;
+struct blob_ref
+{
+	const unsigned char *	data;		///< Pointer to the Blob Data
+	size_t					size;		///< Length of the Blob in Bytes
+
+	blob_ref() : data(0), size(0) { }
+	blob_ref(const unsigned char * d, size_t n) : data(d), size(n) { }
+
+	//! @return True if the Blob is empty
+	bool empty() const { return size == 0; }
+
+	//! @return Copy of the Blob as a std::vector
+	std::vector<unsigned char> vec() const { return std::vector<unsigned char>(data, data + size); }
+};
 
 /**
  * @brief SQLiteKit Variant Class
  *
- * Wrapper class around sqlite_variant to provide convenience conversion
- * methods and assignment/get operators.
+ * Value holder type which can be null or hold an integer (or int64),
+ * floating point, text, or binary blob value, with convenience conversion
+ * methods and assignment/get operators.  Text values are accessed as
+ * std::string or text_ref and blob values as std::vector<unsigned char> or
+ * blob_ref.
+ *
+ * Copying a variant never copies a heap buffer; shared buffers are reference
+ * counted and borrowed buffers are simply referenced.  A borrowed variant
+ * (and all of its copies) is only valid as long as the borrowed storage.
  */
 class variant
 {
+public:
+
+	//! Value Types
+	enum type_t
+	{
+		null_type,				///< NULL
+		int_type,				///< 32-bit Integer
+		int64_type,				///< 64-bit Integer
+		double_type,			///< Floating Point
+		text_type,				///< Text
+		blob_type				///< Binary Blob
+	};
+
+	//! Maximum Size of Text and Blob Values stored inline
+	static const size_t small_capacity = 30;
+
 public:
 
 	//! Default Constructor
@@ -86,6 +145,9 @@ public:
 	//! Copy Constructor
 	variant(const variant & v);
 
+	//! Move Constructor
+	variant(variant && v);
+
 	//! Initializer Constructor
 	template <typename T>
 	explicit variant(const T & v);
@@ -94,18 +156,75 @@ public:
 	template <typename T>
 	explicit variant(const boost::optional<T> & v);
 
+	//! Initializer Constructor; takes ownership of the String
+	explicit variant(std::string && v);
+
+	//! Initializer Constructor; takes ownership of the Blob
+	explicit variant(std::vector<unsigned char> && v);
+
 	//! Class Destructor
 	~variant();
 
 	//! Assignment Operator
 	variant & operator= (const variant & v);
 
+	//! Move Assignment Operator
+	variant & operator= (variant && v);
+
 	//! Templated Assignment Operator
 	template <typename T>
 	variant & operator= (const T & v);
 
 public:
 
+	/**
+	 * @brief Create a Variant which borrows a Text Value
+	 * @param[in] Text Reference
+	 * @return Variant
+	 *
+	 * The text is not copied, so it must outlive the variant and any copies
+	 * of it.  This is used to pass column data between statements without
+	 * copying it.
+	 */
+	static variant borrowed(const text_ref & t);
+
+	/**
+	 * @brief Create a Variant which borrows a Blob Value
+	 * @param[in] Blob Reference
+	 * @return Variant
+	 * @see borrowed(const text_ref &)
+	 */
+	static variant borrowed(const blob_ref & b);
+
+	/**
+	 * @brief Create a Variant which shares a Text Value
+	 * @param[in] Shared String
+	 * @return Variant
+	 */
+	static variant shared(boost::shared_ptr<const std::string> s);
+
+	/**
+	 * @brief Create a Variant which shares a Blob Value
+	 * @param[in] Shared Blob
+	 * @return Variant
+	 */
+	static variant shared(boost::shared_ptr<const std::vector<unsigned char> > b);
+
+public:
+
+	/**
+	 * @brief Apply a Visitor to the Value
+	 * @param[in] Visitor
+	 * @return Visitor Result
+	 *
+	 * Calls the visitor with the value as an int, int64_t, double, text_ref
+	 * or blob_ref.  The visitor must define a result_type typedef (e.g. by
+	 * deriving from boost::static_visitor).  Throws a std::runtime_error if
+	 * the value is null.
+	 */
+	template <typename V>
+	typename V::result_type apply_visitor(const V & v) const;
+
 	/**
 	 * @brief Cast the Variant to the specified type
 	 * @return Typecast Result
@@ -117,6 +236,9 @@ public:
 	template <typename T>
 	T as() const;
 
+	//! @return Blob Value; throws boost::bad_get if the Value is not a Blob
+	blob_ref blob() const;
+
 	//! Set the Variant to a NULL (empty) value
 	void clear();
 
@@ -143,17 +265,107 @@ public:
 	template <typename T>
 	bool is() const;
 
+	//! @return Check whether the Value is borrowed
+	bool is_borrowed() const;
+
 	//! @return Check whether the Type is null
 	bool is_null() const;
 
-	//! @return Underlying Value
-	const sqlite_value & value() const;
+	//! @return Check whether the Value is held in a Shared Buffer
+	bool is_shared() const;
+
+	/**
+	 * @brief Return the Owner of a Shared Buffer
+	 * @return Buffer Owner, or NULL if the Value is not Shared
+	 *
+	 * Holding the owner keeps the data returned by text() or blob() valid
+	 * independently of the variant, which is used to bind shared values to
+	 * statements without copying them.
+	 */
+	boost::shared_ptr<const void> owner() const;
+
+	//! @return Text Value; throws boost::bad_get if the Value is not Text
+	text_ref text() const;
+
+	//! @return Value Type
+	type_t type() const;
 
 public:
 	friend std::ostream & operator<< (std::ostream & out, const variant & v);
 
 private:
-	sqlite_variant		m_value;
+
+	//! Storage Kinds for Text and Blob Values
+	enum storage_t
+	{
+		inline_storage,			///< Stored in m_small
+		shared_storage,			///< Shared Heap Buffer in m_large
+		borrowed_storage		///< Borrowed Buffer in m_large
+	};
+
+	//! Inline Text and Blob Storage
+	struct small_t
+	{
+		unsigned char			data[small_capacity];	///< Value Data
+		unsigned char			size;					///< Value Size
+	};
+
+	//! Shared or Borrowed Text and Blob Storage
+	struct large_t
+	{
+		const unsigned char *			data;	///< Value Data
+		size_t							size;	///< Value Size
+		boost::shared_ptr<const void>	owner;	///< Buffer Owner (NULL if borrowed)
+	};
+
+	void assign(bool v);
+	void assign(short v);
+	void assign(unsigned short v);
+	void assign(int v);
+	void assign(unsigned int v);
+	void assign(long v);
+	void assign(unsigned long v);
+	void assign(long long v);
+	void assign(unsigned long long v);
+	void assign(float v);
+	void assign(double v);
+	void assign(const char * v);
+	void assign(const std::string & v);
+	void assign(const std::vector<unsigned char> & v);
+	void assign(const text_ref & v);
+	void assign(const blob_ref & v);
+
+	//! Store a Text or Blob Value, copying it inline or into a Shared Buffer
+	void assign_data(type_t t, const unsigned char * data, size_t size);
+
+	//! Store a Text or Blob Value held in a Shared or Borrowed Buffer
+	void assign_large(type_t t, const unsigned char * data, size_t size,
+			boost::shared_ptr<const void> owner);
+
+	//! Copy the Value of another Variant into a cleared Variant
+	void copy_from(const variant & v);
+
+	//! Move the Value of another Variant into a cleared Variant
+	void move_from(variant & v);
+
+	//! @return Pointer to the Text or Blob Data
+	const unsigned char * data_ptr() const;
+
+	//! @return Size of the Text or Blob Data
+	size_t data_size() const;
+
+private:
+	union
+	{
+		int			m_int;			///< 32-bit Integer Value
+		int64_t		m_int64;		///< 64-bit Integer Value
+		double		m_double;		///< Floating Point Value
+		small_t		m_small;		///< Inline Text or Blob Value
+		large_t		m_large;		///< Shared or Borrowed Text or Blob Value
+	};
+
+	unsigned char	m_type;			///< Value Type (type_t)
+	unsigned char	m_storage;		///< Text or Blob Storage Kind (storage_t)
 
 };
 
@@ -27,20 +27,26 @@
  * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
  * WITH THE SOFTWARE.
  */
-
 #ifndef DBAPI_VARIANT_CONV_HPP_
 #define DBAPI_VARIANT_CONV_HPP_
 
 #include <boost/lexical_cast.hpp>
 #include <climits>
+#include <typeinfo>
 
 using namespace benthos::logbook::dbapi;
 
+/*
+ * Converters are called with the stored value as an int, int64_t, double,
+ * text_ref or blob_ref, so text and blob sources are converted directly from
+ * the variant's buffer without an intermediate copy.
+ */
+
 // Catch-all converter: throws runtime_error
 template <typename T, typename U>
 struct convert
 {
-	T operator() (const U & u) const
+	T operator() (const U &) const
 	{
 		throw std::runtime_error(std::string("Cannot convert from ") + typeid(U).name() + " to " + typeid(T).name());
 	}
@@ -183,54 +189,74 @@ struct convert<std::vector<unsigned char>, double>
 
 // STRING -> INTEGER converter
 template <>
-struct convert<int, std::string>
+struct convert<int, text_ref>
 {
-	int operator() (const std::string & v) const
+	int operator() (const text_ref & v) const
 	{
-		int64_t i = boost::lexical_cast<int64_t>(v);
+		int64_t i = boost::lexical_cast<int64_t>(v.data, v.size);
 		if ((i < INT_MIN) || (i > INT_MAX))
-			throw std::out_of_range("Value %ll is out of range for int" + boost::lexical_cast<int64_t>(i));
+			throw std::out_of_range("Value %ll is out of range for int" + boost::lexical_cast<std::string>(i));
 		return i;
 	}
 };
 
 // STRING -> INT64 converter
 template <>
-struct convert<int64_t, std::string>
+struct convert<int64_t, text_ref>
 {
-	int64_t operator() (const std::string & v) const
+	int64_t operator() (const text_ref & v) const
 	{
-		return boost::lexical_cast<int64_t>(v);
+		return boost::lexical_cast<int64_t>(v.data, v.size);
 	}
 };
 
 // STRING -> FLOAT converter
 template <>
-struct convert<double, std::string>
+struct convert<double, text_ref>
+{
+	double operator() (const text_ref & v) const
+	{
+		return boost::lexical_cast<double>(v.data, v.size);
+	}
+};
+
+// STRING -> STRING converter
+template <>
+struct convert<std::string, text_ref>
 {
-	double operator() (const std::string & v) const
+	std::string operator() (const text_ref & v) const
 	{
-		return boost::lexical_cast<double>(v);
+		return std::string(v.data, v.size);
 	}
 };
 
 // STRING -> BLOB converter
 template <>
-struct convert<std::vector<unsigned char>, std::string>
+struct convert<std::vector<unsigned char>, text_ref>
 {
-	std::vector<unsigned char> operator() (const std::string & v) const
+	std::vector<unsigned char> operator() (const text_ref & v) const
 	{
-		return std::vector<unsigned char>(v.begin(), v.end());
+		return std::vector<unsigned char>(v.data, v.data + v.size);
 	}
 };
 
 // BLOB -> STRING converter
 template <>
-struct convert<std::string, std::vector<unsigned char> >
+struct convert<std::string, blob_ref>
+{
+	std::string operator() (const blob_ref & v) const
+	{
+		return std::string(v.data, v.data + v.size);
+	}
+};
+
+// BLOB -> BLOB converter
+template <>
+struct convert<std::vector<unsigned char>, blob_ref>
 {
-	std::string operator() (const std::vector<unsigned char> & v) const
+	std::vector<unsigned char> operator() (const blob_ref & v) const
 	{
-		return std::string(v.begin(), v.end());
+		return std::vector<unsigned char>(v.data, v.data + v.size);
 	}
 };
 
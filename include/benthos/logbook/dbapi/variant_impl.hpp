@@ -27,7 +27,6 @@
  * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
  * WITH THE SOFTWARE.
  */
-
 #ifndef DBAPI_VARIANT_IMPL_HPP_
 #define DBAPI_VARIANT_IMPL_HPP_
 
@@ -35,27 +34,67 @@ using namespace benthos::logbook::dbapi;
 
 template <typename T>
 variant::variant(const T & v)
-	: m_value(v)
+	: m_type(null_type), m_storage(inline_storage)
 {
+	assign(v);
 }
 
 template <typename T>
 variant::variant(const boost::optional<T> & v)
-	: m_value(v)
+	: m_type(null_type), m_storage(inline_storage)
 {
+	if (v.is_initialized())
+		assign(v.get());
 }
 
 template <typename T>
 variant & variant::operator= (const T & v)
 {
-	if (! m_value.is_initialized())
-		m_value = sqlite_value(v);
-	else
-		m_value.get() = v;
-
+	clear();
+	assign(v);
 	return * this;
 }
 
+template <typename V>
+typename V::result_type variant::apply_visitor(const V & v) const
+{
+	switch (m_type)
+	{
+	case int_type:
+		return v(m_int);
+	case int64_type:
+		return v(m_int64);
+	case double_type:
+		return v(m_double);
+	case text_type:
+		return v(text_ref((const char *)data_ptr(), data_size()));
+	case blob_type:
+		return v(blob_ref(data_ptr(), data_size()));
+	default:
+		throw std::runtime_error("Value is null");
+	}
+}
+
+/**
+ * @brief Variant Type Trait
+ *
+ * Maps a C++ type to the variant type which holds it exactly, or -1 if no
+ * variant type holds the C++ type.
+ */
+template <typename T>
+struct variant_type_of
+{
+	enum { value = -1 };
+};
+
+template <> struct variant_type_of<int> { enum { value = variant::int_type }; };
+template <> struct variant_type_of<int64_t> { enum { value = variant::int64_type }; };
+template <> struct variant_type_of<double> { enum { value = variant::double_type }; };
+template <> struct variant_type_of<std::string> { enum { value = variant::text_type }; };
+template <> struct variant_type_of<text_ref> { enum { value = variant::text_type }; };
+template <> struct variant_type_of<std::vector<unsigned char> > { enum { value = variant::blob_type }; };
+template <> struct variant_type_of<blob_ref> { enum { value = variant::blob_type }; };
+
 template <typename T>
 struct cast_visitor: public boost::static_visitor<T>
 {
@@ -69,53 +108,33 @@ struct cast_visitor: public boost::static_visitor<T>
 template <typename T>
 T variant::as() const
 {
-	if (! m_value.is_initialized())
+	if (m_type == null_type)
 		return T();
-	return boost::apply_visitor(cast_visitor<T>(), m_value.get());
+	return apply_visitor(cast_visitor<T>());
 }
 
 template <typename T>
 T variant::get() const
 {
-	if (! m_value)
+	if (m_type == null_type)
 		throw std::runtime_error("Value is null");
-	return boost::get<T>(m_value.get());
+	if (! is<T>())
+		throw boost::bad_get();
+	return apply_visitor(cast_visitor<T>());
 }
 
 template <typename T>
 boost::optional<T> variant::get_optional() const
 {
-	if (! m_value)
+	if (m_type == null_type)
 		return boost::optional<T>();
-	return boost::optional<T>(boost::get<T>(m_value.get()));
+	return boost::optional<T>(get<T>());
 }
 
-template <typename T, typename U>
-struct is_class
-{
-	enum { value = false };
-};
-
-template <typename T>
-struct is_class<T, T>
-{
-	enum { value = true };
-};
-
-template <typename T>
-struct check_is_visitor : public boost::static_visitor<bool>
-{
-	template <typename U>
-	bool operator() (const U & v) const
-	{
-		return is_class<T, U>::value;
-	}
-};
-
 template <typename T>
 bool variant::is() const
 {
-	return m_value.is_initialized() && boost::apply_visitor(check_is_visitor<T>(), m_value.get());
+	return (m_type != null_type) && ((int)variant_type_of<T>::value == (int)m_type);
 }
 
 #endif /* DBAPI_VARIANT_IMPL_HPP_ */
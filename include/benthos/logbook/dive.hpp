@@ -47,11 +47,13 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/signals2.hpp>
 
+#include <benthos/logbook/dbapi/cancellation_token.hpp>
 #include <benthos/logbook/dbapi/variant.hpp>
 
 #include <benthos/logbook/collection.hpp>
 #include <benthos/logbook/dive_computer.hpp>
 #include <benthos/logbook/dive_site.hpp>
+#include <benthos/logbook/lazy_reference.hpp>
 #include <benthos/logbook/mapper.hpp>
 #include <benthos/logbook/mix.hpp>
 #include <benthos/logbook/persistent.hpp>
@@ -122,6 +124,11 @@ public:
 		//! @param[in] Tag to Remove
 		void remove(const std::string & tag);
 
+	private:
+
+		//! Mark the owning Dive as Modified
+		void changed();
+
 	private:
 		std::set<std::string, cicmp> 	m_items;
 		Dive::Ptr						m_dive;
@@ -441,6 +448,12 @@ public:
 	//! @internal Called when a Mix is deleted
 	void evtMixDeleted(AbstractMapper::Ptr, Persistent::Ptr);
 
+	//! @return Lazy Reference for the "computer", "mix", "site" or "tank" Attribute
+	virtual LazyReference * reference(const std::string & name);
+
+	//! @return "computer", "mix", "site" and "tank"
+	virtual std::vector<std::string> reference_names() const;
+
 protected:
 
 	//! Called when the Persistent is attached to a Session
@@ -454,8 +467,8 @@ private:
 	boost::optional<int>			m_utc_offset;	///< Dive UTC Offset
 	boost::optional<int>			m_number;		///< Dive Number
 
-	DiveSite::Ptr					m_site;			///< Dive Site
-	DiveComputer::Ptr				m_computer;		///< Dive Computer
+	TypedLazyReference<DiveSite>		m_site;			///< Dive Site
+	TypedLazyReference<DiveComputer>	m_computer;		///< Dive Computer
 
 	int								m_repetition;	///< Repetitive Dive Number
 	int								m_interval;		///< Surface Interval [minutes]
@@ -467,8 +480,8 @@ private:
 	boost::optional<double>			m_mintemp;		///< Dive Minimum Temperature [deg C]
 	boost::optional<double>			m_startpx;		///< Starting Tank Pressure [bar]
 	boost::optional<double>			m_endpx;		///< Ending Tank Pressure [bar]
-	Mix::Ptr						m_mix;			///< Primary Breathing Mix
-	Tank::Ptr						m_tank;			///< Primary Tank
+	TypedLazyReference<Mix>			m_mix;			///< Primary Breathing Mix
+	TypedLazyReference<Tank>		m_tank;			///< Primary Tank
 
 	boost::optional<std::string>	m_salinity;		///< Salinity ('fresh' or 'salt')
 	boost::optional<std::string>	m_comments;		///< Comments
@@ -537,6 +550,16 @@ struct IDiveFinder: public IFinder<Dive>
 	 */
 	virtual std::vector<Dive::Ptr> findRecentlyImported(unsigned int days, int max) = 0;
 
+	/**
+	 * @brief Find Dives imported within the given number of days
+	 * @param[in] Number of Days
+	 * @param[in] Maximum Number to Return
+	 * @param[in] Cancellation Token
+	 * @return List of Dives
+	 * @throws dbapi::interrupted_error if the Token is cancelled
+	 */
+	virtual std::vector<Dive::Ptr> findRecentlyImported(unsigned int days, int max, const dbapi::cancellation_token & token) = 0;
+
 	/**
 	 * @brief Find Dives from a given Dive Computer
 	 * @param[in] Dive Computer Id
@@ -551,6 +574,15 @@ struct IDiveFinder: public IFinder<Dive>
 	 */
 	virtual std::vector<Dive::Ptr> findByCountry(const country & country_) = 0;
 
+	/**
+	 * @brief Find Dives in a given Country
+	 * @param[in] Country
+	 * @param[in] Cancellation Token
+	 * @return List of Dives
+	 * @throws dbapi::interrupted_error if the Token is cancelled
+	 */
+	virtual std::vector<Dive::Ptr> findByCountry(const country & country_, const dbapi::cancellation_token & token) = 0;
+
 	/**
 	 * @brief Find Dives in a given Time Span
 	 * @param[in] Start Time
@@ -559,6 +591,16 @@ struct IDiveFinder: public IFinder<Dive>
 	 */
 	virtual std::vector<Dive::Ptr> findByDates(time_t start, time_t end) = 0;
 
+	/**
+	 * @brief Find Dives in a given Time Span
+	 * @param[in] Start Time
+	 * @param[in] End Time
+	 * @param[in] Cancellation Token
+	 * @return List of Dives
+	 * @throws dbapi::interrupted_error if the Token is cancelled
+	 */
+	virtual std::vector<Dive::Ptr> findByDates(time_t start, time_t end, const dbapi::cancellation_token & token) = 0;
+
 	/**
 	 * @brief Find Dives at a given Dive Site
 	 * @param[in] Dive Site Id
@@ -43,6 +43,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include <benthos/logbook/dive.hpp>
+#include <benthos/logbook/lazy_reference.hpp>
 #include <benthos/logbook/mix.hpp>
 #include <benthos/logbook/persistent.hpp>
 #include <benthos/logbook/tank.hpp>
@@ -124,6 +125,12 @@ public:
 	//! @internal Called when a Tank is deleted
 	void evtTankDeleted(AbstractMapper::Ptr, Persistent::Ptr);
 
+	//! @return Lazy Reference for the "dive", "mix" or "tank" Attribute
+	virtual LazyReference * reference(const std::string & name);
+
+	//! @return "dive", "mix" and "tank"
+	virtual std::vector<std::string> reference_names() const;
+
 protected:
 
 	//! Called when the Persistent is attached to a Session
@@ -133,10 +140,10 @@ protected:
 	virtual void detached(SessionPtr);
 
 private:
-	Dive::Ptr					m_dive;
+	TypedLazyReference<Dive>	m_dive;
 	int							m_index;
-	Tank::Ptr					m_tank;
-	Mix::Ptr					m_mix;
+	TypedLazyReference<Tank>	m_tank;
+	TypedLazyReference<Mix>		m_mix;
 	boost::optional<double>		m_pxstart;
 	boost::optional<double>		m_pxend;
 
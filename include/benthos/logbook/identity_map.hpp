@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef LOGBOOK_IDENTITY_MAP_HPP_
+#define LOGBOOK_IDENTITY_MAP_HPP_
+
+/**
+ * @file include/benthos/logbook/identity_map.hpp
+ * @brief Identity Map Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include <boost/utility.hpp>
+
+#include <benthos/logbook/persistent.hpp>
+
+namespace benthos { namespace logbook {
+
+/**
+ * @brief Identity Map Class
+ *
+ * Maps the key of each persisted object (its compact type identifier from
+ * Persistent::type_id() and its row identifier) to a weak reference to the
+ * single in-memory instance for that row, so that a Session never holds two
+ * instances of the same row.  The map is shared by the Session and all of
+ * its Mappers.
+ *
+ * Entries whose objects have been released are reclaimed incrementally:
+ * each insert() sweeps a few hash buckets, and find() drops the expired
+ * entry it looks up, so there is never a pause to sweep the whole map.
+ */
+class IdentityMap: public boost::noncopyable
+{
+public:
+
+	//! Number of Buckets swept for Expired Entries by each insert()
+	static const size_t default_reclaim_step = 2;
+
+public:
+
+	//! Class Constructor
+	IdentityMap();
+
+	//! Class Destructor
+	~IdentityMap();
+
+	//! @brief Remove all Entries
+	void clear();
+
+	/**
+	 * @brief Remove an Entry
+	 * @param[in] Compact Type Identifier
+	 * @param[in] Row Identifier
+	 */
+	void erase(uint32_t type_id, int64_t id);
+
+	/**
+	 * @brief Remove an Object's Entry
+	 * @param[in] Persistent Object
+	 *
+	 * Removes the entry for the object's key only if it refers to the object
+	 * (or has expired), so another instance registered under the same key is
+	 * left alone.
+	 */
+	void erase(Persistent::Ptr p);
+
+	/**
+	 * @brief Look up an Object
+	 * @param[in] Compact Type Identifier
+	 * @param[in] Row Identifier
+	 * @return Object or an empty pointer if no live Object is registered
+	 */
+	Persistent::Ptr find(uint32_t type_id, int64_t id);
+
+	/**
+	 * @brief Register an Object
+	 * @param[in] Persistent Object
+	 * @throws std::runtime_error if the Object has no Identifier
+	 *
+	 * Registers the object under its key, replacing any existing entry.
+	 */
+	void insert(Persistent::Ptr p);
+
+	/**
+	 * @brief Remove all Expired Entries
+	 * @return Number of Entries removed
+	 */
+	size_t purge();
+
+	/**
+	 * @brief Remove Expired Entries from the next Buckets
+	 * @param[in] Number of Buckets to sweep
+	 * @return Number of Entries removed
+	 *
+	 * Sweeps the given number of hash buckets for expired entries, resuming
+	 * where the previous call left off.
+	 */
+	size_t reclaim(size_t nbuckets);
+
+	//! @return Total Number of Expired Entries reclaimed
+	uint64_t reclaimed() const;
+
+	//! @return Number of Entries (including Expired Entries)
+	size_t size() const;
+
+private:
+
+	//! Identity Map Key
+	struct key_type
+	{
+		uint32_t	type_id;		///< Compact Type Identifier
+		int64_t		id;				///< Row Identifier
+
+		bool operator== (const key_type & other) const
+		{
+			return (id == other.id) && (type_id == other.type_id);
+		}
+	};
+
+	//! Identity Map Key Hash
+	struct key_hash
+	{
+		size_t operator() (const key_type & k) const
+		{
+			uint64_t h = ((uint64_t)k.id * 0x9E3779B97F4A7C15ULL) ^ k.type_id;
+			return (size_t)(h ^ (h >> 32));
+		}
+	};
+
+	typedef std::unordered_map<key_type, Persistent::WeakPtr, key_hash>	map_type;
+
+private:
+	map_type			m_map;			///< Entries
+	size_t				m_cursor;		///< Next Bucket to sweep
+	uint64_t			m_reclaimed;	///< Total Entries reclaimed
+
+};
+
+} } /* benthos::logbook */
+
+#endif /* LOGBOOK_IDENTITY_MAP_HPP_ */
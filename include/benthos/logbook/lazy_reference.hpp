@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef LOGBOOK_LAZY_REFERENCE_HPP_
+#define LOGBOOK_LAZY_REFERENCE_HPP_
+
+/**
+ * @file include/benthos/logbook/lazy_reference.hpp
+ * @brief Lazy Reference Classes
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstdint>
+#include <typeinfo>
+
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <benthos/logbook/persistent.hpp>
+
+namespace benthos { namespace logbook {
+
+/**
+ * @brief Lazy Reference Class
+ *
+ * Holds a reference from one Persistent object to another, such as the Dive
+ * Site of a Dive.  Mappers store only the foreign identifier when the
+ * referring object is loaded; the referenced object is resolved through the
+ * Session (and its identity map) the first time it is accessed, or in
+ * batches with Session::prefetch().
+ *
+ * Resolving a reference does not mark the referring object as modified.
+ */
+class LazyReference
+{
+protected:
+
+	//! Class Constructor
+	LazyReference(const std::type_info & type, uint32_t type_id);
+
+public:
+
+	//! Class Destructor
+	virtual ~LazyReference();
+
+public:
+
+	/**
+	 * @brief Defer the Reference to an Identifier
+	 * @param[in] Session used to Resolve the Reference
+	 * @param[in] Referenced Object Identifier
+	 *
+	 * Called by mappers when loading the referring object.  If the referenced
+	 * object is already in the Session identity map it is used at once.
+	 */
+	void defer(SessionPtr s, int64_t id);
+
+	/**
+	 * @brief Get the Referenced Object Identifier
+	 * @return Identifier or none if the Reference is NULL
+	 *
+	 * Does not load the referenced object.
+	 */
+	boost::optional<int64_t> id() const;
+
+	//! @return True if the Reference is NULL
+	bool is_null() const;
+
+	//! @return True if the Referenced Object is in Memory (or the Reference is NULL)
+	bool is_loaded() const;
+
+	//! @return Referenced Object if it is in Memory, without loading it
+	Persistent::Ptr loaded() const;
+
+	//! @return True if the Reference points to the given Object
+	bool refers_to(Persistent::Ptr p) const;
+
+	//! @brief Set the Reference to NULL
+	void reset();
+
+	/**
+	 * @brief Resolve the Reference with an Object loaded elsewhere
+	 * @param[in] Referenced Object
+	 *
+	 * Used by Session::prefetch(); the object must match the deferred
+	 * identifier.
+	 */
+	void resolve(Persistent::Ptr p);
+
+	//! @return Referenced Class
+	const std::type_info & type() const;
+
+	//! @return Referenced Class Type Id
+	uint32_t type_id() const;
+
+protected:
+
+	//! Set the Referenced Object
+	void assign(Persistent::Ptr p);
+
+	//! @return Referenced Object, loading it on first Access
+	Persistent::Ptr load() const;
+
+private:
+	const std::type_info *			m_type;		///< Referenced Class
+	uint32_t						m_type_id;	///< Referenced Class Type Id
+	int64_t							m_id;		///< Deferred Identifier (-1 if none)
+
+	mutable Persistent::Ptr			m_obj;		///< Referenced Object
+	mutable boost::weak_ptr<Session>	m_session;	///< Session to Resolve the Reference
+
+};
+
+/**
+ * @brief Typed Lazy Reference Class
+ *
+ * Lazy Reference to an object of the templated domain model class.
+ */
+template <class R>
+class TypedLazyReference: public LazyReference
+{
+public:
+
+	//! Class Constructor
+	TypedLazyReference()
+		: LazyReference(typeid(R), R::TypeId())
+	{
+	}
+
+	//! Class Constructor
+	TypedLazyReference(typename R::Ptr p)
+		: LazyReference(typeid(R), R::TypeId())
+	{
+		assign(p);
+	}
+
+	//! Class Destructor
+	virtual ~TypedLazyReference()
+	{
+	}
+
+public:
+
+	//! @return Referenced Object, loading it on first Access
+	typename R::Ptr get() const
+	{
+		return boost::dynamic_pointer_cast<R>(load());
+	}
+
+	//! Set the Referenced Object
+	TypedLazyReference<R> & operator= (typename R::Ptr p)
+	{
+		assign(p);
+		return * this;
+	}
+
+};
+
+} } /* benthos::logbook */
+
+#endif /* LOGBOOK_LAZY_REFERENCE_HPP_ */
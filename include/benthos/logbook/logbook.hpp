@@ -44,10 +44,12 @@
 #include <benthos/logbook/dbapi.hpp>
 #include <benthos/logbook/logging.hpp>
 
+#include <benthos/logbook/async_session.hpp>
 #include <benthos/logbook/dive_computer.hpp>
 #include <benthos/logbook/dive_site.hpp>
 #include <benthos/logbook/mix.hpp>
 #include <benthos/logbook/persistent.hpp>
+#include <benthos/logbook/reference_cache.hpp>
 #include <benthos/logbook/schema.hpp>
 #include <benthos/logbook/session.hpp>
 
@@ -71,8 +73,10 @@ protected:
 	 * @brief Class Constructor
 	 * @param[in] Logbook File Name
 	 * @param[in] Database Connection
+	 * @param[in] Connection Options
 	 */
-	Logbook(const std::string & filename, dbapi::connection::ptr conn);
+	Logbook(const std::string & filename, dbapi::connection::ptr conn,
+			const dbapi::connection_options & options);
 
 public:
 
@@ -82,6 +86,7 @@ public:
 	/**
 	 * @brief Open an existing Logbook file
 	 * @param[in] File Name
+	 * @param[in] Connection Options
 	 * @return Logbook Instance
 	 *
 	 * Opens the Logbook with the given file name.  If the file name does not
@@ -92,14 +97,21 @@ public:
 	 *
 	 * To upgrade a Logbook file's schema, use the static Logbook::Upgrade()
 	 * method.
+	 *
+	 * The connection options (e.g. connection_options::interactive()) are
+	 * applied to the Logbook connection and, where they apply, to the read
+	 * connections used by readSession().  If the options are read-only, the
+	 * Logbook Session is read-only as well.
 	 */
-	static Logbook::Ptr Open(const std::string & filename);
+	static Logbook::Ptr Open(const std::string & filename,
+			const dbapi::connection_options & options = dbapi::connection_options());
 
 	/**
 	 * @brief Create a new Logbook file
 	 * @param[in] File Name
 	 * @param[in] Creator Name
 	 * @param[in] Creator Version
+	 * @param[in] Connection Options
 	 * @return Logbook Instance
 	 *
 	 * Create a new, empty Logbook file and open it for use.  If the file exists
@@ -107,10 +119,13 @@ public:
 	 * latest schema defined by the Schema class.
 	 *
 	 * The database creator name and version will be set if the creator and
-	 * version parameters are non-default.
+	 * version parameters are non-default.  The connection options are applied
+	 * before the schema is created, so a page_size option takes effect; they
+	 * must not be read-only.
 	 */
 	static Logbook::Ptr Create(const std::string & filename,
-			const std::string & creator = std::string(), int version = 0);
+			const std::string & creator = std::string(), int version = 0,
+			const dbapi::connection_options & options = dbapi::connection_options());
 
 	/**
 	 * @brief Upgrade a Logbook file
@@ -127,19 +142,145 @@ public:
 
 public:
 
+	/**
+	 * @brief Open an Asynchronous Session
+	 * @return Asynchronous Session
+	 *
+	 * Creates a new read-only Session (see readSession()) and binds it to its
+	 * own executor thread, so that lookups can be issued without blocking
+	 * the calling thread and several lookups can be pipelined.
+	 */
+	AsyncSession::Ptr asyncSession() const;
+
+	/**
+	 * @brief Back up the Logbook to a File
+	 * @param[in] Backup File Name
+	 * @param[in] Progress Handler
+	 * @param[in] Number of Pages to copy per Step
+	 * @param[in] Time to sleep between Steps in milliseconds
+	 * @return True if the Backup finished, False if the Handler abandoned it
+	 * @throws dbapi::dbapi_error
+	 *
+	 * Makes a consistent copy of the open Logbook with dbapi::backup, which
+	 * copies a few pages at a time and sleeps between steps so the Logbook
+	 * can still be written while the backup runs.  The copy is read through
+	 * a pooled read-only connection when one is available, so the Logbook
+	 * connection is free for use by the calling thread's Session only if
+	 * the backup is run on another thread.  Any existing backup file is
+	 * overwritten; if the backup is abandoned the file is incomplete.
+	 */
+	bool backup(const std::string & filename,
+		dbapi::backup::progress_handler h = dbapi::backup::progress_handler(),
+		int pages = dbapi::backup::default_pages,
+		int sleep_ms = dbapi::backup::default_sleep_ms) const;
+
 	//! @return Database Connection
 	inline dbapi::connection::ptr connection() const { return m_conn; }
 
 	//! @return Logbook File Name
 	inline const std::string & filename() const { return m_filename; }
 
+	//! @return Database Connection Pool
+	inline dbapi::connection_pool::ptr pool() const { return m_pool; }
+
+	/**
+	 * @brief Open a Read-Only Session
+	 * @return Read-Only Database Session
+	 *
+	 * Creates a new Session bound to a read-only connection leased from the
+	 * Logbook's connection pool.  Read-only Sessions may be used concurrently
+	 * from different threads (one Session per thread) while the main Session
+	 * writes to the Logbook, since Logbook files are opened in WAL mode.  The
+	 * connection is returned to the pool when the Session is released.
+	 *
+	 * The Session uses the Logbook's Reference Cache, if one is set.
+	 */
+	Session::Ptr readSession() const;
+
+	//! @return Reference Cache, or an empty pointer if none is set
+	inline ReferenceCache::Ptr referenceCache() const { return m_refcache; }
+
+	/**
+	 * @brief Create an In-Memory Replica of the Logbook
+	 * @return In-Memory Database Connection
+	 * @throws dbapi::dbapi_error
+	 *
+	 * Copies the entire Logbook into a new in-memory database, which is set
+	 * to query-only mode.  The replica does not follow later changes to the
+	 * Logbook; it is intended for analytics which run many queries over a
+	 * snapshot, e.g. with Session::Create(lb->replica()).
+	 */
+	dbapi::connection::ptr replica() const;
+
 	//! @return Database Session
 	inline Session::Ptr session() const { return m_session; }
 
+	/**
+	 * @brief Take a Read Snapshot of the Logbook
+	 * @return Read Snapshot
+	 * @throws dbapi::dbapi_error if the Logbook is not in WAL mode
+	 *
+	 * Pins the current state of the Logbook on a pooled read-only connection.
+	 * Pass the snapshot to snapshotSession() to read from it.  The snapshot
+	 * does not block the Logbook Session from writing.
+	 */
+	dbapi::snapshot::ptr snapshot() const;
+
+	/**
+	 * @brief Set the Reference Cache
+	 * @param[in] Reference Cache, or an empty pointer to disable it
+	 *
+	 * Shares the rows of Mixes, Tanks, Dive Sites and Dive Computers between
+	 * the Logbook Session and all Sessions opened later by readSession() or
+	 * asyncSession(), usually through ReferenceCache::instance() so they are
+	 * shared with other Logbooks on the same file as well.  The cache follows
+	 * the changes made through the Logbook connection by replacing its
+	 * update, commit and rollback handlers.  Changes made by other processes
+	 * are not seen, so the cache should only be enabled by a process which
+	 * is the only writer of the Logbook.
+	 *
+	 * Snapshot Sessions do not use the cache, since they must not see rows
+	 * which changed after their snapshot was taken.  The Reference Cache is
+	 * not available for in-memory Logbooks.
+	 */
+	void setReferenceCache(ReferenceCache::Ptr cache);
+
+	/**
+	 * @brief Open a Snapshot Session
+	 * @param[in] Read Snapshot
+	 * @return Read-Only Database Session
+	 * @throws dbapi::dbapi_error
+	 *
+	 * Creates a read-only Session which sees the Logbook as it was when the
+	 * snapshot was taken, so that long-running reports get a stable view
+	 * even if the Logbook Session commits while they run.  Several Sessions
+	 * may be opened on the same snapshot; if dbapi::snapshot::supported(),
+	 * each is bound to its own pooled connection and may be used from its own
+	 * thread.  Otherwise the Sessions share the snapshot's connection and
+	 * must not be used from different threads at the same time.
+	 */
+	Session::Ptr snapshotSession(dbapi::snapshot::ptr snap) const;
+
+	/**
+	 * @brief Open a Snapshot Session on a new Snapshot
+	 * @return Read-Only Database Session
+	 * @throws dbapi::dbapi_error if the Logbook is not in WAL mode
+	 *
+	 * Shorthand for snapshotSession(snapshot()) for a single reader.
+	 */
+	Session::Ptr snapshotSession() const;
+
+protected:
+
+	//! @return Connection to read Backups from
+	dbapi::connection::ptr backupSource() const;
+
 private:
 	std::string					m_filename;	///< Logbook File Name
 	dbapi::connection::ptr		m_conn;		///< Database Connection
+	dbapi::connection_pool::ptr	m_pool;		///< Read Connection Pool
 	Session::Ptr				m_session;	///< Database Session
+	ReferenceCache::Ptr			m_refcache;	///< Reference Cache
 
 };
 
@@ -37,15 +37,20 @@
  * @author Jonathan Krauss <jkrauss@asymworks.com>
  */
 
+#include <algorithm>
 #include <list>
 #include <map>
+#include <string>
+#include <typeinfo>
 #include <vector>
 
+#include <boost/function.hpp>
 #include <boost/signals2/signal.hpp>
 #include <boost/utility.hpp>
 
 #include <benthos/logbook/dbapi.hpp>
 #include <benthos/logbook/persistent.hpp>
+#include <benthos/logbook/reference_cache.hpp>
 
 using namespace benthos::logbook::dbapi;
 
@@ -69,11 +74,33 @@ public:
 	typedef boost::shared_ptr<AbstractMapper>	Ptr;
 	typedef boost::weak_ptr<AbstractMapper>		WPtr;
 
+	//! List of Objects in a Batch Operation
+	typedef std::vector<Persistent::Ptr>		Batch;
+
+	//! Maximum Number of Identifiers bound to a single Bulk DELETE
+	static const size_t max_delete_batch = 500;
+
+	//! Maximum Number of Identifiers bound to a single Batch SELECT
+	static const size_t max_fetch_batch = 500;
+
 public:
 
-	//! Mapper Event Structure
+	/**
+	 * @brief Mapper Event Structure
+	 *
+	 * The batch signals are raised once for each batch of objects inserted,
+	 * updated or removed.  The per-object signals are raised as well unless
+	 * per-object event mode is switched off (see setPerObjectEvents()).
+	 */
 	typedef struct
 	{
+		boost::signals2::signal<void (Ptr, const Batch &)>		after_delete_batch;
+		boost::signals2::signal<void (Ptr, const Batch &)>		after_insert_batch;
+		boost::signals2::signal<void (Ptr, const Batch &)>		after_update_batch;
+		boost::signals2::signal<void (Ptr, const Batch &)>		before_delete_batch;
+		boost::signals2::signal<void (Ptr, const Batch &)>		before_insert_batch;
+		boost::signals2::signal<void (Ptr, const Batch &)>		before_update_batch;
+
 		boost::signals2::signal<void (Ptr, Persistent::Ptr)>	after_delete;
 		boost::signals2::signal<void (Ptr, Persistent::Ptr)>	after_insert;
 		boost::signals2::signal<void (Ptr, Persistent::Ptr)>	after_update;
@@ -83,6 +110,33 @@ public:
 
 	} Events;
 
+	/**
+	 * @brief Per-Object Batch Event Adapter
+	 *
+	 * Adapts a per-object event handler to a batch signal by calling it for
+	 * each object in the batch, e.g.
+	 *
+	 * @code
+	 * m->events().before_delete_batch.connect(AbstractMapper::ForEach(handler));
+	 * @endcode
+	 */
+	struct ForEach
+	{
+		typedef void result_type;
+		typedef boost::function<void (Ptr, Persistent::Ptr)> handler_t;
+
+		handler_t	fn;		///< Per-Object Handler
+
+		ForEach(const handler_t & f): fn(f) { }
+
+		void operator() (Ptr m, const Batch & objects) const
+		{
+			Batch::const_iterator it;
+			for (it = objects.begin(); it != objects.end(); it++)
+				fn(m, * it);
+		}
+	};
+
 public:
 
 	//! Class Constructor
@@ -114,6 +168,17 @@ public:
 	 */
 	virtual std::list<Persistent::Ptr> cascade_detach(Persistent::Ptr o);
 
+	/**
+	 * @brief Return the Domain Model Classes this Mapper depends on
+	 * @return List of Referenced Classes
+	 *
+	 * Returns the classes whose rows are referenced by foreign keys in this
+	 * mapper's table.  The Session flushes the objects of those classes
+	 * before the objects of this mapper so that new rows have their
+	 * identifiers assigned before they are referenced.
+	 */
+	virtual std::vector<const std::type_info *> dependencies() const;
+
 	//! @return Mapper Event Signals
 	Events & events();
 
@@ -125,6 +190,48 @@ public:
 	 */
 	int64_t insert(Persistent::Ptr o);
 
+	/**
+	 * @brief Insert a Batch of Objects into the Database
+	 * @param[in] Domain Objects
+	 * @throws dbapi_error on Database Error
+	 *
+	 * Executes the prepared INSERT statement for each object in a single
+	 * bind/step/reset loop and assigns the new identifiers.  The batch
+	 * events are raised once for the whole batch.
+	 */
+	void insertAll(const Batch & objects);
+
+	/**
+	 * @brief Load a Batch of Objects by Identifier
+	 * @param[in] Object Identifiers
+	 * @return Loaded Objects
+	 *
+	 * Loads the objects with "id in (...)" queries matching up to
+	 * max_fetch_batch identifiers each.  Objects already loaded in the
+	 * Session are returned from the identity map.  Identifiers which do not
+	 * exist are skipped.
+	 *
+	 * Cacheable mappers load the objects whose rows are in the Session's
+	 * Reference Cache without querying the database, and add the rows they
+	 * do query to the cache.
+	 */
+	virtual Batch loadByIds(const std::vector<int64_t> & ids) = 0;
+
+	//! @return If Per-Object Events are raised
+	bool perObjectEvents() const;
+
+	/**
+	 * @brief Return the Persistent Objects referenced by an Object
+	 * @param[in] Domain Object
+	 * @return List of Referenced Objects
+	 *
+	 * Returns the objects whose rows are referenced by foreign keys in the
+	 * object's row, e.g. the Dive Site of a Dive.  Unlike cascade_add(), this
+	 * does not load related collections, so it is safe to call on detached
+	 * objects.  Used by Session::bulk_import() to resolve shared references.
+	 */
+	virtual std::list<Persistent::Ptr> references(Persistent::Ptr o);
+
 	/**
 	 * @brief Remove an Object from the Database
 	 * @param[in] Domain Object
@@ -132,6 +239,35 @@ public:
 	 */
 	void remove(Persistent::Ptr o);
 
+	/**
+	 * @brief Remove a Batch of Objects from the Database
+	 * @param[in] Domain Objects
+	 * @throws dbapi_error on Database Error
+	 *
+	 * Removes the objects with bulk DELETE statements matching up to
+	 * max_delete_batch identifiers each.  Mappers which do not report a
+	 * table name fall back to removing one object at a time.
+	 */
+	void removeAll(const Batch & objects);
+
+	/**
+	 * @brief Set Per-Object Event Mode
+	 * @param[in] Raise Per-Object Events
+	 *
+	 * In per-object event mode the mapper raises the before_xxx and after_xxx
+	 * signals for every object, as well as the batch signals, for clients
+	 * which rely on the per-object events.  The mode is on by default; turn
+	 * it off to save the per-object signal calls once every subscriber has
+	 * moved to the batch signals.
+	 */
+	void setPerObjectEvents(bool value);
+
+	//! @return Mapped Table Name, or an empty string to disable Bulk DELETE
+	virtual std::string tableName() const;
+
+	//! @return Column List for SELECT Statements, or an empty string to disable loadByIds()
+	virtual std::string selectColumns() const;
+
 	/**
 	 * @brief Update an Object in the Database
 	 * @param[in] Domain Object
@@ -139,6 +275,71 @@ public:
 	 */
 	void update(Persistent::Ptr o);
 
+	/**
+	 * @brief Update a Batch of Objects in the Database
+	 * @param[in] Domain Objects
+	 * @throws dbapi_error on Database Error
+	 *
+	 * Executes the prepared UPDATE statement for each object in a single
+	 * bind/step/reset loop.  The batch events are raised once for the whole
+	 * batch.
+	 *
+	 * If the mapper describes its columns with updateColumns(), objects are
+	 * grouped by the set of columns whose attributes changed and each group
+	 * is updated with a cached statement which sets only those columns.
+	 */
+	void updateAll(const Batch & objects);
+
+protected:
+
+	/**
+	 * @brief Updatable Column Definition
+	 *
+	 * Describes one column of the full UPDATE statement by the attribute
+	 * which changes it and its SET clause fragment, which must use the same
+	 * parameter index as the full statement (e.g. "rating=?21").
+	 */
+	typedef struct
+	{
+		const char *	attribute;	///< Domain Model Attribute Name
+		const char *	assignment;	///< SET Clause Fragment
+
+	} column_def;
+
+	/**
+	 * @brief Reference Cache Fill
+	 *
+	 * Identifies the Reference Cache region which the rows of a query are
+	 * added to, and the generation of the region before the query was
+	 * executed (see ReferenceCache::put()).  The cache is empty if rows are
+	 * not cached.  Rows are only added if the query starts its own read
+	 * transaction; a connection which is already reading may still see rows
+	 * from before the last commit, whatever the generation says.
+	 */
+	struct cache_fill
+	{
+		ReferenceCache::Ptr			cache;		///< Reference Cache
+		ReferenceCache::Region		region;		///< Mapped Table Region
+		uint64_t					generation;	///< Region Generation
+		bool						store;		///< Add the Rows read to the Cache
+
+		cache_fill(): cache(), region(0), generation(0), store(false) { }
+	};
+
+	/**
+	 * @brief Fetch Plan
+	 *
+	 * Collects the post-load work of the objects loaded by a single query,
+	 * so that related data is loaded for all of them at once after the rows
+	 * have been read rather than with one query per row.
+	 */
+	struct fetch_plan
+	{
+		Batch						loaded;		///< Objects loaded by the Query
+		cache_fill					fill;		///< Reference Cache the Rows are added to
+
+	};
+
 protected:
 
 	//! Perform Operations after Deleting a Persistent
@@ -162,11 +363,89 @@ protected:
 	//! Perform Operations after Loading a Persistent
 	virtual void afterLoaded(Persistent::Ptr o);
 
+	/**
+	 * @brief Perform Operations after Loading a Batch of Persistents
+	 * @param[in] Domain Objects
+	 *
+	 * Called once all rows of a multi-row query have been read.  The
+	 * default implementation calls afterLoaded() for each object; mappers
+	 * should override it to load related data for the whole batch at once.
+	 */
+	virtual void afterLoadedAll(const Batch & objects);
+
 protected:
 
+	/**
+	 * @brief Append a Referenced Object to a List if it is in Memory
+	 * @param[in] List of Objects
+	 * @param[in] Referring Object
+	 * @param[in] Reference Attribute Name
+	 *
+	 * Used by cascade_add() and references(); a reference which has not been
+	 * loaded refers to a persisted object which cannot have changed.
+	 */
+	static void appendLoaded(std::list<Persistent::Ptr> & list, Persistent::Ptr o, const std::string & name);
+
 	//! Attach a newly-loaded Object to the Session
 	void attachToSession(Persistent::Ptr o);
 
+	/**
+	 * @brief Get the Reference Cache Fill for a Query
+	 * @return Reference Cache Fill, with an empty cache if Rows are not cached
+	 *
+	 * Must be called before the query is executed, so that rows which are
+	 * changed while it runs are not cached.  Other statements on the
+	 * connection should be reset first; see cache_fill.
+	 */
+	cache_fill cacheFill();
+
+	/**
+	 * @brief Check if Rows of this Mapper are Cached
+	 * @return True if the Session's Reference Cache holds this Mapper's Rows
+	 *
+	 * The default implementation returns false.  Mappers of reference data
+	 * which is shared by many objects and rarely changes, such as Mixes,
+	 * should override it to return true.
+	 */
+	virtual bool cacheable() const;
+
+	/**
+	 * @brief Abandon a Fetch Plan
+	 * @param[in] Fetch Plan
+	 *
+	 * Removes the objects of a plan which could not be completed from the
+	 * Session, so later queries load them again instead of returning them
+	 * half-built from the identity map.
+	 */
+	void abandonFetch(fetch_plan & plan);
+
+	/**
+	 * @brief Complete a Fetch Plan
+	 * @param[in] Fetch Plan
+	 *
+	 * Runs afterLoadedAll() and marks the loaded objects clean.  If that
+	 * fails the plan is abandoned before the exception is rethrown.
+	 */
+	void completeFetch(fetch_plan & plan);
+
+	/**
+	 * @brief Defer a Reference of a Loaded Object
+	 * @param[in] Referring Object
+	 * @param[in] Reference Attribute Name
+	 * @param[in] Referenced Object Identifier
+	 *
+	 * Stores the foreign identifier in the object's lazy reference (see
+	 * Persistent::reference()), so the referenced object is only loaded
+	 * when it is first accessed.
+	 */
+	void deferReference(Persistent::Ptr o, const std::string & name, int64_t id) const;
+
+	//! @return Object already loaded in the Session Identity Map, or an empty pointer
+	Persistent::Ptr findLoaded(uint32_t type_id, int64_t id) const;
+
+	//! @return Parameter List for an "id in (...)" Clause with n Parameters
+	static std::string placeholders(size_t n);
+
 	//! Bind an Object to the Insert Statement
 	virtual void bindInsert(statement::ptr s, Persistent::Ptr o) const = 0;
 
@@ -182,10 +461,40 @@ protected:
 	//! @return Update Prepared Statement
 	virtual statement::ptr updateStatement() const = 0;
 
+	/**
+	 * @brief Get the Updatable Columns
+	 * @return Column Definitions terminated by an entry with a NULL attribute,
+	 * or NULL to always update all columns
+	 *
+	 * Partial updates also require tableName().  At most 64 columns may be
+	 * described.
+	 */
+	virtual const column_def * updateColumns() const;
+
+private:
+
+	//! @return Set of Columns to Update for an Object (all bits set for a full update)
+	uint64_t changedColumns(Persistent::Ptr o);
+
+	//! @return UPDATE Statement for a Set of Columns
+	statement::ptr partialStatement(uint64_t columns);
+
+private:
+
+	// Parameter Generators for the Batch INSERT and UPDATE Statements
+	struct insert_binder;
+	struct update_binder;
+
 protected:
 	boost::weak_ptr<Session>				m_session;	///< Database Session
 	connection::ptr							m_conn;		///< Database Connection
-	std::map<int64_t, Persistent::WeakPtr>	m_loaded;	///< Identity Map of Loaded Objects
+	bool									m_perobj;	///< Raise Per-Object Events
+	fetch_plan *							m_fetch;	///< Fetch Plan of the Query being Loaded
+
+	ReferenceCache::WPtr					m_refcache;	///< Reference Cache of the last cacheFill()
+	ReferenceCache::Region					m_region;	///< Reference Cache Region of the Mapped Table
+
+	std::vector<uint64_t>					m_colmasks;	///< Attribute Mask for each Updatable Column
 
 	Events 									m_events;	///< Mapper Event Signals
 
@@ -229,6 +538,51 @@ public:
 		return AbstractMapper::insert(upcast(o));
 	}
 
+	/**
+	 * @brief Load a Batch of Objects by Identifier
+	 * @param[in] Object Identifiers
+	 * @return Loaded Objects
+	 */
+	virtual Batch loadByIds(const std::vector<int64_t> & ids)
+	{
+		std::string cols(selectColumns());
+		if (cols.empty() || tableName().empty())
+			throw std::runtime_error("Mapper does not support loading by identifier");
+
+		Batch result;
+		std::vector<int64_t> missing;
+		cache_fill fill(cacheFill());
+		if (fill.cache)
+		{
+			std::vector<typename D::Ptr> objs = loadCached(fill, ids, missing);
+			result.insert(result.end(), objs.begin(), objs.end());
+		}
+
+		const std::vector<int64_t> & query = fill.cache ? missing : ids;
+		std::vector<int64_t>::const_iterator it;
+		for (it = query.begin(); it != query.end(); )
+		{
+			size_t n = std::min((size_t)(query.end() - it), max_fetch_batch);
+
+			// Generated SQL is seldom repeated, so it is kept out of the statement cache
+			dbapi::statement::ptr s(m_conn->prepare("select " + cols + " from " +
+				tableName() + " where id in " + placeholders(n), false));
+			for (size_t i = 1; i <= n; i++, it++)
+				s->bind(i, * it);
+
+			if (fill.cache)
+			{
+				fill.generation = fill.cache->generation(fill.region);
+				fill.store = ! m_conn->is_busy();
+			}
+
+			std::vector<typename D::Ptr> objs = loadAll(s->exec(), fill);
+			result.insert(result.end(), objs.begin(), objs.end());
+		}
+
+		return result;
+	}
+
 	/**
 	 * @brief Remove an Object from the Database
 	 * @param[in] Domain Object
@@ -251,44 +605,195 @@ public:
 
 protected:
 
+	/**
+	 * @brief Find an Object by Identifier
+	 * @param[in] Object Identifier
+	 * @param[in] Find By Id Prepared Statement
+	 * @return Domain Object, or an empty pointer if it does not exist
+	 *
+	 * Returns the object from the identity map or, for cacheable mappers,
+	 * loads it from the Reference Cache before executing the statement,
+	 * which must take the identifier as its only parameter.
+	 */
+	typename D::Ptr findById(int64_t id, statement::ptr s)
+	{
+		s->reset();
+
+		cache_fill fill(cacheFill());
+		if (fill.cache)
+		{
+			std::vector<int64_t> missing;
+			std::vector<typename D::Ptr> objs = loadCached(fill, std::vector<int64_t>(1, id), missing);
+			if (! objs.empty())
+				return objs.front();
+		}
+
+		s->bind(1, id);
+
+		std::vector<typename D::Ptr> objs = loadAll(s->exec(), fill);
+		return objs.empty() ? typename D::Ptr() : objs.front();
+	}
+
 	/**
 	 * @brief Load a single Object from a Result Set
-	 * @param[in] Result Set
+	 * @param[in] Current Row of the Result Set
 	 * @return New Domain Object
 	 */
-	typename D::Ptr load(cursor::row_t r)
+	typename D::Ptr load(const cursor::row_view & r)
 	{
-		int64_t id = r[0].as<int64_t>();
-		if ((m_loaded.find(id) != m_loaded.end()) && ! m_loaded[id].expired())
-			return downcast(m_loaded[id].lock());
+		int64_t id = r.as<int64_t>(0);
+		if (m_fetch && m_fetch->fill.cache && m_fetch->fill.store)
+			m_fetch->fill.cache->put(m_fetch->fill.region, id, r, m_fetch->fill.generation);
+
+		Persistent::Ptr loaded = findLoaded(D::TypeId(), id);
+		if (loaded)
+			return downcast(loaded);
 
 		typename D::Ptr result = doLoad(id, r);
-		m_loaded[id] = Persistent::WeakPtr(upcast(result));
 		attachToSession(result);
+
+		// Completed by completeFetch() once all rows have been read
+		if (m_fetch)
+		{
+			m_fetch->loaded.push_back(result);
+			return result;
+		}
+
 		afterLoaded(result);
 		mark_persistent_clean(result);
 		return result;
 	}
 
+	/**
+	 * @brief Load Objects from the Reference Cache
+	 * @param[in] Reference Cache Fill
+	 * @param[in] Object Identifiers
+	 * @param[out] Identifiers of the Objects which are not cached
+	 * @return Loaded Objects
+	 *
+	 * Objects already loaded in the Session are returned from the identity
+	 * map; the others are loaded from their cached rows.
+	 */
+	std::vector<typename D::Ptr> loadCached(const cache_fill & fill, const std::vector<int64_t> & ids,
+		std::vector<int64_t> & missing)
+	{
+		std::vector<typename D::Ptr> result;
+		std::vector<ReferenceCache::RowPtr> rows;
+
+		std::vector<int64_t>::const_iterator it;
+		for (it = ids.begin(); it != ids.end(); it++)
+		{
+			Persistent::Ptr loaded = findLoaded(D::TypeId(), * it);
+			if (loaded)
+			{
+				result.push_back(downcast(loaded));
+				continue;
+			}
+
+			ReferenceCache::RowPtr row = fill.cache->get(fill.region, * it);
+			if (row)
+				rows.push_back(row);
+			else
+				missing.push_back(* it);
+		}
+
+		if (rows.empty())
+			return result;
+
+		fetch_plan * outer = m_fetch;
+		fetch_plan plan;
+
+		m_fetch = & plan;
+		try
+		{
+			std::vector<ReferenceCache::RowPtr>::const_iterator rit;
+			for (rit = rows.begin(); rit != rows.end(); rit++)
+				result.push_back(load(cursor::row_view(** rit)));
+		}
+		catch (...)
+		{
+			m_fetch = outer;
+			abandonFetch(plan);
+			throw;
+		}
+		m_fetch = outer;
+
+		completeFetch(plan);
+		return result;
+	}
+
+	/**
+	 * @brief Load a single Object from a Cursor
+	 * @param[in] Cursor Pointer
+	 * @return New Domain Object or an empty pointer if the Cursor is empty
+	 */
+	typename D::Ptr loadOne(cursor::ptr c)
+	{
+		if (c->at_end())
+			return typename D::Ptr();
+		return load(c->current());
+	}
+
 	/**
 	 * @brief Load multiple Objects from a Result Set
 	 * @param[in] Cursor Pointer
+	 * @param[in] Reference Cache the Rows are added to (see cacheFill())
 	 * @return New Domain Object
 	 */
-	std::vector<typename D::Ptr> loadAll(cursor::ptr c)
+	std::vector<typename D::Ptr> loadAll(cursor::ptr c, const cache_fill & fill = cache_fill())
 	{
 		std::vector<typename D::Ptr> result;
-
-		std::vector<cursor::row_t> rs = c->fetchall();
-		std::vector<cursor::row_t>::const_iterator it;
-		for (it = rs.begin(); it != rs.end(); it++)
-			result.push_back(load(* it));
-
+		fetch_plan * outer = m_fetch;
+		fetch_plan plan;
+		plan.fill = fill;
+
+		/*
+		 * The loaded objects are collected in a fetch plan while the rows are
+		 * read, and their related data is loaded in batches afterwards.
+		 */
+		m_fetch = & plan;
+		try
+		{
+			for ( ; ! c->at_end(); c->next())
+				result.push_back(load(c->current()));
+		}
+		catch (...)
+		{
+			m_fetch = outer;
+			abandonFetch(plan);
+			throw;
+		}
+		m_fetch = outer;
+
+		completeFetch(plan);
 		return result;
 	}
 
-	//! Load an Object from a Result Set
-	virtual typename D::Ptr doLoad(int64_t id, cursor::row_t r) const = 0;
+	/**
+	 * @brief Load Objects from a Result Set one at a time
+	 * @param[in] Cursor Pointer
+	 * @param[in] Visitor Function
+	 *
+	 * Steps through the cursor and passes each loaded object to the visitor
+	 * before the next row is fetched, so only a single row is held at once.
+	 */
+	void loadEach(cursor::ptr c, typename IFinder<D>::Visitor v)
+	{
+		for ( ; ! c->at_end(); c->next())
+			v(load(c->current()));
+	}
+
+	/**
+	 * @brief Load an Object from a Result Set
+	 * @param[in] Object Identifier
+	 * @param[in] Current Row of the Result Set
+	 * @return New Domain Object
+	 *
+	 * The row view is only valid for the duration of the call and refers to
+	 * the statement being iterated; implementations should read the columns
+	 * they need directly from the view.
+	 */
+	virtual typename D::Ptr doLoad(int64_t id, const cursor::row_view & r) const = 0;
 
 protected:
 
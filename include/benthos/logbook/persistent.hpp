@@ -38,9 +38,13 @@
  */
 
 #include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
 
 #include <boost/any.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/signals2.hpp>
 #include <boost/utility.hpp>
@@ -54,6 +58,9 @@ class Session;
 // Forward Definition of Proxy Object class
 class ProxyObject;
 
+// Forward Definition of Lazy Reference class
+class LazyReference;
+
 typedef boost::shared_ptr<Session>	SessionPtr;
 typedef boost::weak_ptr<Session>	SessionWPtr;
 
@@ -70,6 +77,11 @@ typedef boost::weak_ptr<Session>	SessionWPtr;
  * Session which can be used to access templated finders and other mapper
  * functionality from within the Persistent.
  *
+ * Each Persistent records which of its attributes have been set since it was
+ * last clean, as a bitmask updated from the attr_set event.  Bits are
+ * assigned per domain model class by attribute name (see attribute_mask()),
+ * so mappers can update only the columns which actually changed.
+ *
  * Note that Persistent objects should never be instantiated as concrete
  * objects.  Rather they should always be accessed through shared pointers.
  * To enforce this paradigm, Persistent objects and their descendents should
@@ -97,6 +109,9 @@ public:
 
 	} Events;
 
+	//! Attribute Registry Type (maps Attribute Names to Change Mask Bits)
+	typedef std::map<std::string, uint64_t>	AttributeRegistry;
+
 public:
 
 	//! Class Constructor
@@ -107,9 +122,38 @@ public:
 
 public:
 
+	/**
+	 * @brief Get the Change Mask Bit for an Attribute
+	 * @param[in] Attribute Name
+	 * @return Change Mask Bit
+	 *
+	 * Returns the bit which represents the named attribute in the changed
+	 * attributes mask for the domain model class.  A class with more than 63
+	 * attributes shares the highest bit between the remaining attributes.
+	 */
+	virtual uint64_t attribute_mask(const std::string & name) const = 0;
+
+	/**
+	 * @brief Get the Attributes changed since the Persistent was last Clean
+	 * @return Changed Attributes Mask
+	 *
+	 * Returns a mask of the attribute bits set by the attr_set event since the
+	 * Persistent was last marked clean.  A dirty Persistent with an empty mask
+	 * was modified without naming the attribute, so any of its attributes
+	 * must be considered changed.
+	 */
+	inline uint64_t changed_attributes() const { return m_changed; }
+
 	//! @return Events
 	Events & events();
 
+	/**
+	 * @brief Check if an Attribute was changed
+	 * @param[in] Attribute Name
+	 * @return If the Attribute may have changed since the Persistent was last Clean
+	 */
+	bool is_changed(const std::string & name) const;
+
 	//! @return Identifier
 	int64_t id() const;
 
@@ -122,9 +166,25 @@ public:
 	//! @return If the Persistent is currently Loading
 	inline bool is_loading() const { return m_loading; }
 
+	/**
+	 * @brief Get a Lazy Reference by Attribute Name
+	 * @param[in] Attribute Name, e.g. "site"
+	 * @return Lazy Reference, or NULL if the class has no such reference
+	 *
+	 * Gives mappers and Session::prefetch() access to the foreign identifier
+	 * of a reference without loading the referenced object.
+	 */
+	virtual LazyReference * reference(const std::string & name);
+
+	//! @return Names of the Lazy References of the Class, e.g. "site"
+	virtual std::vector<std::string> reference_names() const;
+
 	//! @return Owning Session
 	SessionPtr session() const;
 
+	//! @return Compact Type Identifier for the Domain Model
+	virtual uint32_t type_id() const = 0;
+
 	//! @return Type Information for the Domain Model
 	virtual const std::type_info * type_info() const = 0;
 
@@ -154,6 +214,34 @@ protected:
 	//! Mark the Persistent as Loading
 	virtual void mark_loading();
 
+	/**
+	 * @brief Allocate a Compact Type Identifier
+	 * @return New Type Identifier
+	 *
+	 * Each domain model class is assigned a small integer identifier on first
+	 * use, which keys it in the Session identity map.  Identifiers are only
+	 * stable within a single process.
+	 */
+	static uint32_t next_type_id();
+
+	/**
+	 * @brief Register an Attribute Name with a Class Registry
+	 * @param[in] Attribute Registry for the Domain Model Class
+	 * @param[in] Attribute Name
+	 * @return Change Mask Bit
+	 */
+	static uint64_t register_attribute(AttributeRegistry & registry, const std::string & name);
+
+	/**
+	 * @brief Track Attribute Changes for a Domain Model Class
+	 * @param[in] Class Events
+	 * @return Always true
+	 *
+	 * Connects the handler which records changed attributes to the class
+	 * attr_set event.  Called once per class by TypedPersistent.
+	 */
+	static bool track_changes(Events & events);
+
 	//! @return Instance shared pointer
 	Ptr ptr();
 
@@ -223,8 +311,14 @@ private:
 	bool				m_loading;
 
 	int64_t				m_id;
+	uint64_t			m_changed;
 	SessionWPtr			m_session;
 
+private:
+
+	//! Record a changed Attribute (attr_set event handler)
+	static void on_attr_set(Ptr o, const std::string & name, const boost::any &);
+
 private:
 	friend class ProxyObject;
 
@@ -239,13 +333,42 @@ class TypedPersistent: public Persistent
 public:
 
 	//! Class Constructor
-	TypedPersistent(): Persistent() { }
+	TypedPersistent(): Persistent()
+	{
+		static const bool tracked = track_changes(s_events);
+		(void)tracked;
+	}
 
 	//! Class Destructor
 	virtual ~TypedPersistent() { }
 
 public:
 
+	//! @return Change Mask Bit for an Attribute of the Mapped Class
+	static uint64_t AttributeMask(const std::string & name)
+	{
+		return register_attribute(s_attributes, name);
+	}
+
+	//! @return Change Mask Bit for an Attribute of the Mapped Class
+	virtual uint64_t attribute_mask(const std::string & name) const
+	{
+		return AttributeMask(name);
+	}
+
+	//! @return Compact Type Identifier for the Mapped Class
+	static uint32_t TypeId()
+	{
+		static const uint32_t id = next_type_id();
+		return id;
+	}
+
+	//! @return Compact Type Identifier for the Mapped Class
+	virtual uint32_t type_id() const
+	{
+		return TypeId();
+	}
+
 	//! @return Type Info for the Mapped Class
 	virtual const std::type_info * type_info() const
 	{
@@ -268,7 +391,8 @@ protected:
 	}
 
 protected:
-	static Persistent::Events		s_events;
+	static Persistent::Events				s_events;
+	static Persistent::AttributeRegistry	s_attributes;
 
 };
 
@@ -276,11 +400,15 @@ protected:
 template <class D>
 Persistent::Events TypedPersistent<D>::s_events;
 
+// Persistent Class Attribute Registry
+template <class D>
+Persistent::AttributeRegistry TypedPersistent<D>::s_attributes;
+
 /**
  * @brief Templated Finder Interface Supertype
  *
  * Provides a templated base type for finders.  This class introduces the find()
- * and findAll() methods which find a single and all objects.
+ * methods which find a single object, all objects, or visit all objects.
  */
 template <class D>
 struct IFinder
@@ -288,12 +416,30 @@ struct IFinder
 	typedef boost::shared_ptr<IFinder<D> >	Ptr;
 	virtual ~IFinder() { }
 
+	/**
+	 * @brief Mapped Object Visitor Function
+	 *
+	 * Called once for each object found by a visitor-style finder.  The
+	 * visitor must not call the same finder method recursively, since the
+	 * underlying statement is still being stepped.
+	 */
+	typedef boost::function<void (typename D::Ptr)>	Visitor;
+
 	/**
 	 * @brief Find all Mapped Objects of this Class
 	 * @return List of Mapped Objects
 	 */
 	virtual std::vector<typename D::Ptr> find() = 0;
 
+	/**
+	 * @brief Visit all Mapped Objects of this Class
+	 * @param[in] Visitor Function
+	 *
+	 * Loads the objects one row at a time and passes each to the visitor as
+	 * it is loaded, rather than building the complete list in memory.
+	 */
+	virtual void find(Visitor v) = 0;
+
 	/**
 	 * @brief Find a single Mapped Object by Id
 	 * @param[in] Object Id
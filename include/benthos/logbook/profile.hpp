@@ -46,9 +46,12 @@
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <benthos/logbook/dbapi/blob.hpp>
+
 #include <benthos/logbook/collection.hpp>
 #include <benthos/logbook/dive_computer.hpp>
 #include <benthos/logbook/dive.hpp>
+#include <benthos/logbook/lazy_reference.hpp>
 #include <benthos/logbook/mix.hpp>
 #include <benthos/logbook/persistent.hpp>
 #include <benthos/logbook/util.hpp>
@@ -111,9 +114,43 @@ public:
 	//! @return Profile Waypoints
 	const std::list<waypoint> & profile() const;
 
-	//! @return Raw Profile Data
+	/**
+	 * @brief Return the Raw Profile Data
+	 * @return Raw Profile Data
+	 *
+	 * Profiles loaded from the database do not read the raw profile data
+	 * (which can be several megabytes for some dive computers) until it is
+	 * first requested.  The first call to this method reads the entire blob
+	 * from the database and keeps it in memory; use readRawProfile() and
+	 * rawProfileSize() to stream the data without holding a copy.
+	 *
+	 * Throws std::runtime_error if the data has not been loaded and the
+	 * Profile's Session has expired, rather than returning empty data which
+	 * would overwrite the stored blob when the Profile is next saved.
+	 */
 	const std::vector<unsigned char> & raw_profile() const;
 
+	//! @return Raw Profile Data Size in Bytes
+	size_t rawProfileSize() const;
+
+	//! @return True if the Raw Profile Data is held in memory
+	bool rawProfileLoaded() const;
+
+	/**
+	 * @brief Read part of the Raw Profile Data
+	 * @param[out] Destination Buffer
+	 * @param[in] Number of Bytes to Read
+	 * @param[in] Offset from the Start of the Raw Profile
+	 * @return Number of Bytes Read
+	 *
+	 * Reads directly from the database using incremental blob I/O if the raw
+	 * profile has not been loaded into memory, so that the raw data can be
+	 * processed in pieces.  A short count indicates the end of the data.
+	 * Throws std::runtime_error if the raw profile must be read from the
+	 * database and the Profile's Session has expired.
+	 */
+	size_t readRawProfile(void * buf, size_t n, size_t offset) const;
+
 	//! @return Vendor-Specified Data
 	const boost::optional<std::string> & vendor() const;
 
@@ -161,6 +198,16 @@ public:
 
 public:
 
+	/**
+	 * @internal
+	 * @brief Defer Loading the Raw Profile Data
+	 * @param[in] Stored Raw Profile Size
+	 *
+	 * Called by the Profile mapper when loading a Profile so that the raw
+	 * profile blob is read from the database only when it is requested.
+	 */
+	void deferRawProfile(size_t size);
+
 	//! @internal Called when a Dive is deleted
 	void evtDiveDeleted(AbstractMapper::Ptr, Persistent::Ptr);
 
@@ -170,6 +217,12 @@ public:
 	//! @internal Called when a Mix is deleted
 	void evtMixDeleted(AbstractMapper::Ptr, Persistent::Ptr);
 
+	//! @return Lazy Reference for the "computer" or "dive" Attribute
+	virtual LazyReference * reference(const std::string & name);
+
+	//! @return "computer" and "dive"
+	virtual std::vector<std::string> reference_names() const;
+
 protected:
 
 	//! Called when the Persistent is attached to a Session
@@ -178,9 +231,17 @@ protected:
 	//! Called when the Persistent is detached from a Session
 	virtual void detached(SessionPtr);
 
+	/**
+	 * @brief Open the stored Raw Profile
+	 * @return Incremental Blob Handle, or NULL if the Raw Profile is held
+	 *   in memory or nothing is stored
+	 * @throws std::runtime_error if the Session has expired
+	 */
+	dbapi::blob::ptr openRawProfile() const;
+
 private:
-	Dive::Ptr						m_dive;		///< Dive
-	DiveComputer::Ptr				m_computer;	///< Dive Computer
+	TypedLazyReference<Dive>			m_dive;		///< Dive
+	TypedLazyReference<DiveComputer>	m_computer;	///< Dive Computer
 
 	boost::optional<std::string>	m_name;		///< Profile Name
 	std::set<std::string>			m_keys;		///< Profile Data Keys
@@ -188,7 +249,9 @@ private:
 	boost::optional<std::string>	m_vendor;	///< Vendor-Specified Data
 	boost::optional<time_t>			m_imported;	///< Import Date/Time
 
-	std::vector<unsigned char>		m_raw;		///< Raw Profile Data Blob
+	mutable std::vector<unsigned char>	m_raw;			///< Raw Profile Data Blob
+	mutable bool					m_raw_loaded;	///< Raw Profile Data is in m_raw
+	size_t							m_raw_size;		///< Stored Raw Profile Size
 
 	boost::signals2::connection		m_evtDiveDel;		///< Event Connection for Dive Deletion
 	boost::signals2::connection		m_evtComputerDel;	///< Event Connection for Dive Computer Deletion
@@ -200,6 +263,18 @@ private:
  * @brief Dive Profile Finder Interface
  *
  * Extends IFinder<Profile> to add find-by-dive and find-by-computer methods.
+ *
+ * Profile statistics can also be computed inside SQL queries without loading
+ * Profile objects.  The following functions take the profiles.profile column
+ * and are registered on every connection a Session is created for:
+ *
+ * - profile_max_depth(profile): maximum depth
+ * - profile_avg_depth(profile): time-weighted average depth
+ * - profile_bottom_time(profile [, depth]): seconds between the first and
+ *   last waypoints deeper than depth (default 0)
+ * - profile_time_above(profile, depth): seconds spent shallower than depth
+ *
+ * Each returns NULL for a profile without depth samples.
  */
 struct IProfileFinder: public IFinder<Profile>
 {
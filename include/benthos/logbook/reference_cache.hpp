@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef LOGBOOK_REFERENCE_CACHE_HPP_
+#define LOGBOOK_REFERENCE_CACHE_HPP_
+
+/**
+ * @file include/benthos/logbook/reference_cache.hpp
+ * @brief Reference Data Cache Class
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <benthos/logbook/dbapi.hpp>
+
+namespace benthos { namespace logbook {
+
+/**
+ * @brief Reference Data Cache Class
+ *
+ * Process-wide second-level cache of the rows of reference data such as
+ * Mixes, Tanks, Dive Sites and Dive Computers, which are read by many
+ * Sessions but rarely change.  Each entry is an immutable copy of one row,
+ * keyed by its region (the database file and table) and row identifier.
+ * Sessions share the rows, but each Session still loads its own objects
+ * from them, so objects are never shared between Sessions.
+ *
+ * Entries are evicted in least-recently-used order once the estimated size
+ * of the cached rows exceeds the capacity.  The cache is kept current with
+ * the update, committed and rollback handlers of each connection passed to
+ * attach(); changes made by other processes, or through connections which
+ * are not attached, are not seen.  Rows read while an attached connection
+ * has uncommitted changes to the same table are not cached, and a row read
+ * before a change to its table is committed is discarded by put().  That
+ * only holds if the row was read by a read transaction which started after
+ * the generation passed to put() was sampled, so callers must not add rows
+ * read while their connection is already in a transaction or stepping
+ * another statement (see dbapi::connection::is_busy()).
+ *
+ * The cache is opt-in; see Logbook::setReferenceCache().  All methods may
+ * be called from any thread.
+ */
+class ReferenceCache: public boost::noncopyable,
+	public boost::enable_shared_from_this<ReferenceCache>
+{
+public:
+	typedef boost::shared_ptr<ReferenceCache>	Ptr;
+	typedef boost::weak_ptr<ReferenceCache>		WPtr;
+
+	//! Copied Row
+	typedef std::vector<dbapi::variant>			Row;
+
+	//! Shared Immutable Copy of a Row
+	typedef boost::shared_ptr<const Row>		RowPtr;
+
+	//! Region (Database File and Table) Identifier
+	typedef uint32_t							Region;
+
+	//! Default Capacity in Bytes
+	static const size_t default_capacity = 4 * 1024 * 1024;
+
+	//! Cache Statistics
+	typedef struct
+	{
+		uint64_t		n_hits;				///< Lookups which found a Row
+		uint64_t		n_misses;			///< Lookups which did not find a Row
+		uint64_t		n_evictions;		///< Rows evicted to stay within the Capacity
+		uint64_t		n_invalidations;	///< Rows removed because they changed
+		uint64_t		n_rejected;			///< Rows not cached because their Table changed
+		size_t			n_entries;			///< Number of cached Rows
+		size_t			n_bytes;			///< Estimated Size of the cached Rows
+
+	} Stats;
+
+public:
+
+	/**
+	 * @brief Class Constructor
+	 * @param[in] Capacity in Bytes
+	 */
+	ReferenceCache(size_t capacity = default_capacity);
+
+	//! Class Destructor
+	~ReferenceCache();
+
+	/**
+	 * @brief Return the Process-Wide Cache
+	 * @return Reference Cache
+	 *
+	 * The instance is created on first use and shared by every Logbook which
+	 * enables it with Logbook::setReferenceCache().
+	 */
+	static Ptr instance();
+
+public:
+
+	/**
+	 * @brief Follow the Changes made through a Connection
+	 * @param[in] Database Connection
+	 *
+	 * Installs update, committed and rollback handlers on the connection
+	 * which remove changed rows from the cache, replacing any handlers which
+	 * were set before.  Connections to in-memory databases are ignored.
+	 */
+	void attach(dbapi::connection::ptr conn);
+
+	//! @return Capacity in Bytes
+	size_t capacity() const;
+
+	//! @brief Remove all Entries
+	void clear();
+
+	/**
+	 * @brief Return the Database File Name of a Connection
+	 * @param[in] Database Connection
+	 * @return Absolute File Name, or an empty string for in-memory Databases
+	 *
+	 * Connections to the same database file return the same name, so it is
+	 * used to share regions between the writer and reader connections of a
+	 * Logbook.
+	 */
+	static std::string database(dbapi::connection::ptr conn);
+
+	/**
+	 * @brief Stop Following the Changes made through a Connection
+	 * @param[in] Database Connection
+	 *
+	 * Removes the handlers installed by attach().
+	 */
+	void detach(dbapi::connection::ptr conn);
+
+	/**
+	 * @brief Look up a Row
+	 * @param[in] Region Identifier
+	 * @param[in] Row Identifier
+	 * @return Cached Row or an empty pointer
+	 */
+	RowPtr get(Region region, int64_t id);
+
+	/**
+	 * @brief Return the Generation of a Region
+	 * @param[in] Region Identifier
+	 * @return Generation Counter
+	 *
+	 * The generation changes each time a row of the region is changed or a
+	 * transaction which changed it ends.  Read it before querying rows which
+	 * are passed to put().
+	 */
+	uint64_t generation(Region region) const;
+
+	/**
+	 * @brief Remove a changed Row
+	 * @param[in] Database File Name
+	 * @param[in] Table Name
+	 * @param[in] Row Identifier
+	 */
+	void invalidate(const std::string & database, const std::string & table, int64_t id);
+
+	/**
+	 * @brief Add a Row
+	 * @param[in] Region Identifier
+	 * @param[in] Row Identifier
+	 * @param[in] Current Row of a Result Set
+	 * @param[in] Generation of the Region before the Query was executed
+	 * @return True if the Row was cached
+	 *
+	 * Copies the row into the cache unless the region has changed since the
+	 * given generation or has uncommitted changes, in which case the row may
+	 * already be out of date.  The query must have started a new read
+	 * transaction after the generation was read.
+	 */
+	bool put(Region region, int64_t id, const dbapi::row_view & row, uint64_t generation);
+
+	/**
+	 * @brief Return the Region Identifier of a Table
+	 * @param[in] Database File Name
+	 * @param[in] Table Name
+	 * @return Region Identifier
+	 */
+	Region region(const std::string & database, const std::string & table);
+
+	/**
+	 * @brief Set the Capacity
+	 * @param[in] Capacity in Bytes
+	 *
+	 * Evicts the least recently used rows until the cache fits the new
+	 * capacity.
+	 */
+	void set_capacity(size_t capacity);
+
+	//! @return Cache Statistics
+	Stats stats() const;
+
+protected:
+
+	//! Mark the Regions of a Database as Committed or Rolled Back
+	void end_transaction(const std::string & database);
+
+	//! Evict Entries until the Cache fits its Capacity (Lock must be held)
+	void evict();
+
+	//! Return or create the Region of a Table (Lock must be held)
+	Region find_region(const std::string & database, const std::string & table);
+
+private:
+
+	//! Cache Entry
+	struct entry
+	{
+		Region		region;			///< Region Identifier
+		int64_t		id;				///< Row Identifier
+		RowPtr		row;			///< Cached Row
+		size_t		size;			///< Estimated Size in Bytes
+
+	};
+
+	//! Region State
+	struct region_state
+	{
+		std::string		database;	///< Database File Name
+		std::string		table;		///< Table Name
+		uint64_t		generation;	///< Generation Counter
+		bool			pending;	///< Region has uncommitted Changes
+
+	};
+
+	//! Entry Key
+	typedef std::pair<Region, int64_t>						key_type;
+
+	//! Entry Key Hash
+	struct key_hash
+	{
+		size_t operator() (const key_type & k) const
+		{
+			uint64_t h = ((uint64_t)k.second * 0x9E3779B97F4A7C15ULL) ^ k.first;
+			return (size_t)(h ^ (h >> 32));
+		}
+	};
+
+	typedef std::list<entry>												lru_list;
+	typedef std::unordered_map<key_type, lru_list::iterator, key_hash>	map_type;
+	typedef std::map<std::pair<std::string, std::string>, Region>		region_map;
+
+	// Connection Handlers
+	struct committed_handler;
+	struct rollback_handler;
+	struct update_handler;
+
+private:
+	mutable std::mutex			m_mutex;		///< Cache Mutex
+	size_t						m_capacity;		///< Capacity in Bytes
+	size_t						m_size;			///< Estimated Size of the Entries
+
+	lru_list					m_lru;			///< Entries, most recently used first
+	map_type					m_map;			///< Entry Lookup Table
+
+	std::vector<region_state>	m_regions;		///< Region States by Identifier
+	region_map					m_region_ids;	///< Region Identifiers by Database and Table
+
+	Stats						m_stats;		///< Cache Statistics
+
+};
+
+} } /* benthos::logbook */
+
+#endif /* LOGBOOK_REFERENCE_CACHE_HPP_ */
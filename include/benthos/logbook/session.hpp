@@ -41,6 +41,7 @@
 #include <map>
 #include <set>
 #include <typeinfo>
+#include <vector>
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/shared_ptr.hpp>
@@ -48,9 +49,12 @@
 #include <boost/utility.hpp>
 
 #include <benthos/logbook/dbapi.hpp>
+#include <benthos/logbook/identity_map.hpp>
+#include <benthos/logbook/lazy_reference.hpp>
 #include <benthos/logbook/logging.hpp>
 #include <benthos/logbook/mapper.hpp>
 #include <benthos/logbook/persistent.hpp>
+#include <benthos/logbook/reference_cache.hpp>
 
 using namespace benthos::logbook::dbapi;
 
@@ -74,20 +78,25 @@ typedef std::map<const_typeinfo_ptr, AbstractMapper::Ptr, typecmp> mapper_regist
 //! @brief Unit of Work Entry List
 typedef std::set<Persistent::Ptr> uow_registry;
 
-//! @brief Identity Map Key Type
-typedef std::pair<const_typeinfo_ptr, int64_t>	id_key_type;
+//! @brief Flush Order Type (Dependency Rank of each Mapped Class)
+typedef std::map<const_typeinfo_ptr, size_t, typecmp> flush_order_map;
 
-//! @brief Type Comparator for the Identity Map Key
-struct id_key_cmp
+/**
+ * @brief Flush Plan Group
+ *
+ * Holds the pending changes to objects of a single domain model class, which
+ * are flushed together through that class's mapper.
+ */
+struct flush_group
 {
-	bool operator()(const id_key_type & lhs, const id_key_type & rhs) const
-	{
-		return (lhs.first->before(* rhs.first) || (lhs.second < rhs.second));
-	}
+	AbstractMapper::Ptr			mapper;		///< Data Mapper
+	AbstractMapper::Batch		deleted;	///< Objects to Delete
+	AbstractMapper::Batch		inserted;	///< Objects to Insert
+	AbstractMapper::Batch		updated;	///< Objects to Update
 };
 
-//! @brief Identity Map Type
-typedef std::map<id_key_type, Persistent::WeakPtr, id_key_cmp> identity_map;
+//! @brief Flush Plan Type (Groups in Dependency Order)
+typedef std::vector<flush_group> flush_plan;
 
 /**
  * @brief Database Session Class
@@ -113,6 +122,18 @@ public:
 
 	} Events;
 
+	//! Unit of Work Statistics Structure
+	typedef struct
+	{
+		size_t		n_dirty;		///< Number of Modified Objects pending Update
+		size_t		n_new;			///< Number of New Objects pending Insert
+		size_t		n_deleted;		///< Number of Objects pending Delete
+		size_t		n_identity;		///< Number of Identity Map Entries
+		uint64_t	total_marked;	///< Total Objects registered as Modified
+		uint64_t	total_updated;	///< Total Objects updated by flush()
+
+	} Stats;
+
 protected:
 
 	//! Class Constructor
@@ -120,7 +141,16 @@ protected:
 
 public:
 
-	//! Class Factory Method
+	/**
+	 * @brief Class Factory Method
+	 * @param[in] Database Connection
+	 * @return New Session
+	 *
+	 * Creates a new Session bound to the given connection.  If the connection
+	 * was opened read-only (e.g. a reader leased from a connection_pool), the
+	 * Session is read-only: objects may be loaded through its finders, but
+	 * add(), delete_() and flushing changes will throw an exception.
+	 */
 	static Session::Ptr Create(connection::ptr conn);
 
 	//! Class Destructor
@@ -146,6 +176,51 @@ public:
 	 */
 	void begin();
 
+	/**
+	 * @brief Insert a Batch of New Objects in Bulk
+	 * @param[in] Domain Objects
+	 * @param[in] Keep the Objects attached to the Session after Import
+	 * @param[in] Defer Foreign Key Checks to a Validation Pass
+	 * @return Number of Objects Inserted
+	 * @throws std::runtime_error if the Import fails; nothing is inserted
+	 *
+	 * High-throughput alternative to add() followed by flush() for loading
+	 * large numbers of new objects, such as Dives, Profiles, Dive Tanks and
+	 * Dive Sites.  The objects should be detached.  New objects which they
+	 * reference (see AbstractMapper::references()) are imported with them,
+	 * each shared reference only once per batch, while references to
+	 * persisted objects are bound by identifier.  Related collections are
+	 * not walked, so e.g. the Profiles of a new Dive must be passed in the
+	 * batch as well.  Persisted objects in the batch are ignored.
+	 *
+	 * All objects are inserted with the mappers' batch statements within a
+	 * single transaction, which is committed unless a transaction was already
+	 * active.  If defer_fk is set and no transaction was active, foreign key
+	 * enforcement is switched off during the inserts and the imported tables
+	 * are validated with "pragma foreign_key_check" before committing;
+	 * within an active transaction the checks are deferred instead.
+	 *
+	 * The imported objects are assigned their identifiers and marked clean.
+	 * Unless keep is set they are not attached to the Session, so they carry
+	 * no event subscriptions and may simply be released by the caller.
+	 * Objects which were already pending insert in this Session remain
+	 * attached.
+	 */
+	size_t bulk_import(const AbstractMapper::Batch & objects, bool keep = false, bool defer_fk = false);
+
+	/**
+	 * @brief Insert a Batch of New Objects in Bulk
+	 * @param[in] Domain Objects
+	 * @param[in] Keep the Objects attached to the Session after Import
+	 * @param[in] Defer Foreign Key Checks to a Validation Pass
+	 * @return Number of Objects Inserted
+	 */
+	template <typename D>
+	size_t bulk_import(const std::vector<boost::shared_ptr<D> > & objects, bool keep = false, bool defer_fk = false)
+	{
+		return bulk_import(AbstractMapper::Batch(objects.begin(), objects.end()), keep, defer_fk);
+	}
+
 	/**
 	 * @brief Commit the current Transaction
 	 *
@@ -157,6 +232,9 @@ public:
 	//! @return Database Connection Pointer
 	inline connection::ptr conn() const { return m_conn; }
 
+	//! @return True if the Session is Read-Only
+	inline bool readonly() const { return m_readonly; }
+
 	/**
 	 * @brief Mark and Instance as Deleted
 	 * @param[in] Domain Object Pointer
@@ -180,6 +258,16 @@ public:
 	 */
 	void expunge(Persistent::Ptr p);
 
+	/**
+	 * @brief Find an Object in the Identity Map
+	 * @param[in] Domain Model Type Id
+	 * @param[in] Object Identifier
+	 * @return Domain Object, or an empty pointer if it is not loaded
+	 *
+	 * Never queries the database.
+	 */
+	Persistent::Ptr find_loaded(uint32_t type_id, int64_t id);
+
 	/**
 	 * @brief Flush Changes to the Database
 	 *
@@ -189,6 +277,73 @@ public:
 	 */
 	void flush();
 
+	/**
+	 * @brief Get an Object by Identifier
+	 * @param[in] Domain Model Class
+	 * @param[in] Domain Model Type Id
+	 * @param[in] Object Identifier
+	 * @return Domain Object, or an empty pointer if it does not exist
+	 *
+	 * Returns the object from the identity map if it is loaded, and loads it
+	 * from the database otherwise.  Throws a dbapi_error if the Session's
+	 * connection is owned by another thread (see AsyncSession).
+	 */
+	Persistent::Ptr get(const std::type_info & type, uint32_t type_id, int64_t id);
+
+	/**
+	 * @brief Get an Object by Identifier
+	 * @param[in] Object Identifier
+	 * @return Domain Object, or an empty pointer if it does not exist
+	 */
+	template <typename D>
+	typename D::Ptr get(int64_t id)
+	{
+		return boost::dynamic_pointer_cast<D>(get(typeid(D), D::TypeId(), id));
+	}
+
+	/**
+	 * @brief Load every Lazy Reference for a Batch of Objects
+	 * @param[in] Domain Objects
+	 * @return Number of Objects Loaded from the Database
+	 *
+	 * Prefetches each reference listed by Persistent::reference_names() for
+	 * the objects which have it.  Used by AsyncSession to hand out objects
+	 * whose references can be read without going back to the Session.
+	 */
+	size_t prefetch(const AbstractMapper::Batch & objects);
+
+	/**
+	 * @brief Load a Lazy Reference for a Batch of Objects
+	 * @param[in] Domain Objects
+	 * @param[in] Reference Attribute Name, e.g. "site"
+	 * @return Number of Objects Loaded from the Database
+	 * @throws std::runtime_error if an Object has no such Reference
+	 *
+	 * Resolves the named lazy reference of every object in the batch.
+	 * Referenced objects which are not already loaded are fetched with
+	 * "id in (...)" queries, so e.g. prefetching "site" for a page of Dives
+	 * costs one query rather than one per Dive.
+	 */
+	size_t prefetch(const AbstractMapper::Batch & objects, const std::string & name);
+
+	/**
+	 * @brief Load a Lazy Reference for a Batch of Objects
+	 * @param[in] Domain Objects
+	 * @param[in] Reference Attribute Name, e.g. "site"
+	 * @return Number of Objects Loaded from the Database
+	 */
+	template <typename D>
+	size_t prefetch(const std::vector<boost::shared_ptr<D> > & objects, const std::string & name)
+	{
+		return prefetch(AbstractMapper::Batch(objects.begin(), objects.end()), name);
+	}
+
+	//! @return Reference Cache, or an empty pointer if the Session does not use one
+	inline ReferenceCache::Ptr reference_cache() const { return m_refcache; }
+
+	//! @return Database File Name identifying the Session's Reference Cache Regions
+	inline const std::string & reference_database() const { return m_refdb; }
+
 	/**
 	 * @brief Roll Back the current Transaction
 	 *
@@ -197,17 +352,47 @@ public:
 	 */
 	void rollback();
 
+	/**
+	 * @brief Set the Reference Cache
+	 * @param[in] Reference Cache, or an empty pointer to disable it
+	 *
+	 * Cacheable mappers (see AbstractMapper::cacheable()) look objects up in
+	 * the Reference Cache before querying them by identifier.  Sessions on
+	 * in-memory databases cannot share rows, so they do not use the cache.
+	 *
+	 * The cache only follows changes made through the connections which are
+	 * attached to it (see ReferenceCache::attach()); Logbook::setReferenceCache()
+	 * attaches the Logbook connection and sets the cache on its Sessions.
+	 */
+	void set_reference_cache(ReferenceCache::Ptr cache);
+
 public:
 
 	//! @return List of Deleted Instances
 	uow_registry deleted() const;
 
-	//! @return List of Dirty Instances
+	/**
+	 * @brief Get the Dirty Instances
+	 * @return List of Dirty Instances
+	 *
+	 * Persistent objects register themselves with their Session the first
+	 * time they are modified after being loaded or flushed, so this only
+	 * visits modified objects rather than the whole identity map.  The
+	 * Session holds a reference to each modified object until it is flushed
+	 * or expunged, so unsaved changes are not lost if the caller releases
+	 * the object.
+	 */
 	uow_registry dirty() const;
 
+	//! @return Number of Dirty Instances
+	size_t dirty_count() const;
+
 	//! @return List of New Instances
 	uow_registry new_() const;
 
+	//! @return Unit of Work Statistics
+	Stats stats() const;
+
 public:
 
 	/**
@@ -231,6 +416,7 @@ public:
 		typename Mapper<D>::Ptr mptr(m);
 		const_typeinfo_ptr ti = & typeid(D);
 		m_mappers[ti] = mptr;
+		m_order.clear();
 	}
 
 public:
@@ -279,14 +465,17 @@ protected:
 	//! Get a list of Cascaded Objects for an Detach
 	std::list<Persistent::Ptr> cascade_detach(Persistent::Ptr p);
 
+	//! Validate the Foreign Keys of the Tables in a Flush Plan
+	void check_foreign_keys(const flush_plan & plan);
+
 	//! Detach an Object from this Session
 	void detach(Persistent::Ptr p);
 
 	//! Finalize Flush Changes
-	void finalize_flush(std::list<Persistent::Ptr> & objects);
+	void finalize_flush(AbstractMapper::Batch & objects);
 
-	//! Prune the Identity Map
-	void prune();
+	//! Finalize Flush Changes for a Flush Plan
+	void finalize_flush(flush_plan & plan);
 
 	//! Register an Object as Persistent with this Session (New or for Updates)
 	void register_(Persistent::Ptr p);
@@ -300,8 +489,14 @@ protected:
 	//! Register a Persisted Object with the Session
 	void register_update(Persistent::Ptr p);
 
+	//! Register a Modified Object with the Session (Called by Persistent)
+	void register_dirty(Persistent::Ptr p);
+
+	//! Unregister a Modified Object once it is Clean (Called by Persistent)
+	void unregister_dirty(Persistent::Ptr p);
+
 	//! Run the Flush Operation
-	void run_flush(std::list<Persistent::Ptr> & objects);
+	void run_flush(flush_plan & plan);
 
 protected:
 
@@ -315,29 +510,43 @@ protected:
 	void updateDirty();
 
 	/**
-	 * @brief Sort a Unit of Work Registry
-	 * @param[in] Unit of Work Registry
-	 * @return Ordered list of Persistents
+	 * @brief Get the Flush Order of the Mapped Classes
+	 * @return Dependency Rank of each Mapped Class
+	 * @throws std::runtime_error if the Mapper dependencies are cyclic
 	 *
-	 * Performs a topological sort of the unit of work registry to ensure that
-	 * database operations are carried out in the proper order such that object
-	 * relations are consistent.
+	 * Performs a topological sort of the registered mappers using the classes
+	 * returned by AbstractMapper::dependencies(), so that referenced classes
+	 * rank before the classes which refer to them.  The order is computed
+	 * once and cached until another mapper is registered.
+	 */
+	const flush_order_map & flush_order();
+
+	/**
+	 * @brief Build the Flush Plan for a Unit of Work Registry
+	 * @param[in] Unit of Work Registry
+	 * @return Flush Plan
 	 *
-	 * In particular, this method moves objects of type Mix, DiveSite and
-	 * DiveComputer to the beginning so that their id's are assigned first in
-	 * an insert operation and are correctly picked up when owning objects
-	 * such as Dive and Profile are inserted.
+	 * Groups the objects in the registry by mapper, in flush order, so that
+	 * new objects have their id's assigned before they are referenced by
+	 * owning objects such as Dive and Profile.  Within each group deletions
+	 * run first, then insertions, then updates.
 	 */
-	std::list<Persistent::Ptr> sort(const uow_registry & registry) const;
+	flush_plan plan_flush(const uow_registry & registry);
 
 private:
 	connection::ptr		m_conn;			///< Database Connection
 	mapper_registry		m_mappers;		///< Registry of Data Mappers
 	logging::logger *	m_logger;		///< Logger Instance
+	bool				m_readonly;		///< Read-Only Session
 
 	uow_registry		m_new;			///< Registry of New Objects
 	uow_registry		m_deleted;		///< Registry of Deleted Objects
-	identity_map		m_idmap;		///< Registry of Persistent Objects
+	uow_registry		m_dirty;		///< Registry of Modified Objects
+	IdentityMap			m_idmap;		///< Registry of Persistent Objects
+	flush_order_map		m_order;		///< Cached Flush Order of Mapped Classes
+
+	uint64_t			m_nmarked;		///< Total Objects registered as Modified
+	uint64_t			m_nupdated;		///< Total Objects updated by flush()
 
 	statement::ptr		m_beginsp;		///< Begin Savepoint Statement
 	statement::ptr		m_releasesp;	///< Release Savepoint Statement
@@ -345,8 +554,12 @@ private:
 
 	Events				m_events;		///< Session Event Signals
 
+	ReferenceCache::Ptr	m_refcache;		///< Reference Cache
+	std::string			m_refdb;		///< Database File Name for the Reference Cache
+
 private:
 	friend class AbstractMapper;
+	friend class Persistent;
 
 };
 
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/dbapi/backup.hpp"
+#include "benthos/logbook/dbapi/dbapi_error.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+const int backup::default_pages;
+const int backup::default_sleep_ms;
+
+backup::backup(connection::ptr dest, connection::ptr src, const std::string & dest_db, const std::string & src_db)
+	: m_dest(dest), m_src(src), m_backup(0), m_done(false)
+{
+	if (! m_dest || ! m_src)
+		throw dbapi_error("Backup requires a source and destination connection");
+
+	m_backup = sqlite3_backup_init(m_dest->handle(), dest_db.c_str(), m_src->handle(), src_db.c_str());
+	if (m_backup == 0)
+		throw dbapi_error(m_dest);
+}
+
+backup::~backup()
+{
+	if (m_backup != 0)
+		sqlite3_backup_finish(m_backup);
+	m_backup = 0;
+}
+
+bool backup::done() const
+{
+	return m_done;
+}
+
+void backup::finish()
+{
+	if (m_backup == 0)
+		return;
+
+	int rc = sqlite3_backup_finish(m_backup);
+	m_backup = 0;
+
+	if (rc != SQLITE_OK)
+		throw dbapi_error(m_dest);
+}
+
+int backup::page_count() const
+{
+	return (m_backup == 0) ? 0 : sqlite3_backup_pagecount(m_backup);
+}
+
+int backup::remaining() const
+{
+	return (m_backup == 0) ? 0 : sqlite3_backup_remaining(m_backup);
+}
+
+bool backup::run(int pages, int sleep_ms, progress_handler h)
+{
+	while (! step(pages))
+	{
+		if (h && ! h(remaining(), page_count()))
+		{
+			finish();
+			return false;
+		}
+
+		if (sleep_ms > 0)
+			sqlite3_sleep(sleep_ms);
+	}
+
+	if (h)
+		h(0, page_count());
+
+	finish();
+	return true;
+}
+
+bool backup::step(int pages)
+{
+	if (m_done)
+		return true;
+	if (m_backup == 0)
+		throw dbapi_error("Backup has already been finished");
+
+	int rc = sqlite3_backup_step(m_backup, pages);
+	if (rc == SQLITE_DONE)
+	{
+		m_done = true;
+		return true;
+	}
+
+	if ((rc == SQLITE_OK) || (rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED))
+		return false;
+
+	throw dbapi_error(sqlite3_errstr(rc));
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/dbapi/blob.hpp"
+#include "benthos/logbook/dbapi/dbapi_error.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+blob::blob(connection::ptr conn, const std::string & table, const std::string & column,
+	int64_t rowid, bool writable, const std::string & db)
+	: m_conn(conn), m_blob(0), m_rowid(rowid)
+{
+	if (! m_conn)
+		throw dbapi_error("Cannot open a BLOB on a NULL connection");
+	m_conn->check_thread();
+
+	int rc = sqlite3_blob_open(m_conn->handle(), db.c_str(), table.c_str(), column.c_str(),
+		rowid, writable ? 1 : 0, & m_blob);
+
+	if (rc != SQLITE_OK)
+	{
+		// sqlite3_blob_open may allocate a handle even on failure
+		dbapi_error e(m_conn);
+		if (m_blob != 0)
+			sqlite3_blob_close(m_blob);
+		m_blob = 0;
+		throw e;
+	}
+}
+
+blob::~blob()
+{
+	if (m_blob != 0)
+	{
+		sqlite3_blob_close(m_blob);
+		m_blob = 0;
+	}
+}
+
+sqlite3_blob * blob::handle()
+{
+	return m_blob;
+}
+
+size_t blob::read(void * buf, size_t n, size_t offset) const
+{
+	size_t sz = size();
+	if (offset >= sz)
+		return 0;
+	if (n > sz - offset)
+		n = sz - offset;
+	if (n == 0)
+		return 0;
+
+	if (sqlite3_blob_read(m_blob, buf, (int)n, (int)offset) != SQLITE_OK)
+		throw dbapi_error(m_conn);
+
+	return n;
+}
+
+std::vector<unsigned char> blob::read_all() const
+{
+	std::vector<unsigned char> result(size());
+	if (! result.empty())
+		read(& result[0], result.size(), 0);
+
+	return result;
+}
+
+void blob::reopen(int64_t rowid)
+{
+	if (sqlite3_blob_reopen(m_blob, rowid) != SQLITE_OK)
+		throw dbapi_error(m_conn);
+
+	m_rowid = rowid;
+}
+
+int64_t blob::rowid() const
+{
+	return m_rowid;
+}
+
+size_t blob::size() const
+{
+	return (size_t)sqlite3_blob_bytes(m_blob);
+}
+
+void blob::write(const void * buf, size_t n, size_t offset)
+{
+	if (n == 0)
+		return;
+
+	if (sqlite3_blob_write(m_blob, buf, (int)n, (int)offset) != SQLITE_OK)
+		throw dbapi_error(m_conn);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/dbapi/cancellation_token.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+cancellation_token::cancellation_token()
+	: m_state(new state_t)
+{
+	m_state->cancelled = false;
+	m_state->has_deadline = false;
+}
+
+void cancellation_token::cancel()
+{
+	m_state->cancelled = true;
+}
+
+cancellation_token cancellation_token::deadline(clock_type::time_point tp)
+{
+	cancellation_token t;
+	t.m_state->has_deadline = true;
+	t.m_state->deadline = tp;
+	return t;
+}
+
+bool cancellation_token::has_deadline() const
+{
+	return m_state->has_deadline;
+}
+
+bool cancellation_token::is_cancelled() const
+{
+	if (m_state->cancelled)
+		return true;
+	if (m_state->has_deadline && (clock_type::now() >= m_state->deadline))
+	{
+		m_state->cancelled = true;
+		return true;
+	}
+
+	return false;
+}
+
+cancellation_token cancellation_token::timeout(unsigned int ms)
+{
+	return deadline(clock_type::now() + std::chrono::milliseconds(ms));
+}
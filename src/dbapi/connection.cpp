@@ -32,8 +32,13 @@
 #include "benthos/logbook/dbapi/dbapi_error.hpp"
 #include "benthos/logbook/dbapi/statement.hpp"
 
+#include <algorithm>
+#include <cctype>
+
 using namespace benthos::logbook::dbapi;
 
+const int connection::default_progress_ops;
+
 int _authorize_handler(void * p, int evcode, const char * p1, const char * p2, const char * dbname, const char * tvname)
 {
 	connection::authorize_handler * h = static_cast<connection::authorize_handler *>(p);
@@ -46,12 +51,6 @@ int _busy_handler(void * p, int cnt)
 	return (* h)(cnt);
 }
 
-int _commit_handler(void * p)
-{
-	connection::commit_handler * h = static_cast<connection::commit_handler *>(p);
-	return (* h)();
-}
-
 void _rollback_handler(void * p)
 {
 	connection::rollback_handler * h = static_cast<connection::rollback_handler *>(p);
@@ -64,8 +63,160 @@ void _update_handler(void * p, int opcode, const char * dbname, const char * tvn
 	(* h)(opcode, dbname, tvname, rowid);
 }
 
+void _set_result(sqlite3_context * ctx, const variant & v)
+{
+	switch (v.type())
+	{
+	case variant::int_type:
+		sqlite3_result_int(ctx, v.get<int>());
+		break;
+
+	case variant::int64_type:
+		sqlite3_result_int64(ctx, v.get<int64_t>());
+		break;
+
+	case variant::double_type:
+		sqlite3_result_double(ctx, v.get<double>());
+		break;
+
+	case variant::text_type:
+	{
+		text_ref t = v.text();
+		sqlite3_result_text(ctx, t.data, t.size, SQLITE_TRANSIENT);
+		break;
+	}
+
+	case variant::blob_type:
+	{
+		blob_ref b = v.blob();
+		sqlite3_result_blob(ctx, b.data, b.size, SQLITE_TRANSIENT);
+		break;
+	}
+
+	default:
+		sqlite3_result_null(ctx);
+		break;
+
+	}
+}
+
+void _scalar_handler(sqlite3_context * ctx, int argc, sqlite3_value ** argv)
+{
+	scalar_function * f = static_cast<scalar_function *>(sqlite3_user_data(ctx));
+	try
+	{
+		_set_result(ctx, (* f)(function_args(argc, argv)));
+	}
+	catch (std::exception & e)
+	{
+		sqlite3_result_error(ctx, e.what(), -1);
+	}
+}
+
+void _scalar_destroy(void * p)
+{
+	delete static_cast<scalar_function *>(p);
+}
+
+void _aggregate_step(sqlite3_context * ctx, int argc, sqlite3_value ** argv)
+{
+	aggregate_factory * f = static_cast<aggregate_factory *>(sqlite3_user_data(ctx));
+	aggregate ** a = static_cast<aggregate **>(sqlite3_aggregate_context(ctx, sizeof(aggregate *)));
+	if (a == 0)
+	{
+		sqlite3_result_error_nomem(ctx);
+		return;
+	}
+
+	try
+	{
+		if (* a == 0)
+			* a = (* f)();
+		(* a)->step(function_args(argc, argv));
+	}
+	catch (std::exception & e)
+	{
+		sqlite3_result_error(ctx, e.what(), -1);
+	}
+}
+
+void _aggregate_final(sqlite3_context * ctx)
+{
+	aggregate_factory * f = static_cast<aggregate_factory *>(sqlite3_user_data(ctx));
+	aggregate ** a = static_cast<aggregate **>(sqlite3_aggregate_context(ctx, 0));
+
+	// The aggregate context is not allocated if the group had no rows
+	aggregate * agg = (a != 0) ? * a : 0;
+	try
+	{
+		if (agg == 0)
+			agg = (* f)();
+		_set_result(ctx, agg->finish());
+	}
+	catch (std::exception & e)
+	{
+		sqlite3_result_error(ctx, e.what(), -1);
+	}
+
+	delete agg;
+}
+
+void _aggregate_destroy(void * p)
+{
+	delete static_cast<aggregate_factory *>(p);
+}
+
+std::pair<std::string, int> _function_key(const std::string & name, int nargs)
+{
+	std::string key(name);
+	std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+	return std::make_pair(key, nargs);
+}
+
+int connection::commit_callback(void * p)
+{
+	connection * c = static_cast<connection *>(p);
+	int rc = c->m_ch ? c->m_ch() : 0;
+	c->m_committing = (rc == 0);
+	return rc;
+}
+
+int connection::progress_callback(void * p)
+{
+	connection * c = static_cast<connection *>(p);
+
+	std::vector<cancellation_token>::const_iterator it;
+	for (it = c->m_tokens.begin(); it != c->m_tokens.end(); it++)
+		if (it->is_cancelled())
+			return 1;
+
+	if (c->m_ph)
+		return c->m_ph();
+
+	return 0;
+}
+
+int connection::trace_callback(unsigned int evt, void * p, void * stmt, void * x)
+{
+	connection * c = static_cast<connection *>(p);
+	int64_t ns = 0;
+
+	if (c->m_profiling)
+		ns = c->m_profiler.trace(evt, static_cast<sqlite3_stmt *>(stmt), x);
+	else if (evt == SQLITE_TRACE_PROFILE)
+		ns = * static_cast<sqlite3_int64 *>(x);
+
+	if ((evt == SQLITE_TRACE_PROFILE) && c->m_th)
+		c->m_th(static_cast<sqlite3_stmt *>(stmt), ns);
+
+	return 0;
+}
+
 connection::connection(const char * dbname)
-	: m_db(0), m_transaction(false), s_begin(0), s_commit(0), s_rollback(0)
+	: m_db(0), m_committing(false), m_ph_ops(default_progress_ops), m_tokens(), m_owner(),
+	  m_readonly(false), m_transaction(false),
+	  s_begin(0), s_commit(0), s_rollback(0), m_cache(),
+	  m_profiler(), m_profiling(false)
 {
 	// Default to in-memory database
 	if (dbname == 0)
@@ -75,6 +226,28 @@ connection::connection(const char * dbname)
 	if (sqlite3_open(dbname, & m_db) != SQLITE_OK)
 		throw dbapi_error(this);
 
+	init();
+}
+
+connection::connection(const char * dbname, int flags)
+	: m_db(0), m_committing(false), m_ph_ops(default_progress_ops), m_tokens(), m_owner(),
+	  m_readonly((flags & SQLITE_OPEN_READONLY) != 0), m_transaction(false),
+	  s_begin(0), s_commit(0), s_rollback(0), m_cache(),
+	  m_profiler(), m_profiling(false)
+{
+	// Default to in-memory database
+	if (dbname == 0)
+		dbname = ":memory:";
+
+	// Open the Database Connection
+	if (sqlite3_open_v2(dbname, & m_db, flags, 0) != SQLITE_OK)
+		throw dbapi_error(this);
+
+	init();
+}
+
+void connection::init()
+{
 	// Prepare the Transaction Statements
 	const char * _begin = "BEGIN TRANSACTION";
 	const char * _commit = "COMMIT TRANSACTION";
@@ -88,6 +261,38 @@ connection::connection(const char * dbname)
 		throw sql_error(this);
 }
 
+void connection::after_step(int rc)
+{
+	if (! m_committing)
+		return;
+
+	m_committing = false;
+	if ((rc == SQLITE_DONE) && m_cdh)
+		m_cdh();
+}
+
+void connection::update_commit()
+{
+	sqlite3_commit_hook(m_db, (m_ch || m_cdh) ? commit_callback : 0, this);
+}
+
+void connection::update_progress()
+{
+	bool active = (m_ph || ! m_tokens.empty());
+	sqlite3_progress_handler(m_db, active ? m_ph_ops : 0, active ? progress_callback : 0, this);
+}
+
+void connection::update_trace()
+{
+	unsigned int mask = 0;
+	if (m_profiling)
+		mask |= SQLITE_TRACE_STMT | SQLITE_TRACE_ROW | SQLITE_TRACE_PROFILE;
+	if (m_th)
+		mask |= SQLITE_TRACE_PROFILE;
+
+	sqlite3_trace_v2(m_db, mask, mask ? trace_callback : 0, this);
+}
+
 connection::~connection()
 {
 	// Roll Back any current Transaction
@@ -106,9 +311,14 @@ connection::~connection()
 	s_commit = 0;
 	s_rollback = 0;
 
+	// Release Cached Statements
+	m_cache.clear();
+
 	// Close the Database Connection
 	if (m_db != 0)
 	{
+		sqlite3_trace_v2(m_db, 0, 0, 0);
+		sqlite3_progress_handler(m_db, 0, 0, 0);
 		sqlite3_close(m_db);
 		m_db = 0;
 	}
@@ -122,14 +332,57 @@ void connection::begin()
 	sqlite3_reset(s_begin);
 }
 
+void connection::check_thread() const
+{
+	std::thread::id owner = m_owner.load();
+	if ((owner != std::thread::id()) && (owner != std::this_thread::get_id()))
+		throw dbapi_error("Connection is owned by another thread; use it from that thread only");
+}
+
 void connection::commit()
 {
-	if (sqlite3_step(s_commit) != SQLITE_DONE)
+	int rc = sqlite3_step(s_commit);
+	after_step(rc);
+	if (rc != SQLITE_DONE)
 		throw sql_error(this);
 	m_transaction = false;
 	sqlite3_reset(s_commit);
 }
 
+void connection::create_aggregate(const std::string & name, int nargs, aggregate_factory f,
+	bool deterministic)
+{
+	if (! f)
+		throw dbapi_error("Aggregate factory for " + name + " is empty");
+
+	int flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+	aggregate_factory * p = new aggregate_factory(f);
+
+	// SQLite calls the destructor on failure as well
+	if (sqlite3_create_function_v2(m_db, name.c_str(), nargs, flags, p, 0,
+			_aggregate_step, _aggregate_final, _aggregate_destroy) != SQLITE_OK)
+		throw dbapi_error(this);
+
+	m_functions.insert(_function_key(name, nargs));
+}
+
+void connection::create_function(const std::string & name, int nargs, scalar_function f,
+	bool deterministic)
+{
+	if (! f)
+		throw dbapi_error("Function " + name + " is empty");
+
+	int flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+	scalar_function * p = new scalar_function(f);
+
+	// SQLite calls the destructor on failure as well
+	if (sqlite3_create_function_v2(m_db, name.c_str(), nargs, flags, p,
+			_scalar_handler, 0, 0, _scalar_destroy) != SQLITE_OK)
+		throw dbapi_error(this);
+
+	m_functions.insert(_function_key(name, nargs));
+}
+
 int connection::error_code()
 {
 	return sqlite3_errcode(m_db);
@@ -140,10 +393,9 @@ const char * connection::error_msg()
 	return sqlite3_errmsg(m_db);
 }
 
-boost::shared_ptr<cursor> connection::exec_sql(const std::string & sql)
+boost::shared_ptr<cursor> connection::exec_sql(const std::string & sql, bool cached)
 {
-	statement::ptr s(new statement(shared_from_this(), sql));
-	return s->exec();
+	return prepare(sql, cached)->exec();
 }
 
 sqlite3 * connection::handle()
@@ -151,6 +403,77 @@ sqlite3 * connection::handle()
 	return m_db;
 }
 
+bool connection::has_function(const std::string & name, int nargs) const
+{
+	return m_functions.count(_function_key(name, nargs)) != 0;
+}
+
+void connection::interrupt()
+{
+	sqlite3_interrupt(m_db);
+}
+
+bool connection::is_busy() const
+{
+	if (! sqlite3_get_autocommit(m_db))
+		return true;
+
+	for (sqlite3_stmt * s = sqlite3_next_stmt(m_db, 0); s != 0; s = sqlite3_next_stmt(m_db, s))
+		if (sqlite3_stmt_busy(s))
+			return true;
+
+	return false;
+}
+
+bool connection::is_readonly() const
+{
+	return m_readonly;
+}
+
+boost::shared_ptr<statement> connection::prepare(const std::string & sql, bool cached)
+{
+	check_thread();
+
+	if (! cached)
+		return statement::ptr(new statement(shared_from_this(), sql));
+
+	sqlite3_stmt * stmt = m_cache.checkout(sql);
+	return statement::ptr(new statement(shared_from_this(), sql, stmt));
+}
+
+bool connection::is_profiling() const
+{
+	return m_profiling;
+}
+
+std::thread::id connection::owner_thread() const
+{
+	return m_owner.load();
+}
+
+void connection::pop_cancellation()
+{
+	if (m_tokens.empty())
+		throw dbapi_error("No cancellation token is attached to the connection");
+
+	m_tokens.pop_back();
+	update_progress();
+}
+
+void connection::push_cancellation(const cancellation_token & token)
+{
+	m_tokens.push_back(token);
+	update_progress();
+}
+
+void connection::remove_function(const std::string & name, int nargs)
+{
+	if (sqlite3_create_function_v2(m_db, name.c_str(), nargs, SQLITE_UTF8, 0, 0, 0, 0, 0) != SQLITE_OK)
+		throw dbapi_error(this);
+
+	m_functions.erase(_function_key(name, nargs));
+}
+
 void connection::rollback()
 {
 	sqlite3_step(s_rollback);
@@ -179,7 +502,31 @@ void connection::set_busy_timeout(int ms)
 void connection::set_commit_handler(commit_handler h)
 {
 	m_ch = h;
-	sqlite3_commit_hook(m_db, h ? _commit_handler : 0, & m_ch);
+	update_commit();
+}
+
+void connection::set_committed_handler(committed_handler h)
+{
+	m_cdh = h;
+	update_commit();
+}
+
+void connection::set_owner_thread(std::thread::id id)
+{
+	m_owner.store(id);
+}
+
+void connection::set_profiling(bool enable)
+{
+	m_profiling = enable;
+	update_trace();
+}
+
+void connection::set_progress_handler(progress_handler h, int n_ops)
+{
+	m_ph = h;
+	m_ph_ops = (n_ops > 0) ? n_ops : default_progress_ops;
+	update_progress();
 }
 
 void connection::set_rollback_handler(rollback_handler h)
@@ -188,13 +535,43 @@ void connection::set_rollback_handler(rollback_handler h)
 	sqlite3_rollback_hook(m_db, h ? _rollback_handler : 0, & m_rh);
 }
 
+void connection::set_trace_handler(trace_handler h)
+{
+	m_th = h;
+	update_trace();
+}
+
 void connection::set_update_handler(update_handler h)
 {
 	m_uh = h;
 	sqlite3_update_hook(m_db, h ? _update_handler : 0, & m_uh);
 }
 
+statement_cache & connection::stmt_cache()
+{
+	return m_cache;
+}
+
+profiler & connection::stmt_profiler()
+{
+	return m_profiler;
+}
+
 bool connection::transaction_active() const
 {
 	return m_transaction;
 }
+
+cancellation_scope::cancellation_scope(connection::ptr conn, const cancellation_token & token)
+	: m_conn(conn)
+{
+	if (token.is_cancelled())
+		throw interrupted_error("Query was cancelled before it started");
+
+	m_conn->push_cancellation(token);
+}
+
+cancellation_scope::~cancellation_scope()
+{
+	m_conn->pop_cancellation();
+}
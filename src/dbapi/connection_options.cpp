@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+
+#include "benthos/logbook/dbapi/connection_options.hpp"
+#include "benthos/logbook/dbapi/dbapi_error.hpp"
+#include "benthos/logbook/dbapi/statement.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+namespace {
+
+const char * journal_mode_names[] = { "delete", "truncate", "persist", "memory", "wal", "off" };
+const char * locking_mode_names[] = { "normal", "exclusive" };
+
+void set_pragma(connection::ptr conn, const char * name, int64_t value)
+{
+	std::ostringstream ss;
+	ss << "pragma " << name << "=" << value;
+	conn->prepare(ss.str(), false)->execute();
+}
+
+void set_pragma(connection::ptr conn, const char * name, const char * value)
+{
+	std::ostringstream ss;
+	ss << "pragma " << name << "=" << value;
+	conn->prepare(ss.str(), false)->execute();
+}
+
+}
+
+connection_options::connection_options()
+	: mmap_size(), cache_size(), page_size(), journal_mode(), synchronous(),
+	  temp_store(), locking_mode(), read_only(false)
+{
+}
+
+connection_options connection_options::bulk_import()
+{
+	connection_options o;
+	o.mmap_size = 256 * 1024 * 1024;
+	o.cache_size = -64 * 1024;
+	o.synchronous = synchronous_off;
+	o.temp_store = temp_store_memory;
+	return o;
+}
+
+connection_options connection_options::interactive()
+{
+	connection_options o;
+	o.mmap_size = 64 * 1024 * 1024;
+	o.cache_size = -16 * 1024;
+	o.synchronous = synchronous_normal;
+	return o;
+}
+
+connection_options connection_options::read_only_analytics()
+{
+	connection_options o;
+	o.mmap_size = (int64_t)1024 * 1024 * 1024;
+	o.cache_size = -128 * 1024;
+	o.temp_store = temp_store_memory;
+	o.read_only = true;
+	return o;
+}
+
+bool connection_options::allows_wal() const
+{
+	if (journal_mode && (journal_mode.get() != journal_wal))
+		return false;
+	if (locking_mode && (locking_mode.get() == locking_exclusive))
+		return false;
+	return true;
+}
+
+void connection_options::apply(connection::ptr conn) const
+{
+	if (page_size && ! read_only)
+		set_pragma(conn, "page_size", page_size.get());
+
+	if (locking_mode)
+		set_pragma(conn, "locking_mode", locking_mode_names[locking_mode.get()]);
+
+	if (journal_mode && ! read_only)
+	{
+		// SQLite reports the resulting mode rather than failing outright
+		const char * name = journal_mode_names[journal_mode.get()];
+		std::string mode = conn->prepare(std::string("pragma journal_mode=") + name, false)->query_scalar<std::string>();
+		if (! boost::iequals(mode, name))
+			throw dbapi_error(std::string("Failed to set journal mode to ") + name);
+	}
+
+	if (synchronous)
+		set_pragma(conn, "synchronous", synchronous.get());
+	if (cache_size)
+		set_pragma(conn, "cache_size", cache_size.get());
+	if (temp_store)
+		set_pragma(conn, "temp_store", temp_store.get());
+	if (mmap_size)
+		set_pragma(conn, "mmap_size", mmap_size.get());
+}
+
+int connection_options::open_flags() const
+{
+	if (read_only)
+		return SQLITE_OPEN_READONLY;
+	return SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+}
+
+connection_options connection_options::reader_options() const
+{
+	connection_options o;
+	o.mmap_size = mmap_size;
+	o.cache_size = cache_size;
+	o.temp_store = temp_store;
+	o.read_only = true;
+	return o;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/dbapi/connection_pool.hpp"
+#include "benthos/logbook/dbapi/dbapi_error.hpp"
+#include "benthos/logbook/dbapi/statement.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/core/null_deleter.hpp>
+
+using namespace benthos::logbook::dbapi;
+
+void connection_pool::releaser::operator() (connection * c) const
+{
+	connection_pool::ptr p = pool.lock();
+	if (p)
+		p->release(c);
+	else
+		delete c;
+}
+
+connection_pool::connection_pool(const std::string & dbname, connection::ptr writer, size_t max_idle,
+	const connection_options & options)
+	: m_dbname(dbname), m_writer(writer), m_options(options.reader_options()), m_idle(),
+	  m_max_idle(max_idle), m_nreaders(0), m_wal(false), m_mutex()
+{
+	/*
+	 * Switch to WAL mode up front; SQLite refuses to change the journal mode
+	 * while the writer has any statements in progress, which is almost always
+	 * the case once a Session is in use.
+	 */
+	if (! m_dbname.empty() && (m_dbname != ":memory:") && options.allows_wal())
+		enable_wal();
+}
+
+connection_pool::~connection_pool()
+{
+	std::list<connection *>::iterator it;
+	for (it = m_idle.begin(); it != m_idle.end(); it++)
+		delete (* it);
+	m_idle.clear();
+}
+
+connection::ptr connection_pool::acquire_reader()
+{
+	connection * c = 0;
+
+	if (! m_wal)
+		throw dbapi_error("Read-only connections are only available for databases in WAL mode");
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (! m_idle.empty())
+		{
+			c = m_idle.front();
+			m_idle.pop_front();
+		}
+		else
+		{
+			m_nreaders++;
+		}
+	}
+
+	/*
+	 * New readers are opened and configured without holding the lock, and
+	 * are only handed to the releaser once configured, so a reader whose
+	 * options failed to apply never ends up on the idle list.
+	 */
+	if (! c)
+	{
+		try
+		{
+			c = new connection(m_dbname.c_str(), m_options.open_flags());
+			m_options.apply(connection::ptr(c, boost::null_deleter()));
+		}
+		catch (...)
+		{
+			delete c;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_nreaders--;
+			throw;
+		}
+	}
+
+	releaser r;
+	r.pool = shared_from_this();
+	return connection::ptr(c, r);
+}
+
+const std::string & connection_pool::dbname() const
+{
+	return m_dbname;
+}
+
+void connection_pool::enable_wal()
+{
+	// A read-only writer cannot change the journal mode; use it if it is WAL
+	if (m_writer->is_readonly())
+	{
+		std::string mode = m_writer->prepare("pragma journal_mode", false)->query_scalar<std::string>();
+		m_wal = boost::iequals(mode, "wal");
+		return;
+	}
+
+	std::string mode = m_writer->prepare("pragma journal_mode=wal", false)->query_scalar<std::string>();
+	if (! boost::iequals(mode, "wal"))
+		throw dbapi_error("Failed to enable WAL mode on " + m_dbname);
+
+	m_wal = true;
+}
+
+bool connection_pool::has_readers() const
+{
+	return m_wal;
+}
+
+size_t connection_pool::idle_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_idle.size();
+}
+
+size_t connection_pool::max_idle() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_max_idle;
+}
+
+size_t connection_pool::reader_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nreaders;
+}
+
+void connection_pool::release(connection * c)
+{
+	// End any read transaction left open by the previous user
+	if (! sqlite3_get_autocommit(c->handle()))
+		c->rollback();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_idle.size() < m_max_idle)
+		{
+			m_idle.push_back(c);
+			c = 0;
+		}
+		else
+		{
+			m_nreaders--;
+		}
+	}
+
+	delete c;
+}
+
+void connection_pool::set_max_idle(size_t n)
+{
+	std::list<connection *> closed;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_max_idle = n;
+		while (m_idle.size() > m_max_idle)
+		{
+			closed.push_back(m_idle.back());
+			m_idle.pop_back();
+			m_nreaders--;
+		}
+	}
+
+	std::list<connection *>::iterator it;
+	for (it = closed.begin(); it != closed.end(); it++)
+		delete (* it);
+}
+
+connection::ptr connection_pool::writer() const
+{
+	return m_writer;
+}
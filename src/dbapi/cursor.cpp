@@ -36,6 +36,54 @@
 
 using namespace benthos::logbook::dbapi;
 
+cursor::iterator::iterator()
+	: m_cursor(0), m_row()
+{
+}
+
+cursor::iterator::iterator(cursor * c)
+	: m_cursor(c), m_row()
+{
+	if (m_cursor && m_cursor->at_end())
+		m_cursor = 0;
+	if (m_cursor)
+		m_row = m_cursor->current();
+}
+
+cursor::iterator::reference cursor::iterator::operator* () const
+{
+	return m_row;
+}
+
+cursor::iterator::pointer cursor::iterator::operator-> () const
+{
+	return & m_row;
+}
+
+cursor::iterator & cursor::iterator::operator++ ()
+{
+	if (m_cursor && ! m_cursor->next())
+		m_cursor = 0;
+	return * this;
+}
+
+cursor::iterator cursor::iterator::operator++ (int)
+{
+	iterator tmp(* this);
+	++(* this);
+	return tmp;
+}
+
+bool cursor::iterator::operator== (const iterator & other) const
+{
+	return m_cursor == other.m_cursor;
+}
+
+bool cursor::iterator::operator!= (const iterator & other) const
+{
+	return m_cursor != other.m_cursor;
+}
+
 cursor::cursor(statement::ptr stmt, bool empty)
 	: m_stmt(stmt), m_done(empty), m_names(), m_tblnames(), m_orgnames()
 {
@@ -58,6 +106,16 @@ cursor::~cursor()
 {
 }
 
+bool cursor::at_end() const
+{
+	return m_done;
+}
+
+cursor::iterator cursor::begin()
+{
+	return iterator(this);
+}
+
 int cursor::column_count() const
 {
 	return m_ncols;
@@ -78,6 +136,19 @@ const std::vector<std::string> & cursor::column_origin_names() const
 	return m_orgnames;
 }
 
+cursor::row_view cursor::current() const
+{
+	if (m_done)
+		throw std::runtime_error("Cursor is at the end of the result set");
+
+	return row_view(m_stmt.lock()->handle(), m_ncols);
+}
+
+cursor::iterator cursor::end()
+{
+	return iterator();
+}
+
 cursor::row_t cursor::fetchone()
 {
 	// Fetch the Current Row
@@ -138,51 +209,24 @@ int64_t cursor::last_rowid()
 variant cursor::load_column(int idx)
 {
 	statement::ptr st = m_stmt.lock();
-	if ((idx < 0) || (idx >= st->num_columns()))
-		throw std::out_of_range(std::string("Column ") + boost::lexical_cast<std::string>(idx) + " is out of range");
-	int type = sqlite3_column_type(st->handle(), idx);
-
-	switch (type)
-	{
-	case SQLITE_INTEGER:
-	{
-		int64_t i = sqlite3_column_int64(st->handle(), idx);
-		if ((i < INT_MIN) || (i > INT_MAX))
-			return variant(i);
-		return variant((int)i);
-	}
-
-	case SQLITE_FLOAT:
-		return variant(sqlite3_column_double(st->handle(), idx));
-
-	case SQLITE_TEXT:
-	{
-		std::string s((const char *)sqlite3_column_text(st->handle(), idx));
-		return variant(s);
-	}
-
-	case SQLITE_BLOB:
-	{
-		int len = sqlite3_column_bytes(st->handle(), idx);
-		const void * data = sqlite3_column_blob(st->handle(), idx);
-		std::vector<unsigned char> blob(len, * (const unsigned char *)(data));
-		return variant(blob);
-	}
-
-	case SQLITE_NULL:
-		return variant();
-
-	default:
-		throw dbapi_error(st->m_conn);
-
-	}
+	return row_view(st->handle(), st->num_columns()).value(idx);
 }
 
 void cursor::load_row(row_t & row)
 {
+	row_view v(m_stmt.lock()->handle(), m_ncols);
+
 	row.clear();
-	for (int i = 0; i < column_count(); i++)
-		row.push_back(load_column(i));
+	row.reserve(m_ncols);
+	for (int i = 0; i < m_ncols; i++)
+		row.push_back(v.value(i));
+}
+
+bool cursor::next()
+{
+	if (! m_done)
+		m_done = ! m_stmt.lock()->step();
+	return ! m_done;
 }
 
 size_t cursor::rowcount()
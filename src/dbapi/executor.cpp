@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/dbapi/executor.hpp"
+
+#include <stdexcept>
+
+using namespace benthos::logbook::dbapi;
+
+executor::executor(connection::ptr conn)
+	: m_conn(conn), m_queue(new queue_state), m_thread()
+{
+	m_thread = std::thread(& executor::run, m_queue);
+	m_conn->set_owner_thread(m_thread.get_id());
+}
+
+executor::~executor()
+{
+	shutdown();
+}
+
+connection::ptr executor::conn() const
+{
+	return m_conn;
+}
+
+size_t executor::pending() const
+{
+	std::lock_guard<std::mutex> lock(m_queue->mutex);
+	return m_queue->tasks.size();
+}
+
+void executor::post(task_t t)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queue->mutex);
+		if (m_queue->stop)
+			throw std::runtime_error("Executor has been shut down");
+		m_queue->tasks.push_back(t);
+	}
+
+	m_queue->cond.notify_one();
+}
+
+void executor::run(boost::shared_ptr<queue_state> q)
+{
+	for (;;)
+	{
+		task_t t;
+
+		{
+			std::unique_lock<std::mutex> lock(q->mutex);
+			while (q->tasks.empty() && ! q->stop)
+				q->cond.wait(lock);
+
+			if (q->tasks.empty())
+				return;
+
+			t = q->tasks.front();
+			q->tasks.pop_front();
+		}
+
+		try
+		{
+			t();
+		}
+		catch (...)
+		{
+		}
+	}
+}
+
+void executor::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queue->mutex);
+		m_queue->stop = true;
+	}
+
+	m_queue->cond.notify_all();
+
+	if (! m_thread.joinable())
+		return;
+
+	/*
+	 * A task which drops the last reference to the executor cannot join its
+	 * own thread; the queue state is shared, so the detached thread finishes
+	 * the remaining tasks safely.  Otherwise the connection is handed back
+	 * to other threads once the queue has drained.
+	 */
+	if (m_thread.get_id() == std::this_thread::get_id())
+	{
+		m_thread.detach();
+	}
+	else
+	{
+		m_thread.join();
+		m_conn->set_owner_thread(std::thread::id());
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <climits>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+#include "benthos/logbook/dbapi/function.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+aggregate::~aggregate()
+{
+}
+
+function_args::function_args(int argc, sqlite3_value ** argv)
+	: m_argc(argc), m_argv(argv)
+{
+}
+
+blob_ref function_args::blob(int idx) const
+{
+	check_index(idx);
+	return value_reader<blob_ref>::read(m_argv[idx]);
+}
+
+void function_args::check_index(int idx) const
+{
+	if ((idx < 0) || (idx >= m_argc))
+		throw std::out_of_range(std::string("Argument ") + boost::lexical_cast<std::string>(idx) + " is out of range");
+}
+
+sqlite3_value * function_args::handle(int idx) const
+{
+	check_index(idx);
+	return m_argv[idx];
+}
+
+bool function_args::is_null(int idx) const
+{
+	return type(idx) == SQLITE_NULL;
+}
+
+int function_args::size() const
+{
+	return m_argc;
+}
+
+text_ref function_args::text(int idx) const
+{
+	check_index(idx);
+	return value_reader<text_ref>::read(m_argv[idx]);
+}
+
+int function_args::type(int idx) const
+{
+	check_index(idx);
+	return sqlite3_value_type(m_argv[idx]);
+}
+
+variant function_args::value(int idx) const
+{
+	switch (type(idx))
+	{
+	case SQLITE_INTEGER:
+	{
+		int64_t i = sqlite3_value_int64(m_argv[idx]);
+		if ((i < INT_MIN) || (i > INT_MAX))
+			return variant(i);
+		return variant((int)i);
+	}
+
+	case SQLITE_FLOAT:
+		return variant(sqlite3_value_double(m_argv[idx]));
+
+	case SQLITE_TEXT:
+		return variant::borrowed(value_reader<text_ref>::read(m_argv[idx]));
+
+	case SQLITE_BLOB:
+		return variant::borrowed(value_reader<blob_ref>::read(m_argv[idx]));
+
+	case SQLITE_NULL:
+		return variant();
+
+	default:
+		throw std::runtime_error("Unknown SQLite value type");
+
+	}
+}
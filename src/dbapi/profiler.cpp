@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <yajl/yajl_gen.h>
+
+#include "benthos/logbook/dbapi/profiler.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+namespace {
+
+//! Order Statistics by descending Total Time
+bool by_total_desc(const statement_stats & a, const statement_stats & b)
+{
+	return a.total_ns > b.total_ns;
+}
+
+//! Return the given Percentile of a sorted Sample List
+uint64_t percentile(const std::vector<uint64_t> & sorted, unsigned int pct)
+{
+	if (sorted.empty())
+		return 0;
+	return sorted[((sorted.size() - 1) * pct) / 100];
+}
+
+void gen_key(yajl_gen g, const char * key)
+{
+	yajl_gen_string(g, (const unsigned char *)key, strlen(key));
+}
+
+void gen_uint(yajl_gen g, const char * key, uint64_t value)
+{
+	gen_key(g, key);
+	yajl_gen_integer(g, (long long)value);
+}
+
+}
+
+statement_stats::statement_stats()
+	: sql(), calls(0), rows(0), total_ns(0), min_ns(0), max_ns(0), p50_ns(0), p90_ns(0),
+	  p99_ns(0), fullscan_steps(0), sorts(0), autoindex(0), vm_steps(0)
+{
+}
+
+profiler::profiler()
+	: m_pending(), m_entries()
+{
+}
+
+profiler::~profiler()
+{
+}
+
+int64_t profiler::finish(sqlite3_stmt * stmt, int64_t sqlite_ns)
+{
+	const char * sql = sqlite3_sql(stmt);
+	if (sql == 0)
+		return sqlite_ns;
+
+	// Prefer our own clock; SQLite's timer has only millisecond resolution
+	uint64_t elapsed = (sqlite_ns > 0) ? (uint64_t)sqlite_ns : 0;
+	uint64_t rows = 0;
+
+	std::map<sqlite3_stmt *, pending_t>::iterator pit = m_pending.find(stmt);
+	if (pit != m_pending.end())
+	{
+		elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - pit->second.start).count();
+		rows = pit->second.rows;
+		m_pending.erase(pit);
+	}
+
+	entry_t & e = m_entries[sql];
+	statement_stats & s = e.stats;
+	if (s.calls == 0)
+	{
+		s.sql = sql;
+		s.min_ns = elapsed;
+		e.next = 0;
+	}
+
+	s.calls++;
+	s.rows += rows;
+	s.total_ns += elapsed;
+	s.min_ns = std::min(s.min_ns, elapsed);
+	s.max_ns = std::max(s.max_ns, elapsed);
+
+	s.fullscan_steps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+	s.sorts += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+	s.autoindex += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+	s.vm_steps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+
+	if (e.samples.size() < sample_capacity)
+	{
+		e.samples.push_back(elapsed);
+	}
+	else
+	{
+		e.samples[e.next] = elapsed;
+		e.next = (e.next + 1) % sample_capacity;
+	}
+
+	return (int64_t)elapsed;
+}
+
+void profiler::reset()
+{
+	m_entries.clear();
+}
+
+std::vector<statement_stats> profiler::snapshot() const
+{
+	std::vector<statement_stats> result;
+	result.reserve(m_entries.size());
+
+	std::map<std::string, entry_t>::const_iterator it;
+	for (it = m_entries.begin(); it != m_entries.end(); it++)
+	{
+		std::vector<uint64_t> sorted(it->second.samples);
+		std::sort(sorted.begin(), sorted.end());
+
+		statement_stats s(it->second.stats);
+		s.p50_ns = percentile(sorted, 50);
+		s.p90_ns = percentile(sorted, 90);
+		s.p99_ns = percentile(sorted, 99);
+		result.push_back(s);
+	}
+
+	std::sort(result.begin(), result.end(), by_total_desc);
+	return result;
+}
+
+std::string profiler::to_json(bool beautify) const
+{
+	std::vector<statement_stats> stats = snapshot();
+
+	yajl_gen g = yajl_gen_alloc(NULL);
+	yajl_gen_config(g, yajl_gen_beautify, beautify ? 1 : 0);
+	yajl_gen_config(g, yajl_gen_validate_utf8, 1);
+
+	yajl_gen_array_open(g);
+
+	std::vector<statement_stats>::const_iterator it;
+	for (it = stats.begin(); it != stats.end(); it++)
+	{
+		yajl_gen_map_open(g);
+
+		gen_key(g, "sql");
+		yajl_gen_string(g, (const unsigned char *)it->sql.c_str(), it->sql.size());
+
+		gen_uint(g, "calls", it->calls);
+		gen_uint(g, "rows", it->rows);
+		gen_uint(g, "total_ns", it->total_ns);
+		gen_uint(g, "min_ns", it->min_ns);
+		gen_uint(g, "max_ns", it->max_ns);
+		gen_uint(g, "p50_ns", it->p50_ns);
+		gen_uint(g, "p90_ns", it->p90_ns);
+		gen_uint(g, "p99_ns", it->p99_ns);
+		gen_uint(g, "fullscan_steps", it->fullscan_steps);
+		gen_uint(g, "sorts", it->sorts);
+		gen_uint(g, "autoindex", it->autoindex);
+		gen_uint(g, "vm_steps", it->vm_steps);
+
+		yajl_gen_map_close(g);
+	}
+
+	yajl_gen_array_close(g);
+
+	const unsigned char * buf = 0;
+	size_t buflen = 0;
+
+	yajl_gen_get_buf(g, & buf, & buflen);
+	std::string result((const char *)buf, buflen);
+	yajl_gen_free(g);
+
+	return result;
+}
+
+int64_t profiler::trace(unsigned int evt, sqlite3_stmt * stmt, void * x)
+{
+	switch (evt)
+	{
+	case SQLITE_TRACE_STMT:
+	{
+		// Trigger sub-programs are reported with a comment; keep the outer start
+		const char * text = static_cast<const char *>(x);
+		if ((text != 0) && (text[0] == '-') && (text[1] == '-'))
+			break;
+
+		pending_t & p = m_pending[stmt];
+		p.start = clock_type::now();
+		p.rows = 0;
+		break;
+	}
+
+	case SQLITE_TRACE_ROW:
+	{
+		std::map<sqlite3_stmt *, pending_t>::iterator it = m_pending.find(stmt);
+		if (it != m_pending.end())
+			it->second.rows++;
+		break;
+	}
+
+	case SQLITE_TRACE_PROFILE:
+		return finish(stmt, * static_cast<sqlite3_int64 *>(x));
+
+	default:
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <climits>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+#include "benthos/logbook/dbapi/row_view.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+row_view::row_view()
+	: m_stmt(0), m_values(0), m_ncols(0)
+{
+}
+
+row_view::row_view(sqlite3_stmt * stmt, int ncols)
+	: m_stmt(stmt), m_values(0), m_ncols(ncols)
+{
+}
+
+row_view::row_view(const std::vector<variant> & values)
+	: m_stmt(0), m_values(values.empty() ? 0 : & values[0]), m_ncols((int)values.size())
+{
+}
+
+blob_ref row_view::blob(int idx) const
+{
+	check_index(idx);
+	if (m_values)
+		return variant_reader<blob_ref>::read(m_values[idx]);
+	return column_reader<blob_ref>::read(m_stmt, idx);
+}
+
+void row_view::check_index(int idx) const
+{
+	if ((idx < 0) || (idx >= m_ncols))
+		throw std::out_of_range(std::string("Column ") + boost::lexical_cast<std::string>(idx) + " is out of range");
+}
+
+int row_view::column_count() const
+{
+	return m_ncols;
+}
+
+sqlite3_stmt * row_view::handle() const
+{
+	return m_stmt;
+}
+
+bool row_view::is_null(int idx) const
+{
+	return type(idx) == SQLITE_NULL;
+}
+
+text_ref row_view::text(int idx) const
+{
+	check_index(idx);
+	if (m_values)
+		return variant_reader<text_ref>::read(m_values[idx]);
+	return column_reader<text_ref>::read(m_stmt, idx);
+}
+
+int row_view::type(int idx) const
+{
+	check_index(idx);
+	if (! m_values)
+		return sqlite3_column_type(m_stmt, idx);
+
+	switch (m_values[idx].type())
+	{
+	case variant::int_type:
+	case variant::int64_type:
+		return SQLITE_INTEGER;
+
+	case variant::double_type:
+		return SQLITE_FLOAT;
+
+	case variant::text_type:
+		return SQLITE_TEXT;
+
+	case variant::blob_type:
+		return SQLITE_BLOB;
+
+	default:
+		return SQLITE_NULL;
+
+	}
+}
+
+variant row_view::value(int idx) const
+{
+	if (m_values)
+	{
+		check_index(idx);
+		return m_values[idx];
+	}
+
+	switch (type(idx))
+	{
+	case SQLITE_INTEGER:
+	{
+		int64_t i = sqlite3_column_int64(m_stmt, idx);
+		if ((i < INT_MIN) || (i > INT_MAX))
+			return variant(i);
+		return variant((int)i);
+	}
+
+	case SQLITE_FLOAT:
+		return variant(sqlite3_column_double(m_stmt, idx));
+
+	case SQLITE_TEXT:
+		return variant(column_reader<text_ref>::read(m_stmt, idx));
+
+	case SQLITE_BLOB:
+		return variant(column_reader<blob_ref>::read(m_stmt, idx));
+
+	case SQLITE_NULL:
+		return variant();
+
+	default:
+		throw std::runtime_error("Unknown SQLite column type");
+
+	}
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/dbapi/dbapi_error.hpp"
+#include "benthos/logbook/dbapi/snapshot.hpp"
+#include "benthos/logbook/dbapi/statement.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+namespace {
+
+//! Start a Read Transaction without marking the Connection's Transaction
+void begin_read(connection::ptr conn)
+{
+	if (! sqlite3_get_autocommit(conn->handle()))
+		throw dbapi_error("Cannot take a snapshot inside an open transaction");
+
+	if (sqlite3_exec(conn->handle(), "BEGIN", 0, 0, 0) != SQLITE_OK)
+		throw sql_error(conn);
+}
+
+//! End a Read Transaction started by begin_read()
+void end_read(connection::ptr conn)
+{
+	if (! sqlite3_get_autocommit(conn->handle()))
+		sqlite3_exec(conn->handle(), "ROLLBACK", 0, 0, 0);
+}
+
+}
+
+snapshot::snapshot(connection::ptr conn, const std::string & db)
+	: m_conn(conn), m_db(db)
+#ifdef HAVE_SQLITE3_SNAPSHOT
+	, m_snapshot(0)
+#endif
+{
+	begin_read(m_conn);
+
+	try
+	{
+		// The read transaction only starts once the database is read
+		m_conn->prepare("select count(*) from " + m_db + ".sqlite_master", false)->query_scalar<int>();
+
+#ifdef HAVE_SQLITE3_SNAPSHOT
+		int rc = sqlite3_snapshot_get(m_conn->handle(), m_db.c_str(), & m_snapshot);
+		if (rc != SQLITE_OK)
+			throw dbapi_error(sqlite3_errstr(rc));
+#endif
+	}
+	catch (...)
+	{
+		end_read(m_conn);
+		throw;
+	}
+}
+
+snapshot::~snapshot()
+{
+#ifdef HAVE_SQLITE3_SNAPSHOT
+	if (m_snapshot != 0)
+		sqlite3_snapshot_free(m_snapshot);
+	m_snapshot = 0;
+#endif
+
+	if (m_conn.unique())
+		end_read(m_conn);
+}
+
+connection::ptr snapshot::conn() const
+{
+	return m_conn;
+}
+
+void snapshot::open(connection::ptr conn) const
+{
+#ifdef HAVE_SQLITE3_SNAPSHOT
+	begin_read(conn);
+
+	int rc = sqlite3_snapshot_open(conn->handle(), m_db.c_str(), m_snapshot);
+	if (rc != SQLITE_OK)
+	{
+		end_read(conn);
+		throw dbapi_error(sqlite3_errstr(rc));
+	}
+#else
+	(void)conn;
+	throw dbapi_error("Sharing snapshots requires SQLite3 with SQLITE_ENABLE_SNAPSHOT");
+#endif
+}
+
+bool snapshot::supported()
+{
+#ifdef HAVE_SQLITE3_SNAPSHOT
+	return true;
+#else
+	return false;
+#endif
+}
@@ -48,14 +48,43 @@ enum
 };
 
 statement::statement(connection::ptr conn, const std::string & sql)
-	: m_conn(conn), m_stmt(0), m_sql(), m_tail(), m_type(TYPE_OTHER)
+	: m_conn(conn), m_stmt(0), m_cached(false), m_key(), m_sql(), m_tail(), m_type(TYPE_OTHER),
+	  m_skip_unused(false), m_pins()
 {
-	const char * _tail = 0;
-	if (sqlite3_prepare_v2(m_conn->handle(), sql.c_str(), sql.size(), & m_stmt, & _tail) != SQLITE_OK)
-		throw sql_error(conn);
+	init(sql);
+}
+
+statement::statement(connection::ptr conn, const std::string & sql, sqlite3_stmt * stmt)
+	: m_conn(conn), m_stmt(stmt), m_cached(true), m_key(sql), m_sql(), m_tail(), m_type(TYPE_OTHER),
+	  m_skip_unused(false), m_pins()
+{
+	init(sql);
+}
+
+statement::~statement()
+{
+	if (m_stmt && m_cached)
+		m_conn->stmt_cache().checkin(m_key, m_stmt);
+	else if (m_stmt)
+		sqlite3_finalize(m_stmt);
+}
+
+void statement::init(const std::string & sql)
+{
+	if (m_stmt != 0)
+	{
+		// Reuse the cached handle; the prepared text is a prefix of the SQL
+		m_tail.assign(sql, strlen(sqlite3_sql(m_stmt)), std::string::npos);
+	}
+	else
+	{
+		const char * _tail = 0;
+		if (sqlite3_prepare_v2(m_conn->handle(), sql.c_str(), sql.size(), & m_stmt, & _tail) != SQLITE_OK)
+			throw sql_error(m_conn);
 
-	if (_tail)
-		m_tail.assign(_tail);
+		if (_tail)
+			m_tail.assign(_tail);
+	}
 
 	m_sql.assign(sql.begin(), sql.end() - m_tail.size());
 
@@ -82,12 +111,6 @@ statement::statement(connection::ptr conn, const std::string & sql)
 		m_type = TYPE_REPLACE;
 }
 
-statement::~statement()
-{
-	if (m_stmt)
-		sqlite3_finalize(m_stmt);
-}
-
 void statement::bind(int idx, int value)
 {
 	bind<int>(idx, value);
@@ -110,7 +133,7 @@ void statement::bind(int idx, const std::string & value)
 
 void statement::bind(int idx, const char * value)
 {
-	bind<std::string>(idx, std::string(value));
+	bind<const char *>(idx, value);
 }
 
 void statement::bind(int idx, const std::vector<unsigned char> & value)
@@ -120,26 +143,110 @@ void statement::bind(int idx, const std::vector<unsigned char> & value)
 
 void statement::bind(int idx, const variant & value)
 {
-	if (value.is_null())
+	bind_value(idx, value, SQLITE_TRANSIENT);
+}
+
+void statement::bind(int idx, const boost::none_t &)
+{
+	bind(idx);
+}
+
+void statement::bind(int idx)
+{
+	if (m_skip_unused && ! is_used(idx))
+		return;
+
+	binder(m_stmt, idx)();
+}
+
+void statement::bind_shared(int idx, boost::shared_ptr<const std::string> value)
+{
+	if (! value)
 	{
 		bind(idx);
+		return;
 	}
-	else
+
+	bind_static(idx, * value);
+	pin(idx, value);
+}
+
+void statement::bind_shared(int idx, boost::shared_ptr<const std::vector<unsigned char> > value)
+{
+	if (! value)
 	{
-		int rc = boost::apply_visitor(binder(m_stmt, idx), value.value());
-		if (rc != SQLITE_OK)
-			throw bind_error(m_conn);
+		bind(idx);
+		return;
 	}
+
+	bind_static(idx, * value);
+	pin(idx, value);
 }
 
-void statement::bind(int idx, const boost::none_t &)
+void statement::bind_static(int idx, const text_ref & value)
 {
-	binder(m_stmt, idx)();
+	if (! check_index(idx))
+		return;
+	if (binder(m_stmt, idx, SQLITE_STATIC)(value) != SQLITE_OK)
+		throw bind_error(m_conn);
 }
 
-void statement::bind(int idx)
+void statement::bind_static(int idx, const blob_ref & value)
 {
-	binder(m_stmt, idx)();
+	if (! check_index(idx))
+		return;
+	if (binder(m_stmt, idx, SQLITE_STATIC)(value) != SQLITE_OK)
+		throw bind_error(m_conn);
+}
+
+void statement::bind_static(int idx, const std::string & value)
+{
+	if (! check_index(idx))
+		return;
+	if (binder(m_stmt, idx, SQLITE_STATIC)(value) != SQLITE_OK)
+		throw bind_error(m_conn);
+}
+
+void statement::bind_static(int idx, const std::vector<unsigned char> & value)
+{
+	if (! check_index(idx))
+		return;
+	if (binder(m_stmt, idx, SQLITE_STATIC)(value) != SQLITE_OK)
+		throw bind_error(m_conn);
+}
+
+void statement::bind_static(int idx, const boost::optional<std::string> & value)
+{
+	if (! value.is_initialized())
+		bind(idx);
+	else
+		bind_static(idx, value.get());
+}
+
+void statement::bind_value(int idx, const variant & value, sqlite3_destructor_type dtor)
+{
+	if (value.is_null())
+	{
+		bind(idx);
+		return;
+	}
+
+	if (! check_index(idx))
+		return;
+
+	int rc;
+	if (value.is_shared())
+	{
+		rc = value.apply_visitor(binder(m_stmt, idx, SQLITE_STATIC));
+		pin(idx, value.owner());
+	}
+	else
+	{
+		rc = value.apply_visitor(binder(m_stmt, idx, dtor));
+	}
+
+	if (rc != SQLITE_OK)
+		throw bind_error(m_conn);
 }
 
 void statement::bind(const std::string & name, int value)
@@ -187,10 +294,27 @@ void statement::bind(const std::string & name)
 	bind(find_index(name));
 }
 
-void statement::check_index(int index) const
+bool statement::check_index(int index) const
 {
+	if (m_skip_unused)
+		return is_used(index);
+
 	if ((index <= 0) || (index > m_nparams))
 		throw bind_error(std::string("Invalid Parameter Index: ") + boost::lexical_cast<std::string>(index));
+
+	return true;
+}
+
+bool statement::is_used(int index) const
+{
+	// Indices skipped by the SQL text are in range but have no name
+	return (index > 0) && (index <= m_nparams) && (sqlite3_bind_parameter_name(m_stmt, index) != 0);
+}
+
+void statement::clear_bindings()
+{
+	sqlite3_clear_bindings(m_stmt);
+	m_pins.clear();
 }
 
 cursor::ptr statement::exec()
@@ -198,6 +322,78 @@ cursor::ptr statement::exec()
 	return cursor::ptr(new cursor(this->shared_from_this(), ! step()));
 }
 
+size_t statement::execute()
+{
+	m_conn->check_thread();
+
+	int rc;
+	while ((rc = sqlite3_step(m_stmt)) == SQLITE_ROW)
+		;
+	m_conn->after_step(rc);
+
+	if (rc == SQLITE_INTERRUPT)
+	{
+		interrupted_error e(m_conn);
+		sqlite3_reset(m_stmt);
+		throw e;
+	}
+	if (rc != SQLITE_DONE)
+	{
+		sql_error e(m_conn);
+		sqlite3_reset(m_stmt);
+		throw e;
+	}
+
+	size_t n = sqlite3_changes(m_conn->handle());
+	sqlite3_reset(m_stmt);
+	return n;
+}
+
+size_t statement::executemany(const std::vector<params_t> & batch)
+{
+	size_t n = 0;
+	sqlite3_reset(m_stmt);
+
+	// The batch outlives the loop, so its values are bound in place
+	try
+	{
+		std::vector<params_t>::const_iterator it;
+		for (it = batch.begin(); it != batch.end(); it++)
+		{
+			sqlite3_clear_bindings(m_stmt);
+			for (size_t i = 0; i < it->size(); i++)
+				bind_value(i + 1, (* it)[i], SQLITE_STATIC);
+
+			n += execute();
+		}
+	}
+	catch (...)
+	{
+		clear_bindings();
+		throw;
+	}
+
+	clear_bindings();
+	return n;
+}
+
+size_t statement::executemany(param_generator gen)
+{
+	size_t n = 0;
+	sqlite3_reset(m_stmt);
+
+	for (;;)
+	{
+		sqlite3_clear_bindings(m_stmt);
+		if (! gen(* this))
+			break;
+
+		n += execute();
+	}
+
+	return n;
+}
+
 variant statement::exec_scalar()
 {
 	cursor::ptr c = exec();
@@ -206,6 +402,16 @@ variant statement::exec_scalar()
 	return r;
 }
 
+void statement::pin(int idx, boost::shared_ptr<const void> owner)
+{
+	if (m_skip_unused && ! is_used(idx))
+		return;
+
+	if (m_pins.size() <= (size_t)idx)
+		m_pins.resize(m_nparams + 1);
+	m_pins[idx] = owner;
+}
+
 int statement::find_index(const std::string & name)
 {
 	int idx = param_index(name);
@@ -219,6 +425,11 @@ sqlite3_stmt * statement::handle() const
 	return m_stmt;
 }
 
+int64_t statement::last_rowid() const
+{
+	return sqlite3_last_insert_rowid(m_conn->handle());
+}
+
 bool statement::is_delete() const
 {
 	return m_type == TYPE_DELETE;
@@ -275,6 +486,11 @@ void statement::reset()
 	sqlite3_reset(m_stmt);
 }
 
+void statement::skip_unused(bool skip)
+{
+	m_skip_unused = skip;
+}
+
 const std::string & statement::sql() const
 {
 	return m_sql;
@@ -282,12 +498,23 @@ const std::string & statement::sql() const
 
 bool statement::step()
 {
+	// Checked per step, so cursors and typed queries cannot race the owner
+	m_conn->check_thread();
+
 	int rc = sqlite3_step(m_stmt);
+	m_conn->after_step(rc);
 	if (rc == SQLITE_ROW)
 		return true;
 	if (rc == SQLITE_DONE)
 		return false;
 
+	if (rc == SQLITE_INTERRUPT)
+	{
+		interrupted_error e(m_conn);
+		sqlite3_reset(m_stmt);
+		throw e;
+	}
+
 	throw sql_error(m_conn);
 }
 
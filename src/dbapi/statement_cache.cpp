@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/dbapi/statement_cache.hpp"
+
+using namespace benthos::logbook::dbapi;
+
+statement_cache::statement_cache(size_t capacity)
+	: m_lru(), m_index(), m_capacity(capacity), m_hits(0), m_misses(0)
+{
+}
+
+statement_cache::~statement_cache()
+{
+	clear();
+}
+
+size_t statement_cache::capacity() const
+{
+	return m_capacity;
+}
+
+void statement_cache::checkin(const std::string & sql, sqlite3_stmt * stmt)
+{
+	if (stmt == 0)
+		return;
+
+	if ((m_capacity == 0) || (m_index.find(sql) != m_index.end()))
+	{
+		sqlite3_finalize(stmt);
+		return;
+	}
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	evict(m_capacity - 1);
+	m_lru.push_front(entry_t(sql, stmt));
+	m_index[sql] = m_lru.begin();
+}
+
+sqlite3_stmt * statement_cache::checkout(const std::string & sql)
+{
+	index_t::iterator it = m_index.find(sql);
+	if (it == m_index.end())
+	{
+		m_misses++;
+		return 0;
+	}
+
+	sqlite3_stmt * result = it->second->second;
+	m_lru.erase(it->second);
+	m_index.erase(it);
+
+	m_hits++;
+	return result;
+}
+
+void statement_cache::clear()
+{
+	evict(0);
+}
+
+void statement_cache::evict(size_t capacity)
+{
+	while (m_lru.size() > capacity)
+	{
+		sqlite3_finalize(m_lru.back().second);
+		m_index.erase(m_lru.back().first);
+		m_lru.pop_back();
+	}
+}
+
+size_t statement_cache::hits() const
+{
+	return m_hits;
+}
+
+size_t statement_cache::misses() const
+{
+	return m_misses;
+}
+
+void statement_cache::reset_stats()
+{
+	m_hits = 0;
+	m_misses = 0;
+}
+
+void statement_cache::set_capacity(size_t capacity)
+{
+	m_capacity = capacity;
+	evict(m_capacity);
+}
+
+size_t statement_cache::size() const
+{
+	return m_lru.size();
+}
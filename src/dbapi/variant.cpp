@@ -27,7 +27,8 @@
  * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
  * WITH THE SOFTWARE.
  */
-
+#include <cstring>
+#include <new>
 #include <stdexcept>
 
 #include "benthos/logbook/dbapi/variant.hpp"
@@ -35,40 +36,340 @@
 using namespace benthos::logbook::dbapi;
 
 variant::variant()
-	: m_value()
+	: m_type(null_type), m_storage(inline_storage)
 {
 }
 
 variant::variant(const variant & v)
-	: m_value(v.m_value)
+	: m_type(null_type), m_storage(inline_storage)
+{
+	copy_from(v);
+}
+
+variant::variant(variant && v)
+	: m_type(null_type), m_storage(inline_storage)
+{
+	move_from(v);
+}
+
+variant::variant(std::string && v)
+	: m_type(null_type), m_storage(inline_storage)
+{
+	if (v.size() <= small_capacity)
+	{
+		assign_data(text_type, (const unsigned char *)v.data(), v.size());
+	}
+	else
+	{
+		boost::shared_ptr<const std::string> s(new std::string(std::move(v)));
+		assign_large(text_type, (const unsigned char *)s->data(), s->size(), s);
+	}
+}
+
+variant::variant(std::vector<unsigned char> && v)
+	: m_type(null_type), m_storage(inline_storage)
 {
+	if (v.size() <= small_capacity)
+	{
+		assign_data(blob_type, v.empty() ? 0 : & v[0], v.size());
+	}
+	else
+	{
+		boost::shared_ptr<const std::vector<unsigned char> > b(new std::vector<unsigned char>(std::move(v)));
+		assign_large(blob_type, & (* b)[0], b->size(), b);
+	}
 }
 
 variant::~variant()
 {
+	clear();
 }
 
 variant & variant::operator= (const variant & v)
 {
-	m_value = v.m_value;
+	if (this != & v)
+	{
+		clear();
+		copy_from(v);
+	}
+
+	return * this;
+}
+
+variant & variant::operator= (variant && v)
+{
+	if (this != & v)
+	{
+		clear();
+		move_from(v);
+	}
+
 	return * this;
 }
 
+variant variant::borrowed(const text_ref & t)
+{
+	variant v;
+	v.assign_large(text_type, (const unsigned char *)t.data, t.size, boost::shared_ptr<const void>());
+	return v;
+}
+
+variant variant::borrowed(const blob_ref & b)
+{
+	variant v;
+	v.assign_large(blob_type, b.data, b.size, boost::shared_ptr<const void>());
+	return v;
+}
+
+variant variant::shared(boost::shared_ptr<const std::string> s)
+{
+	variant v;
+	if (s)
+		v.assign_large(text_type, (const unsigned char *)s->data(), s->size(), s);
+	return v;
+}
+
+variant variant::shared(boost::shared_ptr<const std::vector<unsigned char> > b)
+{
+	variant v;
+	if (b)
+		v.assign_large(blob_type, b->empty() ? 0 : & (* b)[0], b->size(), b);
+	return v;
+}
+
+void variant::assign(bool v)
+{
+	m_int = v ? 1 : 0;
+	m_type = int_type;
+}
+
+void variant::assign(short v)
+{
+	m_int = v;
+	m_type = int_type;
+}
+
+void variant::assign(unsigned short v)
+{
+	m_int = v;
+	m_type = int_type;
+}
+
+void variant::assign(int v)
+{
+	m_int = v;
+	m_type = int_type;
+}
+
+void variant::assign(unsigned int v)
+{
+	m_int64 = v;
+	m_type = int64_type;
+}
+
+void variant::assign(long v)
+{
+	m_int64 = v;
+	m_type = int64_type;
+}
+
+void variant::assign(unsigned long v)
+{
+	m_int64 = (int64_t)v;
+	m_type = int64_type;
+}
+
+void variant::assign(long long v)
+{
+	m_int64 = v;
+	m_type = int64_type;
+}
+
+void variant::assign(unsigned long long v)
+{
+	m_int64 = (int64_t)v;
+	m_type = int64_type;
+}
+
+void variant::assign(float v)
+{
+	m_double = v;
+	m_type = double_type;
+}
+
+void variant::assign(double v)
+{
+	m_double = v;
+	m_type = double_type;
+}
+
+void variant::assign(const char * v)
+{
+	assign_data(text_type, (const unsigned char *)v, v ? strlen(v) : 0);
+}
+
+void variant::assign(const std::string & v)
+{
+	assign_data(text_type, (const unsigned char *)v.data(), v.size());
+}
+
+void variant::assign(const std::vector<unsigned char> & v)
+{
+	assign_data(blob_type, v.empty() ? 0 : & v[0], v.size());
+}
+
+void variant::assign(const text_ref & v)
+{
+	assign_data(text_type, (const unsigned char *)v.data, v.size);
+}
+
+void variant::assign(const blob_ref & v)
+{
+	assign_data(blob_type, v.data, v.size);
+}
+
+void variant::assign_data(type_t t, const unsigned char * data, size_t size)
+{
+	if (size <= small_capacity)
+	{
+		if (size > 0)
+			memcpy(m_small.data, data, size);
+		m_small.size = (unsigned char)size;
+		m_storage = inline_storage;
+		m_type = t;
+	}
+	else if (t == text_type)
+	{
+		boost::shared_ptr<const std::string> s(new std::string((const char *)data, size));
+		assign_large(t, (const unsigned char *)s->data(), s->size(), s);
+	}
+	else
+	{
+		boost::shared_ptr<const std::vector<unsigned char> > b(new std::vector<unsigned char>(data, data + size));
+		assign_large(t, & (* b)[0], b->size(), b);
+	}
+}
+
+void variant::assign_large(type_t t, const unsigned char * data, size_t size,
+	boost::shared_ptr<const void> owner)
+{
+	new (& m_large) large_t();
+	m_large.data = data;
+	m_large.size = size;
+	m_large.owner.swap(owner);
+	m_storage = m_large.owner ? shared_storage : borrowed_storage;
+	m_type = t;
+}
+
+blob_ref variant::blob() const
+{
+	if (m_type != blob_type)
+		throw boost::bad_get();
+	return blob_ref(data_ptr(), data_size());
+}
+
 void variant::clear()
 {
-	m_value = boost::none;
+	if (((m_type == text_type) || (m_type == blob_type)) && (m_storage != inline_storage))
+		m_large.~large_t();
+
+	m_type = null_type;
+	m_storage = inline_storage;
+}
+
+void variant::copy_from(const variant & v)
+{
+	switch (v.m_type)
+	{
+	case int_type:
+		m_int = v.m_int;
+		break;
+
+	case int64_type:
+		m_int64 = v.m_int64;
+		break;
+
+	case double_type:
+		m_double = v.m_double;
+		break;
+
+	case text_type:
+	case blob_type:
+		if (v.m_storage == inline_storage)
+			m_small = v.m_small;
+		else
+			new (& m_large) large_t(v.m_large);
+		break;
+
+	default:
+		break;
+	}
+
+	m_type = v.m_type;
+	m_storage = v.m_storage;
+}
+
+const unsigned char * variant::data_ptr() const
+{
+	return (m_storage == inline_storage) ? m_small.data : m_large.data;
+}
+
+size_t variant::data_size() const
+{
+	return (m_storage == inline_storage) ? m_small.size : m_large.size;
+}
+
+bool variant::is_borrowed() const
+{
+	return ((m_type == text_type) || (m_type == blob_type)) && (m_storage == borrowed_storage);
 }
 
 bool variant::is_null() const
 {
-	return ! m_value.is_initialized();
+	return m_type == null_type;
+}
+
+bool variant::is_shared() const
+{
+	return ((m_type == text_type) || (m_type == blob_type)) && (m_storage == shared_storage);
+}
+
+void variant::move_from(variant & v)
+{
+	if (((v.m_type == text_type) || (v.m_type == blob_type)) && (v.m_storage != inline_storage))
+	{
+		new (& m_large) large_t();
+		m_large.data = v.m_large.data;
+		m_large.size = v.m_large.size;
+		m_large.owner.swap(v.m_large.owner);
+		m_type = v.m_type;
+		m_storage = v.m_storage;
+	}
+	else
+	{
+		copy_from(v);
+	}
+
+	v.clear();
+}
+
+boost::shared_ptr<const void> variant::owner() const
+{
+	if (! is_shared())
+		return boost::shared_ptr<const void>();
+	return m_large.owner;
+}
+
+text_ref variant::text() const
+{
+	if (m_type != text_type)
+		throw boost::bad_get();
+	return text_ref((const char *)data_ptr(), data_size());
 }
 
-const sqlite_value & variant::value() const
+variant::type_t variant::type() const
 {
-	if (! m_value.is_initialized())
-		throw std::runtime_error("Value is null");
-	return m_value.get();
+	return (type_t)m_type;
 }
 
 struct printer: boost::static_visitor<std::ostream &>
@@ -98,15 +399,15 @@ struct printer: boost::static_visitor<std::ostream &>
 		return os;
 	}
 
-	std::ostream & operator() (const std::string & s) const
+	std::ostream & operator() (const text_ref & s) const
 	{
-		os << s;
+		os.write(s.data, s.size);
 		return os;
 	}
 
-	std::ostream & operator() (const std::vector<unsigned char> & v) const
+	std::ostream & operator() (const blob_ref & v) const
 	{
-		os << "BLOB(len: " << v.size() << ")";
+		os << "BLOB(len: " << v.size << ")";
 		return os;
 	}
 };
@@ -120,9 +421,8 @@ std::ostream & benthos::logbook::dbapi::operator<< (std::ostream & out, const va
 	}
 	else
 	{
-		sqlite_value val(v.value());
 		out << "variant(";
-		boost::apply_visitor(printer(out), val);
+		v.apply_visitor(printer(out));
 		return (out << ")");
 	}
 }
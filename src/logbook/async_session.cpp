@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "benthos/logbook/async_session.hpp"
+
+using namespace benthos::logbook;
+
+AsyncDiveFinder::AsyncDiveFinder(IDiveFinder::Ptr finder, dbapi::executor::ptr ex)
+	: AsyncFinder<Dive, IDiveFinder>(finder, ex)
+{
+}
+
+AsyncDiveFinder::~AsyncDiveFinder()
+{
+}
+
+std::future<std::vector<std::string> > AsyncDiveFinder::allTags()
+{
+	return m_executor->submit<std::vector<std::string> >(boost::bind(& IDiveFinder::allTags, m_finder));
+}
+
+std::future<unsigned int> AsyncDiveFinder::countByComputer(int64_t computer_id)
+{
+	return m_executor->submit<unsigned int>(boost::bind(& IDiveFinder::countByComputer, m_finder, computer_id));
+}
+
+std::future<unsigned int> AsyncDiveFinder::countBySite(int64_t site_id)
+{
+	return m_executor->submit<unsigned int>(boost::bind(& IDiveFinder::countBySite, m_finder, site_id));
+}
+
+std::future<std::vector<Dive::Ptr> > AsyncDiveFinder::findRecentlyImported(unsigned int days, int max, const dbapi::cancellation_token & token)
+{
+	typedef std::vector<Dive::Ptr> (IDiveFinder::* fn_t)(unsigned int, int, const dbapi::cancellation_token &);
+	return m_executor->submit<std::vector<Dive::Ptr> >(boost::bind(& AsyncDiveFinder::resolved,
+		boost::bind(static_cast<fn_t>(& IDiveFinder::findRecentlyImported), m_finder, days, max, token)));
+}
+
+std::future<std::vector<Dive::Ptr> > AsyncDiveFinder::findByComputer(int64_t computer_id)
+{
+	return m_executor->submit<std::vector<Dive::Ptr> >(boost::bind(& AsyncDiveFinder::resolved,
+		boost::bind(& IDiveFinder::findByComputer, m_finder, computer_id)));
+}
+
+std::future<std::vector<Dive::Ptr> > AsyncDiveFinder::findByCountry(const country & country_, const dbapi::cancellation_token & token)
+{
+	typedef std::vector<Dive::Ptr> (IDiveFinder::* fn_t)(const country &, const dbapi::cancellation_token &);
+	return m_executor->submit<std::vector<Dive::Ptr> >(boost::bind(& AsyncDiveFinder::resolved,
+		boost::bind(static_cast<fn_t>(& IDiveFinder::findByCountry), m_finder, country_, token)));
+}
+
+std::future<std::vector<Dive::Ptr> > AsyncDiveFinder::findByDates(time_t start, time_t end, const dbapi::cancellation_token & token)
+{
+	typedef std::vector<Dive::Ptr> (IDiveFinder::* fn_t)(time_t, time_t, const dbapi::cancellation_token &);
+	return m_executor->submit<std::vector<Dive::Ptr> >(boost::bind(& AsyncDiveFinder::resolved,
+		boost::bind(static_cast<fn_t>(& IDiveFinder::findByDates), m_finder, start, end, token)));
+}
+
+std::future<std::vector<Dive::Ptr> > AsyncDiveFinder::findBySite(int64_t site_id)
+{
+	return m_executor->submit<std::vector<Dive::Ptr> >(boost::bind(& AsyncDiveFinder::resolved,
+		boost::bind(& IDiveFinder::findBySite, m_finder, site_id)));
+}
+
+std::future<boost::optional<double> > AsyncDiveFinder::avgDepthForSite(int64_t site_id)
+{
+	return m_executor->submit<boost::optional<double> >(boost::bind(& IDiveFinder::avgDepthForSite, m_finder, site_id));
+}
+
+std::future<boost::optional<double> > AsyncDiveFinder::avgTempForSite(int64_t site_id)
+{
+	return m_executor->submit<boost::optional<double> >(boost::bind(& IDiveFinder::avgTempForSite, m_finder, site_id));
+}
+
+std::future<boost::optional<double> > AsyncDiveFinder::maxDepthForSite(int64_t site_id)
+{
+	return m_executor->submit<boost::optional<double> >(boost::bind(& IDiveFinder::maxDepthForSite, m_finder, site_id));
+}
+
+std::future<boost::optional<double> > AsyncDiveFinder::ratingForSite(int64_t site_id)
+{
+	return m_executor->submit<boost::optional<double> >(boost::bind(& IDiveFinder::ratingForSite, m_finder, site_id));
+}
+
+AsyncDiveSiteFinder::AsyncDiveSiteFinder(IDiveSiteFinder::Ptr finder, dbapi::executor::ptr ex)
+	: AsyncFinder<DiveSite, IDiveSiteFinder>(finder, ex)
+{
+}
+
+AsyncDiveSiteFinder::~AsyncDiveSiteFinder()
+{
+}
+
+std::future<std::vector<country> > AsyncDiveSiteFinder::countries()
+{
+	return m_executor->submit<std::vector<country> >(boost::bind(& IDiveSiteFinder::countries, m_finder));
+}
+
+std::future<std::vector<std::string> > AsyncDiveSiteFinder::bottomValues()
+{
+	return m_executor->submit<std::vector<std::string> >(boost::bind(& IDiveSiteFinder::bottomValues, m_finder));
+}
+
+std::future<std::vector<std::string> > AsyncDiveSiteFinder::platformValues()
+{
+	return m_executor->submit<std::vector<std::string> >(boost::bind(& IDiveSiteFinder::platformValues, m_finder));
+}
+
+std::future<std::vector<std::string> > AsyncDiveSiteFinder::waterBodyValues()
+{
+	return m_executor->submit<std::vector<std::string> >(boost::bind(& IDiveSiteFinder::waterBodyValues, m_finder));
+}
+
+AsyncSession::AsyncSession(Session::Ptr session)
+	: m_session(session), m_executor(new dbapi::executor(session->conn()))
+{
+}
+
+AsyncSession::~AsyncSession()
+{
+	// Finish outstanding work before the Session is released
+	m_executor->shutdown();
+}
+
+AsyncDiveFinder::Ptr AsyncSession::diveFinder() const
+{
+	IDiveFinder::Ptr f = boost::dynamic_pointer_cast<IDiveFinder>(m_session->finder<Dive>());
+	return AsyncDiveFinder::Ptr(new AsyncDiveFinder(f, m_executor));
+}
+
+AsyncDiveSiteFinder::Ptr AsyncSession::diveSiteFinder() const
+{
+	IDiveSiteFinder::Ptr f = boost::dynamic_pointer_cast<IDiveSiteFinder>(m_session->finder<DiveSite>());
+	return AsyncDiveSiteFinder::Ptr(new AsyncDiveSiteFinder(f, m_executor));
+}
@@ -146,7 +146,7 @@ void Dive::Tags::assign(Dive::Tags::ConstPtr tags)
 	else
 		m_items.clear();
 
-	if (m_dive) m_dive->mark_dirty();
+	changed();
 }
 
 void Dive::Tags::add(const std::string & tag)
@@ -155,19 +155,28 @@ void Dive::Tags::add(const std::string & tag)
 	std::transform(ltag.begin(), ltag.end(), ltag.begin(), tolower);
 
 	m_items.insert(tag);
-	if (m_dive) m_dive->mark_dirty();
+	changed();
+}
+
+void Dive::Tags::changed()
+{
+	if (! m_dive)
+		return;
+
+	m_dive->mark_dirty();
+	m_dive->events().attr_set(m_dive, "tags", boost::any());
 }
 
 void Dive::Tags::clear()
 {
 	m_items.clear();
-	if (m_dive) m_dive->mark_dirty();
+	changed();
 }
 
 void Dive::Tags::remove(const std::string & tag)
 {
 	m_items.erase(tag);
-	if (m_dive) m_dive->mark_dirty();
+	changed();
 }
 
 Dive::Dive()
@@ -184,9 +193,9 @@ void Dive::attached(Session::Ptr s)
 {
 	Persistent::attached(s);
 
-	m_evtComputerDel = s->mapper<DiveComputer>()->events().before_delete.connect(boost::bind(& Dive::evtDiveComputerDeleted, this, _1, _2));
-	m_evtMixDel = s->mapper<Mix>()->events().before_delete.connect(boost::bind(& Dive::evtMixDeleted, this, _1, _2));
-	m_evtSiteDel = s->mapper<DiveSite>()->events().before_delete.connect(boost::bind(& Dive::evtDiveSiteDeleted, this, _1, _2));
+	m_evtComputerDel = s->mapper<DiveComputer>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& Dive::evtDiveComputerDeleted, this, _1, _2)));
+	m_evtMixDel = s->mapper<Mix>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& Dive::evtMixDeleted, this, _1, _2)));
+	m_evtSiteDel = s->mapper<DiveSite>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& Dive::evtDiveSiteDeleted, this, _1, _2)));
 }
 
 void Dive::detached(Session::Ptr s)
@@ -201,21 +210,21 @@ void Dive::detached(Session::Ptr s)
 void Dive::evtDiveComputerDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 {
 	DiveComputer::Ptr o = boost::dynamic_pointer_cast<DiveComputer>(obj);
-	if (o && (o == m_computer))
+	if (o && m_computer.refers_to(o))
 		setComputer(boost::none);
 }
 
 void Dive::evtMixDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 {
 	Mix::Ptr o = boost::dynamic_pointer_cast<Mix>(obj);
-	if (o && (o == m_mix))
+	if (o && m_mix.refers_to(o))
 		setMix(boost::none);
 }
 
 void Dive::evtDiveSiteDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 {
 	DiveSite::Ptr o = boost::dynamic_pointer_cast<DiveSite>(obj);
-	if (o && (o == m_site))
+	if (o && m_site.refers_to(o))
 		setSite(boost::none);
 }
 
@@ -241,7 +250,7 @@ const boost::optional<std::string> & Dive::comments() const
 
 DiveComputer::Ptr Dive::computer() const
 {
-	return m_computer;
+	return m_computer.get();
 }
 
 const boost::optional<time_t> & Dive::datetime() const
@@ -291,7 +300,7 @@ const boost::optional<double> & Dive::min_temp() const
 
 Mix::Ptr Dive::mix() const
 {
-	return m_mix;
+	return m_mix.get();
 }
 
 const boost::optional<int> & Dive::nofly_time() const
@@ -308,8 +317,9 @@ IObjectCollection<Profile>::Ptr Dive::profiles()
 {
 	if (! m_profiles)
 	{
-		m_profiles = IObjectCollection<Profile>::Ptr(new DiveProfiles(boost::dynamic_pointer_cast<Dive>(shared_from_this())));
-		m_profiles->load();
+		IObjectCollection<Profile>::Ptr c(new DiveProfiles(boost::dynamic_pointer_cast<Dive>(shared_from_this())));
+		c->load();
+		m_profiles = c;
 	}
 	return m_profiles;
 }
@@ -324,6 +334,30 @@ const boost::optional<int> & Dive::rating() const
 	return m_rating;
 }
 
+LazyReference * Dive::reference(const std::string & name)
+{
+	if (name == "computer")
+		return & m_computer;
+	if (name == "mix")
+		return & m_mix;
+	if (name == "site")
+		return & m_site;
+	if (name == "tank")
+		return & m_tank;
+
+	return Persistent::reference(name);
+}
+
+std::vector<std::string> Dive::reference_names() const
+{
+	std::vector<std::string> names;
+	names.push_back("computer");
+	names.push_back("mix");
+	names.push_back("site");
+	names.push_back("tank");
+	return names;
+}
+
 int Dive::repetition() const
 {
 	return m_repetition;
@@ -346,7 +380,7 @@ bool Dive::safety_stop() const
 
 DiveSite::Ptr Dive::site() const
 {
-	return m_site;
+	return m_site.get();
 }
 
 const boost::optional<double> & Dive::start_pressure() const
@@ -389,15 +423,16 @@ Dive::Tags::ConstPtr Dive::tags() const
 
 Tank::Ptr Dive::tank() const
 {
-	return m_tank;
+	return m_tank.get();
 }
 
 IObjectCollection<DiveTank>::Ptr Dive::tanks()
 {
 	if (! m_tanks)
 	{
-		m_tanks = IObjectCollection<DiveTank>::Ptr(new DiveTanks(boost::dynamic_pointer_cast<Dive>(shared_from_this())));
-		m_tanks->load();
+		IObjectCollection<DiveTank>::Ptr c(new DiveTanks(boost::dynamic_pointer_cast<Dive>(shared_from_this())));
+		c->load();
+		m_tanks = c;
 	}
 	return m_tanks;
 }
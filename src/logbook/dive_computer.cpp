@@ -135,8 +135,9 @@ IObjectCollection<Dive>::Ptr DiveComputer::dives()
 {
 	if (! m_dives)
 	{
-		m_dives = IObjectCollection<Dive>::Ptr(new DiveComputerDives(boost::dynamic_pointer_cast<DiveComputer>(shared_from_this())));
-		m_dives->load();
+		IObjectCollection<Dive>::Ptr c(new DiveComputerDives(boost::dynamic_pointer_cast<DiveComputer>(shared_from_this())));
+		c->load();
+		m_dives = c;
 	}
 	return m_dives;
 }
@@ -150,8 +151,9 @@ IObjectCollection<Profile>::Ptr DiveComputer::profiles()
 {
 	if (! m_profiles)
 	{
-		m_profiles = IObjectCollection<Profile>::Ptr(new DiveComputerProfiles(boost::dynamic_pointer_cast<DiveComputer>(shared_from_this())));
-		m_profiles->load();
+		IObjectCollection<Profile>::Ptr c(new DiveComputerProfiles(boost::dynamic_pointer_cast<DiveComputer>(shared_from_this())));
+		c->load();
+		m_profiles = c;
 	}
 	return m_profiles;
 }
@@ -141,8 +141,9 @@ IObjectCollection<Dive>::Ptr DiveSite::dives()
 {
 	if (! m_dives)
 	{
-		m_dives = IObjectCollection<Dive>::Ptr(new DiveSiteDives(boost::dynamic_pointer_cast<DiveSite>(shared_from_this())));
-		m_dives->load();
+		IObjectCollection<Dive>::Ptr c(new DiveSiteDives(boost::dynamic_pointer_cast<DiveSite>(shared_from_this())));
+		c->load();
+		m_dives = c;
 	}
 
 	return m_dives;
@@ -48,8 +48,8 @@ void DiveTank::attached(Session::Ptr s)
 {
 	Persistent::attached(s);
 
-	m_evtMixDel = s->mapper<Mix>()->events().before_delete.connect(boost::bind(& DiveTank::evtMixDeleted, this, _1, _2));
-	m_evtTankDel = s->mapper<Tank>()->events().before_delete.connect(boost::bind(& DiveTank::evtTankDeleted, this, _1, _2));
+	m_evtMixDel = s->mapper<Mix>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& DiveTank::evtMixDeleted, this, _1, _2)));
+	m_evtTankDel = s->mapper<Tank>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& DiveTank::evtTankDeleted, this, _1, _2)));
 }
 
 void DiveTank::detached(Session::Ptr s)
@@ -63,20 +63,20 @@ void DiveTank::detached(Session::Ptr s)
 void DiveTank::evtMixDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 {
 	Mix::Ptr o = boost::dynamic_pointer_cast<Mix>(obj);
-	if (o && (o == m_mix))
+	if (o && m_mix.refers_to(o))
 		setMix(boost::none);
 }
 
 void DiveTank::evtTankDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 {
 	Tank::Ptr o = boost::dynamic_pointer_cast<Tank>(obj);
-	if (o && (o == m_tank))
+	if (o && m_tank.refers_to(o))
 		setTank(boost::none);
 }
 
 Dive::Ptr DiveTank::dive() const
 {
-	return m_dive;
+	return m_dive.get();
 }
 
 const boost::optional<double> & DiveTank::end_pressure() const
@@ -91,7 +91,28 @@ int DiveTank::index() const
 
 Mix::Ptr DiveTank::mix() const
 {
-	return m_mix;
+	return m_mix.get();
+}
+
+LazyReference * DiveTank::reference(const std::string & name)
+{
+	if (name == "dive")
+		return & m_dive;
+	if (name == "mix")
+		return & m_mix;
+	if (name == "tank")
+		return & m_tank;
+
+	return Persistent::reference(name);
+}
+
+std::vector<std::string> DiveTank::reference_names() const
+{
+	std::vector<std::string> names;
+	names.push_back("dive");
+	names.push_back("mix");
+	names.push_back("tank");
+	return names;
 }
 
 const boost::optional<double> & DiveTank::start_pressure() const
@@ -101,7 +122,7 @@ const boost::optional<double> & DiveTank::start_pressure() const
 
 Tank::Ptr DiveTank::tank() const
 {
-	return m_tank;
+	return m_tank.get();
 }
 
 void DiveTank::setEndPressure(const boost::none_t &)
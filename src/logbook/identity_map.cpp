@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdexcept>
+#include <vector>
+
+#include "benthos/logbook/identity_map.hpp"
+
+using namespace benthos::logbook;
+
+const size_t IdentityMap::default_reclaim_step;
+
+IdentityMap::IdentityMap()
+	: m_map(), m_cursor(0), m_reclaimed(0)
+{
+}
+
+IdentityMap::~IdentityMap()
+{
+}
+
+void IdentityMap::clear()
+{
+	m_map.clear();
+	m_cursor = 0;
+}
+
+void IdentityMap::erase(uint32_t type_id, int64_t id)
+{
+	key_type k = { type_id, id };
+	m_map.erase(k);
+}
+
+void IdentityMap::erase(Persistent::Ptr p)
+{
+	if (! p)
+		return;
+
+	key_type k = { p->type_id(), p->id() };
+	map_type::iterator it = m_map.find(k);
+	if (it == m_map.end())
+		return;
+
+	Persistent::Ptr e = it->second.lock();
+	if (! e || (e == p))
+		m_map.erase(it);
+}
+
+Persistent::Ptr IdentityMap::find(uint32_t type_id, int64_t id)
+{
+	key_type k = { type_id, id };
+	map_type::iterator it = m_map.find(k);
+	if (it == m_map.end())
+		return Persistent::Ptr();
+
+	Persistent::Ptr p = it->second.lock();
+	if (! p)
+	{
+		m_map.erase(it);
+		m_reclaimed++;
+	}
+
+	return p;
+}
+
+void IdentityMap::insert(Persistent::Ptr p)
+{
+	if (! p || (p->id() == -1))
+		throw std::runtime_error("Cannot add an object without an identifier to the identity map");
+
+	key_type k = { p->type_id(), p->id() };
+	m_map[k] = Persistent::WeakPtr(p);
+
+	reclaim(default_reclaim_step);
+}
+
+size_t IdentityMap::purge()
+{
+	size_t n = 0;
+	map_type::iterator it;
+	for (it = m_map.begin(); it != m_map.end(); )
+	{
+		if (it->second.expired())
+		{
+			it = m_map.erase(it);
+			n++;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	m_reclaimed += n;
+	return n;
+}
+
+size_t IdentityMap::reclaim(size_t nbuckets)
+{
+	size_t nb = m_map.bucket_count();
+	if (m_map.empty() || (nb == 0))
+		return 0;
+
+	// Collect keys first; erasing invalidates the bucket iterators
+	std::vector<key_type> expired;
+	for (size_t i = 0; i < nbuckets; i++)
+	{
+		if (m_cursor >= nb)
+			m_cursor = 0;
+
+		map_type::local_iterator it;
+		for (it = m_map.begin(m_cursor); it != m_map.end(m_cursor); ++it)
+			if (it->second.expired())
+				expired.push_back(it->first);
+
+		m_cursor++;
+	}
+
+	std::vector<key_type>::const_iterator it;
+	for (it = expired.begin(); it != expired.end(); it++)
+		m_map.erase(* it);
+
+	m_reclaimed += expired.size();
+	return expired.size();
+}
+
+uint64_t IdentityMap::reclaimed() const
+{
+	return m_reclaimed;
+}
+
+size_t IdentityMap::size() const
+{
+	return m_map.size();
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdexcept>
+
+#include "benthos/logbook/lazy_reference.hpp"
+#include "benthos/logbook/session.hpp"
+
+using namespace benthos::logbook;
+
+LazyReference::LazyReference(const std::type_info & type, uint32_t type_id)
+	: m_type(& type), m_type_id(type_id), m_id(-1), m_obj(), m_session()
+{
+}
+
+LazyReference::~LazyReference()
+{
+}
+
+void LazyReference::assign(Persistent::Ptr p)
+{
+	m_obj = p;
+	m_id = -1;
+	m_session.reset();
+}
+
+void LazyReference::defer(SessionPtr s, int64_t id)
+{
+	if (! s)
+		throw std::runtime_error("A Session is required to defer a reference");
+
+	m_obj = s->find_loaded(m_type_id, id);
+	m_id = m_obj ? -1 : id;
+	m_session = m_obj ? SessionPtr() : s;
+}
+
+boost::optional<int64_t> LazyReference::id() const
+{
+	if (m_obj)
+		return m_obj->id();
+	if (m_id != -1)
+		return m_id;
+	return boost::none;
+}
+
+bool LazyReference::is_loaded() const
+{
+	return m_obj || (m_id == -1);
+}
+
+bool LazyReference::is_null() const
+{
+	return ! m_obj && (m_id == -1);
+}
+
+Persistent::Ptr LazyReference::loaded() const
+{
+	return m_obj;
+}
+
+Persistent::Ptr LazyReference::load() const
+{
+	if (m_obj || (m_id == -1))
+		return m_obj;
+
+	SessionPtr s = m_session.lock();
+	if (! s)
+		throw std::runtime_error("Cannot load the referenced object; the Session has expired");
+
+	m_obj = s->get(* m_type, m_type_id, m_id);
+	if (m_obj)
+		m_session.reset();
+
+	return m_obj;
+}
+
+bool LazyReference::refers_to(Persistent::Ptr p) const
+{
+	if (! p)
+		return false;
+	if (m_obj)
+		return m_obj == p;
+
+	return (m_id != -1) && (p->type_id() == m_type_id) && (p->id() == m_id);
+}
+
+void LazyReference::reset()
+{
+	assign(Persistent::Ptr());
+}
+
+void LazyReference::resolve(Persistent::Ptr p)
+{
+	if (! refers_to(p))
+		throw std::runtime_error("Object does not match the deferred reference");
+
+	m_obj = p;
+	m_session.reset();
+}
+
+const std::type_info & LazyReference::type() const
+{
+	return * m_type;
+}
+
+uint32_t LazyReference::type_id() const
+{
+	return m_type_id;
+}
@@ -32,8 +32,11 @@
 
 using namespace benthos::logbook;
 
-Logbook::Logbook(const std::string & filename, dbapi::connection::ptr conn)
-	: m_filename(filename), m_conn(conn), m_session(Session::Create(conn))
+Logbook::Logbook(const std::string & filename, dbapi::connection::ptr conn,
+	const dbapi::connection_options & options)
+	: m_filename(filename), m_conn(conn),
+	  m_pool(new dbapi::connection_pool(filename, conn, dbapi::connection_pool::default_max_idle, options)),
+	  m_session(Session::Create(conn)), m_refcache()
 {
 }
 
@@ -41,9 +44,14 @@ Logbook::~Logbook()
 {
 }
 
-Logbook::Ptr Logbook::Create(const std::string & filename, const std::string & creator, int version)
+Logbook::Ptr Logbook::Create(const std::string & filename, const std::string & creator, int version,
+	const dbapi::connection_options & options)
 {
-	dbapi::connection::ptr db(new dbapi::connection(filename.c_str()));
+	if (options.read_only)
+		throw std::runtime_error("Cannot create a Logbook with read-only connection options");
+
+	dbapi::connection::ptr db(new dbapi::connection(filename.c_str(), options.open_flags()));
+	options.apply(db);
 
 	// Create Database Schema
 	//TODO: Make Schema a singleton
@@ -52,14 +60,14 @@ Logbook::Ptr Logbook::Create(const std::string & filename, const std::string & c
 	// Update Creator Information
 	if (! creator.empty() && (version > 0))
 	{
-		dbapi::statement::ptr update_version(new dbapi::statement(db, "update version set program=?1, version=?2"));
+		dbapi::statement::ptr update_version = db->prepare("update version set program=?1, version=?2");
 		update_version->bind(1, creator);
 		update_version->bind(2, version);
 		update_version->exec();
 	}
 
 	// Create the Logbook
-	Logbook::Ptr lb(new Logbook(filename, db));
+	Logbook::Ptr lb(new Logbook(filename, db, options));
 
 	// Add Standard Mixes: Air, EANx32 and EANx36
 	Mix::Ptr mAir(new Mix);
@@ -83,12 +91,87 @@ Logbook::Ptr Logbook::Create(const std::string & filename, const std::string & c
 	return lb;
 }
 
-Logbook::Ptr Logbook::Open(const std::string & filename)
+Logbook::Ptr Logbook::Open(const std::string & filename, const dbapi::connection_options & options)
 {
-	dbapi::connection::ptr db(new dbapi::connection(filename.c_str()));
+	dbapi::connection::ptr db(new dbapi::connection(filename.c_str(), options.open_flags()));
+	options.apply(db);
 
 	//TODO: Add Schema Version Check
-	return Logbook::Ptr(new Logbook(filename, db));
+	return Logbook::Ptr(new Logbook(filename, db, options));
+}
+
+AsyncSession::Ptr Logbook::asyncSession() const
+{
+	return AsyncSession::Ptr(new AsyncSession(readSession()));
+}
+
+bool Logbook::backup(const std::string & filename, dbapi::backup::progress_handler h,
+	int pages, int sleep_ms) const
+{
+	dbapi::connection::ptr dest(new dbapi::connection(filename.c_str()));
+	dbapi::backup b(dest, backupSource());
+	return b.run(pages, sleep_ms, h);
+}
+
+dbapi::connection::ptr Logbook::backupSource() const
+{
+	if (m_pool->has_readers())
+		return m_pool->acquire_reader();
+	return m_conn;
+}
+
+Session::Ptr Logbook::readSession() const
+{
+	Session::Ptr s = Session::Create(m_pool->acquire_reader());
+	s->set_reference_cache(m_refcache);
+	return s;
+}
+
+dbapi::connection::ptr Logbook::replica() const
+{
+	dbapi::connection::ptr db(new dbapi::connection());
+	{
+		dbapi::backup b(db, backupSource());
+		b.run(-1, 0);
+	}
+
+	db->exec_sql("pragma query_only=1", false);
+	return db;
+}
+
+void Logbook::setReferenceCache(ReferenceCache::Ptr cache)
+{
+	if (m_refcache)
+		m_refcache->detach(m_conn);
+
+	m_refcache = cache;
+	if (m_refcache)
+		m_refcache->attach(m_conn);
+
+	m_session->set_reference_cache(m_refcache);
+}
+
+dbapi::snapshot::ptr Logbook::snapshot() const
+{
+	return dbapi::snapshot::ptr(new dbapi::snapshot(m_pool->acquire_reader()));
+}
+
+Session::Ptr Logbook::snapshotSession(dbapi::snapshot::ptr snap) const
+{
+	if (! snap)
+		throw std::runtime_error("Snapshot Session requires a Snapshot");
+
+	if (! dbapi::snapshot::supported())
+		return Session::Create(snap->conn());
+
+	dbapi::connection::ptr reader = m_pool->acquire_reader();
+	snap->open(reader);
+	return Session::Create(reader);
+}
+
+Session::Ptr Logbook::snapshotSession() const
+{
+	return Session::Create(snapshot()->conn());
 }
 
 void Logbook::Upgrade(const std::string & filename)
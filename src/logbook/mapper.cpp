@@ -28,13 +28,79 @@
  * WITH THE SOFTWARE.
  */
 
+#include <algorithm>
+
+
 #include "benthos/logbook/mapper.hpp"
 #include "benthos/logbook/session.hpp"
 
 using namespace benthos::logbook;
 
+const size_t AbstractMapper::max_delete_batch;
+const size_t AbstractMapper::max_fetch_batch;
+
+// Column Set which selects the full UPDATE statement
+static const uint64_t all_columns = ~0ULL;
+
+/*
+ * Parameter generator for AbstractMapper::insertAll().  Each call binds the
+ * next object; the identifier of the object inserted by the previous
+ * execution is read back first, before anything else can change the last
+ * insert rowid of the connection.
+ */
+struct AbstractMapper::insert_binder
+{
+	const AbstractMapper *		mapper;
+	Batch::const_iterator		it;
+	Batch::const_iterator		end;
+	Persistent::Ptr				last;
+
+	insert_binder(const AbstractMapper * m, const Batch & objects)
+		: mapper(m), it(objects.begin()), end(objects.end()), last()
+	{
+	}
+
+	bool operator() (dbapi::statement & s)
+	{
+		if (last)
+			mapper->set_persistent_id(last, s.last_rowid());
+
+		if (it == end)
+			return false;
+
+		last = * it++;
+		s.bind(1, boost::none);
+		mapper->bindInsert(s.shared_from_this(), last);
+		return true;
+	}
+};
+
+// Parameter generator for AbstractMapper::updateAll()
+struct AbstractMapper::update_binder
+{
+	const AbstractMapper *		mapper;
+	Batch::const_iterator		it;
+	Batch::const_iterator		end;
+
+	update_binder(const AbstractMapper * m, const Batch & objects)
+		: mapper(m), it(objects.begin()), end(objects.end())
+	{
+	}
+
+	bool operator() (dbapi::statement & s)
+	{
+		if (it == end)
+			return false;
+
+		s.bind(1, (* it)->id());
+		mapper->bindUpdate(s.shared_from_this(), * it++);
+		return true;
+	}
+};
+
 AbstractMapper::AbstractMapper(boost::shared_ptr<Session> session)
-	: m_session(session), m_conn(session->conn()), m_loaded()
+	: m_session(session), m_conn(session->conn()), m_perobj(true), m_fetch(NULL),
+	  m_refcache(), m_region(0)
 {
 }
 
@@ -42,6 +108,20 @@ AbstractMapper::~AbstractMapper()
 {
 }
 
+void AbstractMapper::abandonFetch(fetch_plan & plan)
+{
+	Session::Ptr s = m_session.lock();
+
+	Batch::const_iterator it;
+	for (it = plan.loaded.begin(); it != plan.loaded.end(); it++)
+	{
+		if (s)
+			s->m_idmap.erase(* it);
+		set_persistent_session(* it, Session::Ptr());
+	}
+	plan.loaded.clear();
+}
+
 void AbstractMapper::afterDelete(Persistent::Ptr o, int64_t oldId)
 {
 }
@@ -54,10 +134,24 @@ void AbstractMapper::afterLoaded(Persistent::Ptr o)
 {
 }
 
+void AbstractMapper::afterLoadedAll(const Batch & objects)
+{
+	Batch::const_iterator it;
+	for (it = objects.begin(); it != objects.end(); it++)
+		afterLoaded(* it);
+}
+
 void AbstractMapper::afterUpdate(Persistent::Ptr o)
 {
 }
 
+void AbstractMapper::appendLoaded(std::list<Persistent::Ptr> & list, Persistent::Ptr o, const std::string & name)
+{
+	LazyReference * r = o->reference(name);
+	if (r && r->loaded())
+		list.push_back(r->loaded());
+}
+
 void AbstractMapper::attachToSession(Persistent::Ptr o)
 {
 	Session::Ptr s = m_session.lock();
@@ -67,6 +161,14 @@ void AbstractMapper::attachToSession(Persistent::Ptr o)
 	set_persistent_session(o, s);
 }
 
+Persistent::Ptr AbstractMapper::findLoaded(uint32_t type_id, int64_t id) const
+{
+	Session::Ptr s = m_session.lock();
+	if (! s)
+		throw std::runtime_error("Session Pointer has Expired");
+	return s->m_idmap.find(type_id, id);
+}
+
 void AbstractMapper::beforeDelete(Persistent::Ptr o)
 {
 }
@@ -79,6 +181,35 @@ void AbstractMapper::beforeUpdate(Persistent::Ptr o)
 {
 }
 
+AbstractMapper::cache_fill AbstractMapper::cacheFill()
+{
+	cache_fill result;
+	if (! cacheable())
+		return result;
+
+	SessionPtr s = m_session.lock();
+	if (! s || ! s->reference_cache())
+		return result;
+
+	// The Region is looked up again only if the Session's Cache changes
+	result.cache = s->reference_cache();
+	if (result.cache != m_refcache.lock())
+	{
+		m_region = result.cache->region(s->reference_database(), tableName());
+		m_refcache = result.cache;
+	}
+
+	result.region = m_region;
+	result.generation = result.cache->generation(m_region);
+	result.store = ! m_conn->is_busy();
+	return result;
+}
+
+bool AbstractMapper::cacheable() const
+{
+	return false;
+}
+
 std::list<Persistent::Ptr> AbstractMapper::cascade_add(Persistent::Ptr o)
 {
 	return std::list<Persistent::Ptr>();
@@ -94,6 +225,68 @@ std::list<Persistent::Ptr> AbstractMapper::cascade_detach(Persistent::Ptr o)
 	return std::list<Persistent::Ptr>();
 }
 
+uint64_t AbstractMapper::changedColumns(Persistent::Ptr o)
+{
+	const column_def * cols = updateColumns();
+	uint64_t changed = o->changed_attributes();
+
+	// Modified without naming the attributes; update everything
+	if (! cols || (changed == 0) || tableName().empty())
+		return all_columns;
+
+	// Attribute bits are assigned on first use, so resolve them lazily
+	if (m_colmasks.empty())
+	{
+		for (const column_def * c = cols; c->attribute && (m_colmasks.size() < 64); c++)
+			m_colmasks.push_back(o->attribute_mask(c->attribute));
+	}
+
+	uint64_t result = 0;
+	for (size_t i = 0; i < m_colmasks.size(); i++)
+		if ((changed & m_colmasks[i]) != 0)
+			result |= (1ULL << i);
+
+	if ((m_colmasks.size() < 64) && (result == (1ULL << m_colmasks.size()) - 1))
+		return all_columns;
+
+	return result;
+}
+
+void AbstractMapper::completeFetch(fetch_plan & plan)
+{
+	try
+	{
+		afterLoadedAll(plan.loaded);
+	}
+	catch (...)
+	{
+		abandonFetch(plan);
+		throw;
+	}
+
+	Batch::const_iterator it;
+	for (it = plan.loaded.begin(); it != plan.loaded.end(); it++)
+		mark_persistent_clean(* it);
+}
+
+void AbstractMapper::deferReference(Persistent::Ptr o, const std::string & name, int64_t id) const
+{
+	LazyReference * r = o->reference(name);
+	if (! r)
+		throw std::runtime_error(o->type_name() + " has no reference named " + name);
+
+	Session::Ptr s = m_session.lock();
+	if (! s)
+		throw std::runtime_error("Session Pointer has Expired");
+
+	r->defer(s, id);
+}
+
+std::vector<const std::type_info *> AbstractMapper::dependencies() const
+{
+	return std::vector<const std::type_info *>();
+}
+
 AbstractMapper::Events & AbstractMapper::events()
 {
 	return m_events;
@@ -101,50 +294,224 @@ AbstractMapper::Events & AbstractMapper::events()
 
 int64_t AbstractMapper::insert(Persistent::Ptr o)
 {
-	m_events.before_insert(shared_from_this(), o);
-	beforeInsert(o);
+	insertAll(Batch(1, o));
+	return o->id();
+}
+
+void AbstractMapper::insertAll(const Batch & objects)
+{
+	if (objects.empty())
+		return;
 
+	Ptr self(shared_from_this());
+	Batch::const_iterator it;
+
+	m_events.before_insert_batch(self, objects);
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		if (m_perobj)
+			m_events.before_insert(self, * it);
+		beforeInsert(* it);
+	}
+
+	// Release buffers bound in place by bindInsert() even on failure
 	dbapi::statement::ptr s(insertStatement());
-	s->reset();
-	s->bind(1, boost::none);
-	bindInsert(s, o);
+	try
+	{
+		s->executemany(insert_binder(this, objects));
+	}
+	catch (...)
+	{
+		s->clear_bindings();
+		throw;
+	}
+	s->clear_bindings();
 
-	dbapi::cursor::ptr c = s->exec();
+	Session::Ptr sess = m_session.lock();
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		if (sess)
+			sess->m_idmap.insert(* it);
 
-	set_persistent_id(o, c->last_rowid());
-	m_loaded[o->id()] = Persistent::WeakPtr(o);
+		afterInsert(* it);
+		if (m_perobj)
+			m_events.after_insert(self, * it);
+	}
+	m_events.after_insert_batch(self, objects);
+}
 
-	afterInsert(o);
-	m_events.after_insert(shared_from_this(), o);
+dbapi::statement::ptr AbstractMapper::partialStatement(uint64_t columns)
+{
+	const column_def * cols = updateColumns();
+	std::string sql("update " + tableName() + " set ");
+	bool first = true;
+	for (size_t i = 0; cols[i].attribute && (i < 64); i++)
+	{
+		if ((columns & (1ULL << i)) == 0)
+			continue;
 
-	return o->id();
+		if (! first)
+			sql += ", ";
+		sql += cols[i].assignment;
+		first = false;
+	}
+	sql += " where id=?1";
+
+	/*
+	 * The statement keeps the full statement's parameter numbering, so
+	 * bindUpdate() can be used unchanged; binds to the columns which are not
+	 * part of this statement are dropped.
+	 */
+	statement::ptr s(m_conn->prepare(sql));
+	s->skip_unused(true);
+	return s;
+}
+
+std::string AbstractMapper::placeholders(size_t n)
+{
+	std::string result("(?");
+	for (size_t i = 1; i < n; i++)
+		result += ", ?";
+	return result + ")";
+}
+
+bool AbstractMapper::perObjectEvents() const
+{
+	return m_perobj;
+}
+
+std::list<Persistent::Ptr> AbstractMapper::references(Persistent::Ptr)
+{
+	return std::list<Persistent::Ptr>();
 }
 
 void AbstractMapper::remove(Persistent::Ptr o)
 {
-	m_events.before_delete(shared_from_this(), o);
-	beforeDelete(o);
+	removeAll(Batch(1, o));
+}
+
+void AbstractMapper::removeAll(const Batch & objects)
+{
+	if (objects.empty())
+		return;
+
+	Ptr self(shared_from_this());
+	Batch::const_iterator it;
+
+	m_events.before_delete_batch(self, objects);
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		if (m_perobj)
+			m_events.before_delete(self, * it);
+		beforeDelete(* it);
+	}
 
-	dbapi::statement::ptr s(removeStatement());
-	s->reset();
-	s->bind(1, o->id());
-	s->exec();
+	std::string table(tableName());
+	if (table.empty() || (objects.size() == 1))
+	{
+		dbapi::statement::ptr s(removeStatement());
+		for (it = objects.begin(); it != objects.end(); it++)
+		{
+			s->reset();
+			s->bind(1, (* it)->id());
+			s->execute();
+		}
+	}
+	else
+	{
+		for (it = objects.begin(); it != objects.end(); )
+		{
+			size_t n = std::min((size_t)(objects.end() - it), max_delete_batch);
 
-	afterDelete(o, o->id());
-	m_events.after_delete(shared_from_this(), o);
+			// Generated SQL is seldom repeated, so it is kept out of the statement cache
+			dbapi::statement::ptr s(m_conn->prepare("delete from " + table + " where id in " + placeholders(n), false));
+			for (size_t i = 1; i <= n; i++, it++)
+				s->bind(i, (* it)->id());
+			s->execute();
+		}
+	}
+
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		afterDelete(* it, (* it)->id());
+		if (m_perobj)
+			m_events.after_delete(self, * it);
+	}
+	m_events.after_delete_batch(self, objects);
+}
+
+std::string AbstractMapper::selectColumns() const
+{
+	return std::string();
+}
+
+void AbstractMapper::setPerObjectEvents(bool value)
+{
+	m_perobj = value;
+}
+
+std::string AbstractMapper::tableName() const
+{
+	return std::string();
+}
+
+const AbstractMapper::column_def * AbstractMapper::updateColumns() const
+{
+	return NULL;
 }
 
 void AbstractMapper::update(Persistent::Ptr o)
 {
-	m_events.before_update(shared_from_this(), o);
-	beforeUpdate(o);
+	updateAll(Batch(1, o));
+}
+
+void AbstractMapper::updateAll(const Batch & objects)
+{
+	if (objects.empty())
+		return;
+
+	Ptr self(shared_from_this());
+	Batch::const_iterator it;
+
+	m_events.before_update_batch(self, objects);
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		if (m_perobj)
+			m_events.before_update(self, * it);
+		beforeUpdate(* it);
+	}
+
+	// Group the objects by the set of columns which need updating
+	std::map<uint64_t, Batch> groups;
+	for (it = objects.begin(); it != objects.end(); it++)
+		groups[changedColumns(* it)].push_back(* it);
+
+	std::map<uint64_t, Batch>::const_iterator git;
+	for (git = groups.begin(); git != groups.end(); git++)
+	{
+		// Only attributes which are not stored in the table changed
+		if (git->first == 0)
+			continue;
 
-	dbapi::statement::ptr s(updateStatement());
-	s->reset();
-	s->bind(1, o->id());
-	bindUpdate(s, o);
-	s->exec();
+		// Release buffers bound in place by bindUpdate() even on failure
+		dbapi::statement::ptr s((git->first == all_columns) ? updateStatement() : partialStatement(git->first));
+		try
+		{
+			s->executemany(update_binder(this, git->second));
+		}
+		catch (...)
+		{
+			s->clear_bindings();
+			throw;
+		}
+		s->clear_bindings();
+	}
 
-	afterUpdate(o);
-	m_events.after_update(shared_from_this(), o);
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		afterUpdate(* it);
+		if (m_perobj)
+			m_events.after_update(self, * it);
+	}
+	m_events.after_update_batch(self, objects);
 }
@@ -45,6 +45,23 @@ std::string DiveComputerMapper::sql_update = "update computers set driver=?2, se
 		"driver_args=?8, parser_args=?9, name=?10, manufacturer=?11, model=?12, hw_version=?13, sw_version=?14 where id=?1";
 std::string DiveComputerMapper::sql_delete = "delete from computers where id=?1";
 
+const AbstractMapper::column_def DiveComputerMapper::update_columns[] = {
+	{ "driver", "driver=?2" },
+	{ "serial", "serial=?3" },
+	{ "device", "device=?4" },
+	{ "parser", "parser=?5" },
+	{ "token", "token=?6" },
+	{ "last_transfer", "last_transfer=?7" },
+	{ "driver_args", "driver_args=?8" },
+	{ "parser_args", "parser_args=?9" },
+	{ "name", "name=?10" },
+	{ "manufacturer", "manufacturer=?11" },
+	{ "model", "model=?12" },
+	{ "hw_version", "hw_version=?13" },
+	{ "sw_version", "sw_version=?14" },
+	{ NULL, NULL }
+};
+
 std::string DiveComputerMapper::sql_find_all = "select " + columns + " from computers";
 std::string DiveComputerMapper::sql_find_id = "select " + columns + " from computers where id=?1";
 std::string DiveComputerMapper::sql_find_serno = "select " + columns + " from computers where driver=?1 and serial=?2";
@@ -89,6 +106,11 @@ void DiveComputerMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 	s->bind(14, o->sw_version());
 }
 
+bool DiveComputerMapper::cacheable() const
+{
+	return true;
+}
+
 std::list<Persistent::Ptr> DiveComputerMapper::cascade_add(Persistent::Ptr p)
 {
 	std::list<Persistent::Ptr> result;
@@ -103,33 +125,48 @@ std::list<Persistent::Ptr> DiveComputerMapper::cascade_add(Persistent::Ptr p)
 	return result;
 }
 
-#define SET_VARIANT(o, f, v, t) if ((v).is_null()) o->f(boost::none); else o->f(v.as<t>())
+#define SET_COLUMN(o, f, r, i, t) if ((r).is_null(i)) o->f(boost::none); else o->f((r).as<t >(i))
 
-DiveComputer::Ptr DiveComputerMapper::doLoad(int64_t id, cursor::row_t r) const
+DiveComputer::Ptr DiveComputerMapper::doLoad(int64_t id, const cursor::row_view & r) const
 {
 	DiveComputer::Ptr o(new logbook::DiveComputer);
 
 	mark_persistent_loading(o);
 
 	set_persistent_id(o, id);
-	o->setDriver(r[1].as<std::string>());
-	o->setSerial(r[2].as<std::string>());
-
-	SET_VARIANT(o, setDevice, r[3], std::string);
-	SET_VARIANT(o, setParser, r[4], std::string);
-	SET_VARIANT(o, setToken, r[5], std::string);
-	SET_VARIANT(o, setLastTransfer, r[6], time_t);
-	SET_VARIANT(o, setDriverArgs, r[7], std::string);
-	SET_VARIANT(o, setParserArgs, r[8], std::string);
-	SET_VARIANT(o, setName, r[9], std::string);
-	SET_VARIANT(o, setManufacturer, r[10], std::string);
-	SET_VARIANT(o, setModel, r[11], std::string);
-	SET_VARIANT(o, setHWVersion, r[12], std::string);
-	SET_VARIANT(o, setSWVersion, r[13], std::string);
+	o->setDriver(r.as<std::string>(1));
+	o->setSerial(r.as<std::string>(2));
+
+	SET_COLUMN(o, setDevice, r, 3, std::string);
+	SET_COLUMN(o, setParser, r, 4, std::string);
+	SET_COLUMN(o, setToken, r, 5, std::string);
+	SET_COLUMN(o, setLastTransfer, r, 6, time_t);
+	SET_COLUMN(o, setDriverArgs, r, 7, std::string);
+	SET_COLUMN(o, setParserArgs, r, 8, std::string);
+	SET_COLUMN(o, setName, r, 9, std::string);
+	SET_COLUMN(o, setManufacturer, r, 10, std::string);
+	SET_COLUMN(o, setModel, r, 11, std::string);
+	SET_COLUMN(o, setHWVersion, r, 12, std::string);
+	SET_COLUMN(o, setSWVersion, r, 13, std::string);
 
 	return o;
 }
 
+std::string DiveComputerMapper::selectColumns() const
+{
+	return columns;
+}
+
+std::string DiveComputerMapper::tableName() const
+{
+	return "computers";
+}
+
+const AbstractMapper::column_def * DiveComputerMapper::updateColumns() const
+{
+	return update_columns;
+}
+
 std::vector<DiveComputer::Ptr> DiveComputerMapper::find()
 {
 	m_find_all_stmt->reset();
@@ -138,17 +175,17 @@ std::vector<DiveComputer::Ptr> DiveComputerMapper::find()
 	return loadAll(c);
 }
 
-DiveComputer::Ptr DiveComputerMapper::find(int64_t id)
+void DiveComputerMapper::find(IFinder<DiveComputer>::Visitor v)
 {
-	m_find_id_stmt->reset();
-	m_find_id_stmt->bind(1, id);
+	m_find_all_stmt->reset();
+	dbapi::cursor::ptr c = m_find_all_stmt->exec();
 
-	dbapi::cursor::ptr c = m_find_id_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::DiveComputer::Ptr();
+	loadEach(c, v);
+}
 
-	return load(r);
+DiveComputer::Ptr DiveComputerMapper::find(int64_t id)
+{
+	return findById(id, m_find_id_stmt);
 }
 
 DiveComputer::Ptr DiveComputerMapper::findBySerial(const std::string & driver, const std::string & serial)
@@ -158,9 +195,5 @@ DiveComputer::Ptr DiveComputerMapper::findBySerial(const std::string & driver, c
 	m_find_serno_stmt->bind(2, serial);
 
 	dbapi::cursor::ptr c = m_find_serno_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::DiveComputer::Ptr();
-
-	return load(r);
+	return loadOne(c);
 }
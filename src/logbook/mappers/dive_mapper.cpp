@@ -55,6 +55,42 @@ std::string DiveMapper::sql_update = "update dives set dive_datetime=?2, dive_ut
 		"algorithm=?33 where id=?1";
 std::string DiveMapper::sql_delete = "delete from dives where id=?1";
 
+const AbstractMapper::column_def DiveMapper::update_columns[] = {
+	{ "datetime", "dive_datetime=?2" },
+	{ "utc_offset", "dive_utcoffset=?3" },
+	{ "number", "dive_number=?4" },
+	{ "site", "site_id=?5" },
+	{ "computer", "computer_id=?6" },
+	{ "repetition", "repetition=?7" },
+	{ "interval", "interval=?8" },
+	{ "duration", "duration=?9" },
+	{ "max_depth", "max_depth=?10" },
+	{ "avg_depth", "avg_depth=?11" },
+	{ "air_temp", "air_temp=?12" },
+	{ "max_temp", "max_temp=?13" },
+	{ "min_temp", "min_temp=?14" },
+	{ "start_pressure", "px_start=?15" },
+	{ "end_pressure", "px_end=?16" },
+	{ "mix", "mix_id=?17" },
+	{ "tank", "tank_id=?18" },
+	{ "salinity", "salinity=?19" },
+	{ "comments", "comments=?20" },
+	{ "rating", "rating=?21" },
+	{ "safety_stop", "safety_stop=?22" },
+	{ "stop_depth", "stop_depth=?23" },
+	{ "stop_time", "stop_time=?24" },
+	{ "weight", "weight=?25" },
+	{ "visibility_category", "visibility_cat=?26" },
+	{ "visibility_distance", "visibility_dist=?27" },
+	{ "start_pressure_group", "pg_start=?28" },
+	{ "end_pressure_group", "pg_end=?29" },
+	{ "rnt", "rnt=?30" },
+	{ "desat_time", "desat=?31" },
+	{ "nofly_time", "nofly=?32" },
+	{ "algorithm", "algorithm=?33" },
+	{ NULL, NULL }
+};
+
 std::string DiveMapper::sql_find_all = "select " + columns + " from dives";
 std::string DiveMapper::sql_find_id = "select " + columns + " from dives where id=?1";
 std::string DiveMapper::sql_find_site = "select " + columns + " from dives where site_id=?1";
@@ -78,6 +114,34 @@ std::string DiveMapper::sql_drop_tags = "delete from divetags where dive_id=?1";
 std::string DiveMapper::sql_add_tags = "insert into divetags values (?1, ?2)";
 std::string DiveMapper::sql_all_tags = "select distinct(tag) from divetags order by tag asc";
 
+/**
+ * @brief Tag Parameter Generator
+ *
+ * Binds the (dive_id, tag) parameters for each tag in turn for use with
+ * statement::executemany().
+ */
+struct tag_binder
+{
+	int64_t									dive_id;
+	std::list<std::string>::const_iterator	it;
+	std::list<std::string>::const_iterator	end;
+
+	tag_binder(int64_t id, const std::list<std::string> & tags)
+		: dive_id(id), it(tags.begin()), end(tags.end())
+	{
+	}
+
+	bool operator() (statement & s)
+	{
+		if (it == end)
+			return false;
+
+		s.bind(1, dive_id);
+		s.bind(2, * it++);
+		return true;
+	}
+};
+
 DiveMapper::DiveMapper(boost::shared_ptr<Session> session)
 	: Mapper<Dive>(session)
 {
@@ -117,7 +181,7 @@ void DiveMapper::afterDelete(Persistent::Ptr o, int64_t oldId)
 {
 	m_drop_tags_stmt->reset();
 	m_drop_tags_stmt->bind(1, oldId);
-	m_drop_tags_stmt->exec();
+	m_drop_tags_stmt->execute();
 }
 
 void DiveMapper::afterInsert(Persistent::Ptr o)
@@ -125,14 +189,10 @@ void DiveMapper::afterInsert(Persistent::Ptr o)
 	Dive::Ptr d = downcast(o);
 
 	std::list<std::string> tags = d->tags()->all();
-	std::list<std::string>::const_iterator it;
-	for (it = tags.begin(); it != tags.end(); it++)
-	{
-		m_add_tags_stmt->reset();
-		m_add_tags_stmt->bind(1, d->id());
-		m_add_tags_stmt->bind(2, * it);
-		m_add_tags_stmt->exec();
-	}
+	if (tags.empty())
+		return;
+
+	m_add_tags_stmt->executemany(tag_binder(d->id(), tags));
 }
 
 void DiveMapper::afterLoaded(Persistent::Ptr o)
@@ -143,17 +203,41 @@ void DiveMapper::afterLoaded(Persistent::Ptr o)
 	m_find_tags_stmt->bind(1, d->id());
 
 	dbapi::cursor::ptr c = m_find_tags_stmt->exec();
-	std::vector<cursor::row_t> rs = c->fetchall();
-	std::vector<cursor::row_t>::const_iterator it;
-	for (it = rs.begin(); it != rs.end(); it++)
-		d->tags()->add((* it)[0].as<std::string>());
+	for ( ; ! c->at_end(); c->next())
+		d->tags()->add(c->current().as<std::string>(0));
+}
+
+void DiveMapper::afterLoadedAll(const Batch & objects)
+{
+	std::map<int64_t, Dive::Ptr> dives;
+	Batch::const_iterator it;
+	for (it = objects.begin(); it != objects.end(); it++)
+		dives[(* it)->id()] = downcast(* it);
+
+	// Load the tags of each batch of dives with a single query
+	for (it = objects.begin(); it != objects.end(); )
+	{
+		size_t n = std::min((size_t)(objects.end() - it), max_fetch_batch);
+
+		dbapi::statement::ptr s(m_conn->prepare("select dive_id, tag from divetags where dive_id in " +
+			placeholders(n) + " order by dive_id, tag asc", false));
+		for (size_t i = 1; i <= n; i++, it++)
+			s->bind(i, (* it)->id());
+
+		dbapi::cursor::ptr c = s->exec();
+		for ( ; ! c->at_end(); c->next())
+			dives[c->current().as<int64_t>(0)]->tags()->add(c->current().as<std::string>(1));
+	}
 }
 
 void DiveMapper::afterUpdate(Persistent::Ptr o)
 {
+	if (! o->is_changed("tags"))
+		return;
+
 	m_drop_tags_stmt->reset();
 	m_drop_tags_stmt->bind(1, o->id());
-	m_drop_tags_stmt->exec();
+	m_drop_tags_stmt->execute();
 
 	afterInsert(o);
 }
@@ -162,11 +246,11 @@ std::vector<std::string> DiveMapper::allTags() const
 {
 	std::vector<std::string> result;
 
+	m_all_tags_stmt->reset();
 	dbapi::cursor::ptr c = m_all_tags_stmt->exec();
-	std::vector<cursor::row_t> rs = c->fetchall();
-	std::vector<cursor::row_t>::const_iterator it;
-	for (it = rs.begin(); it != rs.end(); it++)
-		result.push_back((*it)[0].as<std::string>());
+	dbapi::cursor::iterator it;
+	for (it = c->begin(); it != c->end(); ++it)
+		result.push_back(it->as<std::string>(0));
 
 	return result;
 }
@@ -180,19 +264,17 @@ void DiveMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 {
 	Dive::Ptr o = downcast(p);
 
+	/*
+	 * Text columns are bound in place from the Dive's own members, which
+	 * outlive the statement execution (see AbstractMapper::update).
+	 */
 	s->bind(2, o->datetime());
 	s->bind(3, o->utc_offset());
 	s->bind(4, o->number());
 
-	if (o->site())
-		s->bind(5, o->site()->id());
-	else
-		s->bind(5, boost::none);
-
-	if (o->computer())
-		s->bind(6, o->computer()->id());
-	else
-		s->bind(6, boost::none);
+	// Foreign keys are bound without loading the referenced objects
+	s->bind(5, o->reference("site")->id());
+	s->bind(6, o->reference("computer")->id());
 
 	s->bind(7, o->repetition());
 	s->bind(8, o->interval());
@@ -205,31 +287,24 @@ void DiveMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 	s->bind(15, o->start_pressure());
 	s->bind(16, o->end_pressure());
 
-	if (o->mix())
-		s->bind(17, o->mix()->id());
-	else
-		s->bind(17, boost::none);
-
-	if (o->tank())
-		s->bind(18, o->tank()->id());
-	else
-		s->bind(18, boost::none);
+	s->bind(17, o->reference("mix")->id());
+	s->bind(18, o->reference("tank")->id());
 
 	s->bind(19, o->salinity());
-	s->bind(20, o->comments());
+	s->bind_static(20, o->comments());
 	s->bind(21, o->rating());
 	s->bind(22, o->safety_stop() ? 1 : 0);
 	s->bind(23, o->stop_depth());
 	s->bind(24, o->stop_time());
 	s->bind(25, o->weight());
-	s->bind(26, o->visibility_category());
+	s->bind_static(26, o->visibility_category());
 	s->bind(27, o->visibility_distance());
-	s->bind(28, o->start_pressure_group());
-	s->bind(29, o->end_pressure_group());
+	s->bind_static(28, o->start_pressure_group());
+	s->bind_static(29, o->end_pressure_group());
 	s->bind(30, o->rnt());
 	s->bind(31, o->desat_time());
 	s->bind(32, o->nofly_time());
-	s->bind(33, o->algorithm());
+	s->bind_static(33, o->algorithm());
 }
 
 std::list<Persistent::Ptr> DiveMapper::cascade_add(Persistent::Ptr p)
@@ -246,10 +321,8 @@ std::list<Persistent::Ptr> DiveMapper::cascade_add(Persistent::Ptr p)
 	std::list<DiveTank::Ptr> tanks = o->tanks()->all();
 	result.insert(result.end(), tanks.begin(), tanks.end());
 
-	if (o->computer())
-		result.push_back(o->computer());
-	if (o->site())
-		result.push_back(o->site());
+	appendLoaded(result, o, "computer");
+	appendLoaded(result, o, "site");
 
 	return result;
 }
@@ -272,8 +345,7 @@ unsigned int DiveMapper::countByComputer(int64_t computer_id) const
 {
 	m_count_cpu_stmt->reset();
 	m_count_cpu_stmt->bind(1, computer_id);
-	variant res = m_count_cpu_stmt->exec_scalar();
-	int ires = res.get<int>();
+	int ires = m_count_cpu_stmt->query_scalar<int>();
 	if (ires <= 0)
 		return 0;
 	return (unsigned int)(ires);
@@ -283,82 +355,117 @@ unsigned int DiveMapper::countBySite(int64_t site_id) const
 {
 	m_count_site_stmt->reset();
 	m_count_site_stmt->bind(1, site_id);
-	variant res = m_count_site_stmt->exec_scalar();
-	int ires = res.get<int>();
+	int ires = m_count_site_stmt->query_scalar<int>();
 	if (ires <= 0)
 		return 0;
 	return (unsigned int)(ires);
 }
 
-#define SET_VARIANT(o, f, v, t) if ((v).is_null()) o->f(boost::none); else o->f(v.as<t>())
+std::vector<const std::type_info *> DiveMapper::dependencies() const
+{
+	std::vector<const std::type_info *> result;
+	result.push_back(& typeid(DiveComputer));
+	result.push_back(& typeid(DiveSite));
+	result.push_back(& typeid(Mix));
+	result.push_back(& typeid(Tank));
+	return result;
+}
+
+#define SET_COLUMN(o, f, r, i, t) if ((r).is_null(i)) o->f(boost::none); else o->f((r).as<t >(i))
 
-Dive::Ptr DiveMapper::doLoad(int64_t id, cursor::row_t r) const
+Dive::Ptr DiveMapper::doLoad(int64_t id, const cursor::row_view & r) const
 {
 	Dive::Ptr o(new logbook::Dive);
 
 	mark_persistent_loading(o);
 
-	IFinder<DiveComputer>::Ptr cmp_finder(m_session.lock()->finder<DiveComputer>());
-	IFinder<DiveSite>::Ptr site_finder(m_session.lock()->finder<DiveSite>());
-	IFinder<Mix>::Ptr mix_finder(m_session.lock()->finder<Mix>());
-	IFinder<Tank>::Ptr tank_finder(m_session.lock()->finder<Tank>());
-
 	set_persistent_id(o, id);
-	o->setDateTime(r[1].as<time_t>());
-	SET_VARIANT(o, setUTCOffset, r[2], int);
-	SET_VARIANT(o, setNumber, r[3], int);
+	o->setDateTime(r.as<time_t>(1));
+	SET_COLUMN(o, setUTCOffset, r, 2, int);
+	SET_COLUMN(o, setNumber, r, 3, int);
 
-	if (r[4].is_null())
+	if (r.is_null(4))
 		o->setSite(boost::none);
 	else
-		o->setSite(site_finder->find(r[4].as<int64_t>()));
+		deferReference(o, "site", r.as<int64_t>(4));
 
-	if (r[5].is_null())
+	if (r.is_null(5))
 		o->setComputer(boost::none);
 	else
-		o->setComputer(cmp_finder->find(r[5].as<int64_t>()));
-
-	o->setRepetition(r[6].as<int>());
-	o->setInterval(r[7].as<int>());
-	o->setDuration(r[8].as<int>());
-	o->setMaxDepth(r[9].as<double>());
-	SET_VARIANT(o, setAvgDepth, r[10], double);
-	SET_VARIANT(o, setAirTemp, r[11], double);
-	SET_VARIANT(o, setMaxTemp, r[12], double);
-	SET_VARIANT(o, setMinTemp, r[13], double);
-	SET_VARIANT(o, setStartPressure, r[14], double);
-	SET_VARIANT(o, setEndPressure, r[15], double);
-
-	if (r[16].is_null())
+		deferReference(o, "computer", r.as<int64_t>(5));
+
+	o->setRepetition(r.as<int>(6));
+	o->setInterval(r.as<int>(7));
+	o->setDuration(r.as<int>(8));
+	o->setMaxDepth(r.as<double>(9));
+	SET_COLUMN(o, setAvgDepth, r, 10, double);
+	SET_COLUMN(o, setAirTemp, r, 11, double);
+	SET_COLUMN(o, setMaxTemp, r, 12, double);
+	SET_COLUMN(o, setMinTemp, r, 13, double);
+	SET_COLUMN(o, setStartPressure, r, 14, double);
+	SET_COLUMN(o, setEndPressure, r, 15, double);
+
+	if (r.is_null(16))
 		o->setMix(boost::none);
 	else
-		o->setMix(mix_finder->find(r[16].as<int64_t>()));
+		deferReference(o, "mix", r.as<int64_t>(16));
 
-	if (r[17].is_null())
+	if (r.is_null(17))
 		o->setTank(boost::none);
 	else
-		o->setTank(tank_finder->find(r[17].as<int64_t>()));
-
-	SET_VARIANT(o, setSalinity, r[18], std::string);
-	SET_VARIANT(o, setComments, r[19], std::string);
-	SET_VARIANT(o, setRating, r[20], int);
-
-	o->setSafetyStop(r[21].as<int>() == 1);
-	SET_VARIANT(o, setStopDepth, r[22], double);
-	SET_VARIANT(o, setStopTime, r[23], int);
-	SET_VARIANT(o, setWeight, r[24], double);
-	SET_VARIANT(o, setVisibilityCategory, r[25], std::string);
-	SET_VARIANT(o, setVisibilityDistance, r[26], double);
-	SET_VARIANT(o, setStartPressureGroup, r[27], std::string);
-	SET_VARIANT(o, setEndPressureGroup, r[28], std::string);
-	SET_VARIANT(o, setRNT, r[29], int);
-	SET_VARIANT(o, setDesatTime, r[30], int);
-	SET_VARIANT(o, setNoFlyTime, r[31], int);
-	SET_VARIANT(o, setAlgorithm, r[32], std::string);
+		deferReference(o, "tank", r.as<int64_t>(17));
+
+	SET_COLUMN(o, setSalinity, r, 18, std::string);
+	SET_COLUMN(o, setComments, r, 19, std::string);
+	SET_COLUMN(o, setRating, r, 20, int);
+
+	o->setSafetyStop(r.as<int>(21) == 1);
+	SET_COLUMN(o, setStopDepth, r, 22, double);
+	SET_COLUMN(o, setStopTime, r, 23, int);
+	SET_COLUMN(o, setWeight, r, 24, double);
+	SET_COLUMN(o, setVisibilityCategory, r, 25, std::string);
+	SET_COLUMN(o, setVisibilityDistance, r, 26, double);
+	SET_COLUMN(o, setStartPressureGroup, r, 27, std::string);
+	SET_COLUMN(o, setEndPressureGroup, r, 28, std::string);
+	SET_COLUMN(o, setRNT, r, 29, int);
+	SET_COLUMN(o, setDesatTime, r, 30, int);
+	SET_COLUMN(o, setNoFlyTime, r, 31, int);
+	SET_COLUMN(o, setAlgorithm, r, 32, std::string);
 
 	return o;
 }
 
+std::list<Persistent::Ptr> DiveMapper::references(Persistent::Ptr p)
+{
+	std::list<Persistent::Ptr> result;
+	Dive::Ptr o = downcast(p);
+
+	if (! o)
+		return result;
+
+	appendLoaded(result, o, "computer");
+	appendLoaded(result, o, "mix");
+	appendLoaded(result, o, "site");
+	appendLoaded(result, o, "tank");
+
+	return result;
+}
+
+std::string DiveMapper::selectColumns() const
+{
+	return columns;
+}
+
+std::string DiveMapper::tableName() const
+{
+	return "dives";
+}
+
+const AbstractMapper::column_def * DiveMapper::updateColumns() const
+{
+	return update_columns;
+}
+
 std::vector<Dive::Ptr> DiveMapper::find()
 {
 	m_find_all_stmt->reset();
@@ -367,17 +474,21 @@ std::vector<Dive::Ptr> DiveMapper::find()
 	return loadAll(c);
 }
 
+void DiveMapper::find(IFinder<Dive>::Visitor v)
+{
+	m_find_all_stmt->reset();
+	dbapi::cursor::ptr c = m_find_all_stmt->exec();
+
+	loadEach(c, v);
+}
+
 Dive::Ptr DiveMapper::find(int64_t id)
 {
 	m_find_id_stmt->reset();
 	m_find_id_stmt->bind(1, id);
 
 	dbapi::cursor::ptr c = m_find_id_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::Dive::Ptr();
-
-	return load(r);
+	return loadOne(c);
 }
 
 std::vector<Dive::Ptr> DiveMapper::findRecentlyImported(unsigned int days, int max)
@@ -390,6 +501,12 @@ std::vector<Dive::Ptr> DiveMapper::findRecentlyImported(unsigned int days, int m
 	return loadAll(c);
 }
 
+std::vector<Dive::Ptr> DiveMapper::findRecentlyImported(unsigned int days, int max, const dbapi::cancellation_token & token)
+{
+	dbapi::cancellation_scope scope(m_conn, token);
+	return findRecentlyImported(days, max);
+}
+
 std::vector<Dive::Ptr> DiveMapper::findByComputer(int64_t computer_id)
 {
 	m_find_cpu_stmt->reset();
@@ -408,6 +525,12 @@ std::vector<Dive::Ptr> DiveMapper::findByCountry(const country & country_)
 	return loadAll(c);
 }
 
+std::vector<Dive::Ptr> DiveMapper::findByCountry(const country & country_, const dbapi::cancellation_token & token)
+{
+	dbapi::cancellation_scope scope(m_conn, token);
+	return findByCountry(country_);
+}
+
 std::vector<Dive::Ptr> DiveMapper::findByDates(time_t start, time_t end)
 {
 	m_find_dates_stmt->reset();
@@ -418,6 +541,12 @@ std::vector<Dive::Ptr> DiveMapper::findByDates(time_t start, time_t end)
 	return loadAll(c);
 }
 
+std::vector<Dive::Ptr> DiveMapper::findByDates(time_t start, time_t end, const dbapi::cancellation_token & token)
+{
+	dbapi::cancellation_scope scope(m_conn, token);
+	return findByDates(start, end);
+}
+
 std::vector<Dive::Ptr> DiveMapper::findBySite(int64_t site_id)
 {
 	m_find_site_stmt->reset();
@@ -431,38 +560,26 @@ boost::optional<double> DiveMapper::maxDepthForSite(int64_t site_id) const
 {
 	m_maxdepth_stmt->reset();
 	m_maxdepth_stmt->bind(1, site_id);
-	variant res = m_maxdepth_stmt->exec_scalar();
-	if (res.is_null())
-		return boost::optional<double>();
-	return boost::optional<double>(res.as<double>());
+	return m_maxdepth_stmt->query_scalar<boost::optional<double> >();
 }
 
 boost::optional<double> DiveMapper::avgDepthForSite(int64_t site_id) const
 {
 	m_avgdepth_stmt->reset();
 	m_avgdepth_stmt->bind(1, site_id);
-	variant res = m_avgdepth_stmt->exec_scalar();
-	if (res.is_null())
-		return boost::optional<double>();
-	return boost::optional<double>(res.as<double>());
+	return m_avgdepth_stmt->query_scalar<boost::optional<double> >();
 }
 
 boost::optional<double> DiveMapper::avgTempForSite(int64_t site_id) const
 {
 	m_avgtemp_stmt->reset();
 	m_avgtemp_stmt->bind(1, site_id);
-	variant res = m_avgtemp_stmt->exec_scalar();
-	if (res.is_null())
-		return boost::optional<double>();
-	return boost::optional<double>(res.as<double>());
+	return m_avgtemp_stmt->query_scalar<boost::optional<double> >();
 }
 
 boost::optional<double> DiveMapper::ratingForSite(int64_t site_id) const
 {
 	m_avgrating_stmt->reset();
 	m_avgrating_stmt->bind(1, site_id);
-	variant res = m_avgrating_stmt->exec_scalar();
-	if (res.is_null())
-		return boost::optional<double>();
-	return boost::optional<double>(res.as<double>());
+	return m_avgrating_stmt->query_scalar<boost::optional<double> >();
 }
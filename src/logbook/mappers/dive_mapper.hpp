@@ -63,6 +63,8 @@ protected:
 	static std::string sql_update;		///< UPDATE Statement SQL String
 	static std::string sql_delete;		///< DELETE Statement SQL String
 
+	static const column_def update_columns[];	///< Columns for Partial UPDATE Statements
+
 	static std::string sql_find_all;	///< Find All Statement SQL String
 	static std::string sql_find_id;		///< Find By Id Statement SQL String
 	static std::string sql_find_site;	///< Find By Site Statement SQL String
@@ -108,6 +110,19 @@ public:
 	 */
 	virtual std::list<Persistent::Ptr> cascade_delete(Persistent::Ptr o);
 
+	/**
+	 * @brief Return the Domain Model Classes this Mapper depends on
+	 * @return List of Referenced Classes
+	 */
+	virtual std::vector<const std::type_info *> dependencies() const;
+
+	/**
+	 * @brief Return the Persistent Objects referenced by an Object
+	 * @param[in] Domain Object
+	 * @return List of Referenced Objects
+	 */
+	virtual std::list<Persistent::Ptr> references(Persistent::Ptr o);
+
 public:
 
 	/**
@@ -136,6 +151,12 @@ public:
 	 */
 	virtual std::vector<Dive::Ptr> find();
 
+	/**
+	 * @brief Visit all Mapped Objects without building a List
+	 * @param[in] Visitor Function
+	 */
+	virtual void find(IFinder<Dive>::Visitor v);
+
 	/**
 	 * @brief Return a single Dive by its identifier
 	 * @param[in] Identifier
@@ -151,6 +172,16 @@ public:
 	 */
 	virtual std::vector<Dive::Ptr> findRecentlyImported(unsigned int days, int max);
 
+	/**
+	 * @brief Find Dives imported within the given number of days
+	 * @param[in] Number of Days
+	 * @param[in] Maximum Number to Return
+	 * @param[in] Cancellation Token
+	 * @return List of Dives
+	 * @throws dbapi::interrupted_error if the Token is cancelled
+	 */
+	virtual std::vector<Dive::Ptr> findRecentlyImported(unsigned int days, int max, const dbapi::cancellation_token & token);
+
 	/**
 	 * @brief Find Dives from a given Dive Computer
 	 * @param[in] Dive Computer Id
@@ -165,6 +196,15 @@ public:
 	 */
 	virtual std::vector<Dive::Ptr> findByCountry(const country & country_);
 
+	/**
+	 * @brief Find Dives in a given Country
+	 * @param[in] Country
+	 * @param[in] Cancellation Token
+	 * @return List of Dives
+	 * @throws dbapi::interrupted_error if the Token is cancelled
+	 */
+	virtual std::vector<Dive::Ptr> findByCountry(const country & country_, const dbapi::cancellation_token & token);
+
 	/**
 	 * @brief Find Dives in a given Time Span
 	 * @param[in] Start Time
@@ -173,6 +213,16 @@ public:
 	 */
 	virtual std::vector<Dive::Ptr> findByDates(time_t start, time_t end);
 
+	/**
+	 * @brief Find Dives in a given Time Span
+	 * @param[in] Start Time
+	 * @param[in] End Time
+	 * @param[in] Cancellation Token
+	 * @return List of Dives
+	 * @throws dbapi::interrupted_error if the Token is cancelled
+	 */
+	virtual std::vector<Dive::Ptr> findByDates(time_t start, time_t end, const dbapi::cancellation_token & token);
+
 	/**
 	 * @brief Find Dives at a given Dive Site
 	 * @param[in] Dive Site Id
@@ -222,6 +272,9 @@ protected:
 	//! Perform Operations after Loading a Persistent
 	virtual void afterLoaded(Persistent::Ptr o);
 
+	//! Load the Tags of a Batch of Dives with one Query
+	virtual void afterLoadedAll(const Batch & objects);
+
 protected:
 
 	//! Bind an Object to the Insert Statement
@@ -231,7 +284,16 @@ protected:
 	virtual void bindUpdate(statement::ptr s, Persistent::Ptr o) const;
 
 	//! Load an Object from a Result Set
-	virtual Dive::Ptr doLoad(int64_t id, dbapi::cursor::row_t r) const;
+	virtual Dive::Ptr doLoad(int64_t id, const dbapi::cursor::row_view & r) const;
+
+	//! @return Column List for SELECT Statements
+	virtual std::string selectColumns() const;
+
+	//! @return Mapped Table Name
+	virtual std::string tableName() const;
+
+	//! @return Updatable Columns
+	virtual const column_def * updateColumns() const;
 
 protected:
 	dbapi::statement::ptr		m_find_all_stmt;		///< Find All Prepared Statement
@@ -44,6 +44,22 @@ std::string DiveSiteMapper::sql_update = "update sites set name=?2, place=?3, co
 		"platform=?7, waterbody=?8, bottom=?9, altitude=?10, salinity=?11, timezone=?12, comments=?13 where id=?1";
 std::string DiveSiteMapper::sql_delete = "delete from sites where id=?1";
 
+const AbstractMapper::column_def DiveSiteMapper::update_columns[] = {
+	{ "name", "name=?2" },
+	{ "place", "place=?3" },
+	{ "country", "country=?4" },
+	{ "latitude", "latitude=?5" },
+	{ "longitude", "longitude=?6" },
+	{ "platform", "platform=?7" },
+	{ "water_body", "waterbody=?8" },
+	{ "bottom", "bottom=?9" },
+	{ "altitude", "altitude=?10" },
+	{ "salinity", "salinity=?11" },
+	{ "timezone", "timezone=?12" },
+	{ "comments", "comments=?13" },
+	{ NULL, NULL }
+};
+
 std::string DiveSiteMapper::sql_find_all = "select " + columns + " from sites";
 std::string DiveSiteMapper::sql_find_id = "select " + columns + " from sites where id=?1";
 
@@ -101,43 +117,63 @@ void DiveSiteMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 	s->bind(13, o->comments());
 }
 
+bool DiveSiteMapper::cacheable() const
+{
+	return true;
+}
+
 std::list<Persistent::Ptr> DiveSiteMapper::cascade_add(Persistent::Ptr p)
 {
 	return std::list<Persistent::Ptr>();
 }
 
-#define SET_VARIANT(o, f, v, t) if ((v).is_null()) o->f(boost::none); else o->f(v.as<t>())
+#define SET_COLUMN(o, f, r, i, t) if ((r).is_null(i)) o->f(boost::none); else o->f((r).as<t >(i))
 
-DiveSite::Ptr DiveSiteMapper::doLoad(int64_t id, cursor::row_t r) const
+DiveSite::Ptr DiveSiteMapper::doLoad(int64_t id, const cursor::row_view & r) const
 {
 	DiveSite::Ptr o(new logbook::DiveSite);
 
 	mark_persistent_loading(o);
 
 	set_persistent_id(o, id);
-	o->setName(r[1].as<std::string>());
+	o->setName(r.as<std::string>(1));
 
-	SET_VARIANT(o, setPlace, r[2], std::string);
+	SET_COLUMN(o, setPlace, r, 2, std::string);
 
 	// Country type is special case
-	if (r[3].is_null())
+	if (r.is_null(3))
 		o->setCountry(boost::none);
 	else
-		o->setCountry(country(r[3].as<std::string>()));
-
-	SET_VARIANT(o, setLatitude, r[4], double);
-	SET_VARIANT(o, setLongitude, r[5], double);
-	SET_VARIANT(o, setPlatform, r[6], std::string);
-	SET_VARIANT(o, setWaterBody, r[7], std::string);
-	SET_VARIANT(o, setBottom, r[8], std::string);
-	SET_VARIANT(o, setAltitude, r[9], double);
-	SET_VARIANT(o, setSalinity, r[10], std::string);
-	SET_VARIANT(o, setTimezone, r[11], std::string);
-	SET_VARIANT(o, setComments, r[12], std::string);
+		o->setCountry(country(r.as<std::string>(3)));
+
+	SET_COLUMN(o, setLatitude, r, 4, double);
+	SET_COLUMN(o, setLongitude, r, 5, double);
+	SET_COLUMN(o, setPlatform, r, 6, std::string);
+	SET_COLUMN(o, setWaterBody, r, 7, std::string);
+	SET_COLUMN(o, setBottom, r, 8, std::string);
+	SET_COLUMN(o, setAltitude, r, 9, double);
+	SET_COLUMN(o, setSalinity, r, 10, std::string);
+	SET_COLUMN(o, setTimezone, r, 11, std::string);
+	SET_COLUMN(o, setComments, r, 12, std::string);
 
 	return o;
 }
 
+std::string DiveSiteMapper::selectColumns() const
+{
+	return columns;
+}
+
+std::string DiveSiteMapper::tableName() const
+{
+	return "sites";
+}
+
+const AbstractMapper::column_def * DiveSiteMapper::updateColumns() const
+{
+	return update_columns;
+}
+
 std::vector<DiveSite::Ptr> DiveSiteMapper::find()
 {
 	m_find_all_stmt->reset();
@@ -146,31 +182,31 @@ std::vector<DiveSite::Ptr> DiveSiteMapper::find()
 	return loadAll(c);
 }
 
-DiveSite::Ptr DiveSiteMapper::find(int64_t id)
+void DiveSiteMapper::find(IFinder<DiveSite>::Visitor v)
 {
-	m_find_id_stmt->reset();
-	m_find_id_stmt->bind(1, id);
+	m_find_all_stmt->reset();
+	dbapi::cursor::ptr c = m_find_all_stmt->exec();
 
-	dbapi::cursor::ptr c = m_find_id_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::DiveSite::Ptr();
+	loadEach(c, v);
+}
 
-	return load(r);
+DiveSite::Ptr DiveSiteMapper::find(int64_t id)
+{
+	return findById(id, m_find_id_stmt);
 }
 
 std::vector<country> DiveSiteMapper::countries() const
 {
+	m_distinct_countries_stmt->reset();
 	dbapi::cursor::ptr c = m_distinct_countries_stmt->exec();
 	std::vector<country> result;
 
-	std::vector<dbapi::cursor::row_t> rows = c->fetchall();
-	std::vector<dbapi::cursor::row_t>::const_iterator it;
-	for (it = rows.begin(); it != rows.end(); it++)
+	dbapi::cursor::iterator it;
+	for (it = c->begin(); it != c->end(); ++it)
 	{
 		try
 		{
-			result.push_back(country((* it)[0].get<std::string>()));
+			result.push_back(country(it->as<std::string>(0)));
 		}
 		catch (std::exception & e)
 		{
@@ -182,45 +218,39 @@ std::vector<country> DiveSiteMapper::countries() const
 
 std::vector<std::string> DiveSiteMapper::bottomValues() const
 {
+	m_distinct_bottom_stmt->reset();
 	dbapi::cursor::ptr c = m_distinct_bottom_stmt->exec();
 	std::vector<std::string> result;
 
-	std::vector<dbapi::cursor::row_t> rows = c->fetchall();
-	std::vector<dbapi::cursor::row_t>::const_iterator it;
-	for (it = rows.begin(); it != rows.end(); it++)
-	{
-		result.push_back((* it)[0].get<std::string>());
-	}
+	dbapi::cursor::iterator it;
+	for (it = c->begin(); it != c->end(); ++it)
+		result.push_back(it->as<std::string>(0));
 
 	return result;
 }
 
 std::vector<std::string> DiveSiteMapper::platformValues() const
 {
+	m_distinct_platform_stmt->reset();
 	dbapi::cursor::ptr c = m_distinct_platform_stmt->exec();
 	std::vector<std::string> result;
 
-	std::vector<dbapi::cursor::row_t> rows = c->fetchall();
-	std::vector<dbapi::cursor::row_t>::const_iterator it;
-	for (it = rows.begin(); it != rows.end(); it++)
-	{
-		result.push_back((* it)[0].get<std::string>());
-	}
+	dbapi::cursor::iterator it;
+	for (it = c->begin(); it != c->end(); ++it)
+		result.push_back(it->as<std::string>(0));
 
 	return result;
 }
 
 std::vector<std::string> DiveSiteMapper::waterBodyValues() const
 {
+	m_distinct_waterbody_stmt->reset();
 	dbapi::cursor::ptr c = m_distinct_waterbody_stmt->exec();
 	std::vector<std::string> result;
 
-	std::vector<dbapi::cursor::row_t> rows = c->fetchall();
-	std::vector<dbapi::cursor::row_t>::const_iterator it;
-	for (it = rows.begin(); it != rows.end(); it++)
-	{
-		result.push_back((* it)[0].get<std::string>());
-	}
+	dbapi::cursor::iterator it;
+	for (it = c->begin(); it != c->end(); ++it)
+		result.push_back(it->as<std::string>(0));
 
 	return result;
 }
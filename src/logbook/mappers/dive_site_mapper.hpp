@@ -63,6 +63,8 @@ protected:
 	static std::string sql_update;		///< UPDATE Statement SQL String
 	static std::string sql_delete;		///< DELETE Statement SQL String
 
+	static const column_def update_columns[];	///< Columns for Partial UPDATE Statements
+
 	static std::string sql_find_all;	///< Find All Statement SQL String
 	static std::string sql_find_id;		///< Find By Id Statement SQL String
 
@@ -96,6 +98,12 @@ public:
 	 */
 	virtual std::vector<DiveSite::Ptr> find();
 
+	/**
+	 * @brief Visit all Mapped Objects without building a List
+	 * @param[in] Visitor Function
+	 */
+	virtual void find(IFinder<DiveSite>::Visitor v);
+
 	/**
 	 * @brief Return a single Dive Site by its identifier
 	 * @param[in] Identifier
@@ -123,8 +131,20 @@ protected:
 	//! Bind an Object to the Update Statement
 	virtual void bindUpdate(statement::ptr s, Persistent::Ptr o) const;
 
+	//! @return True; Dive Site rows are kept in the Reference Cache
+	virtual bool cacheable() const;
+
 	//! Load an Object from a Result Set
-	virtual DiveSite::Ptr doLoad(int64_t id, dbapi::cursor::row_t r) const;
+	virtual DiveSite::Ptr doLoad(int64_t id, const dbapi::cursor::row_view & r) const;
+
+	//! @return Column List for SELECT Statements
+	virtual std::string selectColumns() const;
+
+	//! @return Mapped Table Name
+	virtual std::string tableName() const;
+
+	//! @return Updatable Columns
+	virtual const column_def * updateColumns() const;
 
 protected:
 	dbapi::statement::ptr		m_find_all_stmt;			///< Find All Prepared Statement
@@ -40,6 +40,16 @@ std::string DiveTankMapper::sql_insert = "insert into divetanks values (?1, ?2,
 std::string DiveTankMapper::sql_update = "update divetanks set dive_id=?2, tank_idx=?3, tank_id=?4, mix_id=?5, px_start=?6, px_end=?7 where id=?1";
 std::string DiveTankMapper::sql_delete = "delete from divetanks where id=?1";
 
+const AbstractMapper::column_def DiveTankMapper::update_columns[] = {
+	{ "dive", "dive_id=?2" },
+	{ "index", "tank_idx=?3" },
+	{ "tank", "tank_id=?4" },
+	{ "mix", "mix_id=?5" },
+	{ "start_pressure", "px_start=?6" },
+	{ "end_pressure", "px_end=?7" },
+	{ NULL, NULL }
+};
+
 std::string DiveTankMapper::sql_find_all = "select " + columns + " from divetanks";
 std::string DiveTankMapper::sql_find_id = "select " + columns + " from divetanks where id=?1";
 std::string DiveTankMapper::sql_find_dive = "select " + columns + " from divetanks where dive_id=?1 order by tank_idx";
@@ -71,53 +81,81 @@ void DiveTankMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 {
 	DiveTank::Ptr o = downcast(p);
 
-	s->bind(2, o->dive()->id());
+	s->bind(2, o->reference("dive")->id());
 	s->bind(3, o->index());
 
-	if (o->tank())
-		s->bind(4, o->tank()->id());
-	else
-		s->bind(4, boost::none);
-
-	if (o->mix())
-		s->bind(5, o->mix()->id());
-	else
-		s->bind(5, boost::none);
-
+	s->bind(4, o->reference("tank")->id());
+	s->bind(5, o->reference("mix")->id());
 	s->bind(6, o->start_pressure());
 	s->bind(7, o->end_pressure());
 }
 
-#define SET_VARIANT(o, f, v, t) if ((v).is_null()) o->f(boost::none); else o->f(v.as<t>())
+#define SET_COLUMN(o, f, r, i, t) if ((r).is_null(i)) o->f(boost::none); else o->f((r).as<t >(i))
 
-DiveTank::Ptr DiveTankMapper::doLoad(int64_t id, cursor::row_t r) const
+std::vector<const std::type_info *> DiveTankMapper::dependencies() const
 {
-	IFinder<Dive>::Ptr dive_finder(m_session.lock()->finder<Dive>());
-	IFinder<Mix>::Ptr mix_finder(m_session.lock()->finder<Mix>());
-	IFinder<Tank>::Ptr tank_finder(m_session.lock()->finder<Tank>());
+	std::vector<const std::type_info *> result;
+	result.push_back(& typeid(Dive));
+	result.push_back(& typeid(Mix));
+	result.push_back(& typeid(Tank));
+	return result;
+}
 
-	DiveTank::Ptr o(new logbook::DiveTank(dive_finder->find(r[1].as<int64_t>())));
+DiveTank::Ptr DiveTankMapper::doLoad(int64_t id, const cursor::row_view & r) const
+{
+	DiveTank::Ptr o(new logbook::DiveTank(Dive::Ptr()));
 
 	mark_persistent_loading(o);
 	set_persistent_id(o, id);
-	o->setIndex(r[2].as<int>());
+	deferReference(o, "dive", r.as<int64_t>(1));
+	o->setIndex(r.as<int>(2));
 
-	if (r[3].is_null())
+	if (r.is_null(3))
 		o->setTank(boost::none);
 	else
-		o->setTank(tank_finder->find(r[3].as<int64_t>()));
+		deferReference(o, "tank", r.as<int64_t>(3));
 
-	if (r[4].is_null())
+	if (r.is_null(4))
 		o->setMix(boost::none);
 	else
-		o->setMix(mix_finder->find(r[4].as<int64_t>()));
+		deferReference(o, "mix", r.as<int64_t>(4));
 
-	SET_VARIANT(o, setStartPressure, r[5], double);
-	SET_VARIANT(o, setEndPressure, r[6], double);
+	SET_COLUMN(o, setStartPressure, r, 5, double);
+	SET_COLUMN(o, setEndPressure, r, 6, double);
 
 	return o;
 }
 
+std::list<Persistent::Ptr> DiveTankMapper::references(Persistent::Ptr p)
+{
+	std::list<Persistent::Ptr> result;
+	DiveTank::Ptr o = downcast(p);
+
+	if (! o)
+		return result;
+
+	appendLoaded(result, o, "dive");
+	appendLoaded(result, o, "mix");
+	appendLoaded(result, o, "tank");
+
+	return result;
+}
+
+std::string DiveTankMapper::selectColumns() const
+{
+	return columns;
+}
+
+std::string DiveTankMapper::tableName() const
+{
+	return "divetanks";
+}
+
+const AbstractMapper::column_def * DiveTankMapper::updateColumns() const
+{
+	return update_columns;
+}
+
 std::vector<DiveTank::Ptr> DiveTankMapper::find()
 {
 	m_find_all_stmt->reset();
@@ -126,17 +164,21 @@ std::vector<DiveTank::Ptr> DiveTankMapper::find()
 	return loadAll(c);
 }
 
+void DiveTankMapper::find(IFinder<DiveTank>::Visitor v)
+{
+	m_find_all_stmt->reset();
+	dbapi::cursor::ptr c = m_find_all_stmt->exec();
+
+	loadEach(c, v);
+}
+
 DiveTank::Ptr DiveTankMapper::find(int64_t id)
 {
 	m_find_id_stmt->reset();
 	m_find_id_stmt->bind(1, id);
 
 	dbapi::cursor::ptr c = m_find_id_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::DiveTank::Ptr();
-
-	return load(r);
+	return loadOne(c);
 }
 
 std::vector<DiveTank::Ptr> DiveTankMapper::findByDive(int64_t dive_id)
@@ -63,6 +63,8 @@ protected:
 	static std::string sql_update;		///< UPDATE Statement SQL String
 	static std::string sql_delete;		///< DELETE Statement SQL String
 
+	static const column_def update_columns[];	///< Columns for Partial UPDATE Statements
+
 	static std::string sql_find_all;	///< Find All Statement SQL String
 	static std::string sql_find_id;		///< Find By Id Statement SQL String
 	static std::string sql_find_dive;	///< Find By Dive Statement SQL String
@@ -76,6 +78,21 @@ public:
 	//! Class Destructor
 	virtual ~DiveTankMapper();
 
+public:
+
+	/**
+	 * @brief Return the Domain Model Classes this Mapper depends on
+	 * @return List of Referenced Classes
+	 */
+	virtual std::vector<const std::type_info *> dependencies() const;
+
+	/**
+	 * @brief Return the Persistent Objects referenced by an Object
+	 * @param[in] Domain Object
+	 * @return List of Referenced Objects
+	 */
+	virtual std::list<Persistent::Ptr> references(Persistent::Ptr o);
+
 public:
 
 	/**
@@ -84,6 +101,12 @@ public:
 	 */
 	virtual std::vector<DiveTank::Ptr> find();
 
+	/**
+	 * @brief Visit all Mapped Objects without building a List
+	 * @param[in] Visitor Function
+	 */
+	virtual void find(IFinder<DiveTank>::Visitor v);
+
 	/**
 	 * @brief Return a single Tank by its identifier
 	 * @param[in] Identifier
@@ -112,7 +135,16 @@ protected:
 	virtual void bindUpdate(statement::ptr s, Persistent::Ptr o) const;
 
 	//! Load an Object from a Result Set
-	virtual DiveTank::Ptr doLoad(int64_t id, dbapi::cursor::row_t r) const;
+	virtual DiveTank::Ptr doLoad(int64_t id, const dbapi::cursor::row_view & r) const;
+
+	//! @return Column List for SELECT Statements
+	virtual std::string selectColumns() const;
+
+	//! @return Mapped Table Name
+	virtual std::string tableName() const;
+
+	//! @return Updatable Columns
+	virtual const column_def * updateColumns() const;
 
 protected:
 	dbapi::statement::ptr		m_find_all_stmt;		///< Find All Prepared Statement
@@ -39,6 +39,15 @@ std::string MixMapper::sql_insert = "insert into mixes values (?1, ?2, ?3, ?4, ?
 std::string MixMapper::sql_update = "update mixes set name=?2, o2=?3, he=?4, h2=?5, ar=?6 where id=?1";
 std::string MixMapper::sql_delete = "delete from mixes where id=?1";
 
+const AbstractMapper::column_def MixMapper::update_columns[] = {
+	{ "name", "name=?2" },
+	{ "o2_permil", "o2=?3" },
+	{ "he_permil", "he=?4" },
+	{ "h2_permil", "h2=?5" },
+	{ "ar_permil", "ar=?6" },
+	{ NULL, NULL }
+};
+
 std::string MixMapper::sql_find_all = "select " + columns + " from mixes";
 std::string MixMapper::sql_find_id = "select " + columns + " from mixes where id=?1";
 std::string MixMapper::sql_find_name = "select " + columns + " from mixes where upper(name) = upper(?1)";
@@ -77,25 +86,45 @@ void MixMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 	s->bind(6, (int)o->ar_permil());
 }
 
-#define SET_VARIANT(o, f, v, t) if ((v).is_null()) o->f(boost::none); else o->f(v.as<t>())
+bool MixMapper::cacheable() const
+{
+	return true;
+}
+
+#define SET_COLUMN(o, f, r, i, t) if ((r).is_null(i)) o->f(boost::none); else o->f((r).as<t >(i))
 
-Mix::Ptr MixMapper::doLoad(int64_t id, cursor::row_t r) const
+Mix::Ptr MixMapper::doLoad(int64_t id, const cursor::row_view & r) const
 {
 	Mix::Ptr o(new logbook::Mix);
 
 	mark_persistent_loading(o);
 
 	set_persistent_id(o, id);
-	SET_VARIANT(o, setName, r[1], std::string);
+	SET_COLUMN(o, setName, r, 1, std::string);
 
-	o->setO2PerMil(r[2].as<int>());
-	o->setHePerMil(r[3].as<int>());
-	o->setH2PerMil(r[4].as<int>());
-	o->setArPerMil(r[5].as<int>());
+	o->setO2PerMil(r.as<int>(2));
+	o->setHePerMil(r.as<int>(3));
+	o->setH2PerMil(r.as<int>(4));
+	o->setArPerMil(r.as<int>(5));
 
 	return o;
 }
 
+std::string MixMapper::selectColumns() const
+{
+	return columns;
+}
+
+std::string MixMapper::tableName() const
+{
+	return "mixes";
+}
+
+const AbstractMapper::column_def * MixMapper::updateColumns() const
+{
+	return update_columns;
+}
+
 std::vector<Mix::Ptr> MixMapper::find()
 {
 	m_find_all_stmt->reset();
@@ -104,17 +133,17 @@ std::vector<Mix::Ptr> MixMapper::find()
 	return loadAll(c);
 }
 
-Mix::Ptr MixMapper::find(int64_t id)
+void MixMapper::find(IFinder<Mix>::Visitor v)
 {
-	m_find_id_stmt->reset();
-	m_find_id_stmt->bind(1, id);
+	m_find_all_stmt->reset();
+	dbapi::cursor::ptr c = m_find_all_stmt->exec();
 
-	dbapi::cursor::ptr c = m_find_id_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::Mix::Ptr();
+	loadEach(c, v);
+}
 
-	return load(r);
+Mix::Ptr MixMapper::find(int64_t id)
+{
+	return findById(id, m_find_id_stmt);
 }
 
 Mix::Ptr MixMapper::findByName(const std::string & name)
@@ -123,11 +152,7 @@ Mix::Ptr MixMapper::findByName(const std::string & name)
 	m_find_name_stmt->bind(1, name);
 
 	dbapi::cursor::ptr c = m_find_name_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::Mix::Ptr();
-
-	return load(r);
+	return loadOne(c);
 }
 
 Mix::Ptr MixMapper::findByMix(unsigned int pmO2, unsigned int pmHe)
@@ -137,9 +162,5 @@ Mix::Ptr MixMapper::findByMix(unsigned int pmO2, unsigned int pmHe)
 	m_find_mix_stmt->bind(2, (int)pmHe);
 
 	dbapi::cursor::ptr c = m_find_mix_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::Mix::Ptr();
-
-	return load(r);
+	return loadOne(c);
 }
@@ -30,8 +30,13 @@
 
 #include "profile_mapper.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <set>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include <yajl/yajl_parse.h>
 #include <yajl/yajl_gen.h>
@@ -41,13 +46,24 @@
 using namespace benthos::logbook;
 using namespace benthos::logbook::mappers;
 
-std::string ProfileMapper::columns = "id, dive_id, computer_id, name, profile, vendor, imported, raw_profile";
+std::string ProfileMapper::columns = "id, dive_id, computer_id, name, profile, vendor, imported, length(raw_profile)";
 
 std::string ProfileMapper::sql_insert = "insert into profiles values (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8)";
 std::string ProfileMapper::sql_update = "update profiles set dive_id=?2, computer_id=?3, name=?4, "
-		"profile=?5, vendor=?6, imported=?7, raw_profile=?8 where id=?1";
+		"profile=?5, vendor=?6, imported=?7, raw_profile=case ?9 when 0 then raw_profile else ?8 end where id=?1";
 std::string ProfileMapper::sql_delete = "delete from profiles where id=?1";
 
+const AbstractMapper::column_def ProfileMapper::update_columns[] = {
+	{ "dive", "dive_id=?2" },
+	{ "computer", "computer_id=?3" },
+	{ "name", "name=?4" },
+	{ "profile", "profile=?5" },
+	{ "vendor", "vendor=?6" },
+	{ "imported", "imported=?7" },
+	{ "raw_profile", "raw_profile=?8" },
+	{ NULL, NULL }
+};
+
 std::string ProfileMapper::sql_find_all = "select " + columns + " from profiles";
 std::string ProfileMapper::sql_find_id = "select " + columns + " from profiles where id=?1";
 std::string ProfileMapper::sql_find_dive = "select " + columns + " from profiles where dive_id=?1";
@@ -64,40 +80,53 @@ ProfileMapper::ProfileMapper(boost::shared_ptr<Session> session)
 	m_find_id_stmt = statement::ptr(new statement(m_conn, sql_find_id));
 	m_find_dive_stmt = statement::ptr(new statement(m_conn, sql_find_dive));
 	m_find_computer_stmt = statement::ptr(new statement(m_conn, sql_find_computer));
+
+	// Connections are shared between Sessions, so only register once
+	if (! m_conn->has_function("profile_max_depth", 1))
+		registerFunctions(m_conn);
 }
 
 ProfileMapper::~ProfileMapper()
 {
 }
 
+void ProfileMapper::bindColumns(statement::ptr s, Profile::Ptr o, bool changed_only) const
+{
+	s->bind(2, o->reference("dive")->id());
+	s->bind(3, o->reference("computer")->id());
+
+	/*
+	 * The JSON document is handed to SQLite without copying it again.  It is
+	 * not needed by a partial update which leaves the profile column alone.
+	 */
+	if (o->profile().empty() || (changed_only && ! o->is_changed("profile")))
+		s->bind(5);
+	else
+		s->bind_shared(5, boost::shared_ptr<const std::string>(new std::string(profileToJSON(o->profile()))));
+
+	s->bind_static(4, o->name());
+	s->bind_static(6, o->vendor());
+	s->bind(7, o->imported());
+
+	// Bound in place; the Profile outlives the statement execution
+	if (o->rawProfileLoaded())
+		s->bind_static(8, o->raw_profile());
+	else
+		s->bind(8);
+}
+
 void ProfileMapper::bindInsert(statement::ptr s, Persistent::Ptr p) const
 {
-	bindUpdate(s, p);
+	bindColumns(s, downcast(p), false);
 }
 
 void ProfileMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 {
 	Profile::Ptr o = downcast(p);
+	bindColumns(s, o, true);
 
-	if (o->dive())
-		s->bind(2, o->dive()->id());
-	else
-		s->bind(2);
-
-	if (o->computer())
-		s->bind(3, o->computer()->id());
-	else
-		s->bind(3);
-
-	if (o->profile().empty())
-		s->bind(5);
-	else
-		s->bind(5, profileToJSON(o->profile()));
-
-	s->bind(4, o->name());
-	s->bind(6, o->vendor());
-	s->bind(7, o->imported());
-	s->bind(8, o->raw_profile());
+	// Leave the stored Raw Profile alone unless it was read or replaced
+	s->bind(9, o->rawProfileLoaded() ? 1 : 0);
 }
 
 std::list<Persistent::Ptr> ProfileMapper::cascade_add(Persistent::Ptr p)
@@ -108,10 +137,8 @@ std::list<Persistent::Ptr> ProfileMapper::cascade_add(Persistent::Ptr p)
 	if (! o)
 		return result;
 
-	if (o->computer())
-		result.push_back(o->computer());
-	if (o->dive())
-		result.push_back(o->dive());
+	appendLoaded(result, o, "computer");
+	appendLoaded(result, o, "dive");
 
 	std::set<Mix::Ptr> mixes;
 	std::list<waypoint>::const_iterator it;
@@ -125,42 +152,87 @@ std::list<Persistent::Ptr> ProfileMapper::cascade_add(Persistent::Ptr p)
 	return result;
 }
 
-#define SET_VARIANT(o, f, v, t) if ((v).is_null()) o->f(boost::none); else o->f(v.as<t >())
+std::vector<const std::type_info *> ProfileMapper::dependencies() const
+{
+	// Waypoints reference Mixes by identifier within the serialized profile
+	std::vector<const std::type_info *> result;
+	result.push_back(& typeid(Dive));
+	result.push_back(& typeid(DiveComputer));
+	result.push_back(& typeid(Mix));
+	return result;
+}
 
-Profile::Ptr ProfileMapper::doLoad(int64_t id, cursor::row_t r) const
+#define SET_COLUMN(o, f, r, i, t) if ((r).is_null(i)) o->f(boost::none); else o->f((r).as<t >(i))
+
+Profile::Ptr ProfileMapper::doLoad(int64_t id, const cursor::row_view & r) const
 {
 	Profile::Ptr o(new logbook::Profile);
 
 	mark_persistent_loading(o);
 
-	IFinder<Dive>::Ptr dive_finder(m_session.lock()->finder<Dive>());
-	IFinder<DiveComputer>::Ptr cmp_finder(m_session.lock()->finder<DiveComputer>());
-
 	set_persistent_id(o, id);
 
-	if (r[1].is_null())
+	if (r.is_null(1))
 		o->setDive(boost::none);
 	else
-		o->setDive(dive_finder->find(r[1].as<int64_t>()));
+		deferReference(o, "dive", r.as<int64_t>(1));
 
-	if (r[2].is_null())
+	if (r.is_null(2))
 		o->setComputer(boost::none);
 	else
-		o->setComputer(cmp_finder->find(r[2].as<int64_t>()));
+		deferReference(o, "computer", r.as<int64_t>(2));
 
-	if (r[4].is_null())
+	if (r.is_null(4))
 		o->setProfile(boost::none);
 	else
-		o->setProfile(profileFromJSON(r[4].as<std::string>()));
+		o->setProfile(profileFromJSON(r.text(4)));
 
-	SET_VARIANT(o, setName, r[3], std::string);
-	SET_VARIANT(o, setVendor, r[5], std::string);
-	SET_VARIANT(o, setImported, r[6], time_t);
-	SET_VARIANT(o, setRawProfile, r[7], std::vector<unsigned char>);
+	SET_COLUMN(o, setName, r, 3, std::string);
+	SET_COLUMN(o, setVendor, r, 5, std::string);
+	SET_COLUMN(o, setImported, r, 6, time_t);
+
+	// Raw Profile is only read from the database on demand
+	o->deferRawProfile(r.is_null(7) ? 0 : r.as<int64_t>(7));
 
 	return o;
 }
 
+std::list<Persistent::Ptr> ProfileMapper::references(Persistent::Ptr p)
+{
+	std::list<Persistent::Ptr> result;
+	Profile::Ptr o = downcast(p);
+
+	if (! o)
+		return result;
+
+	appendLoaded(result, o, "computer");
+	appendLoaded(result, o, "dive");
+
+	std::set<Mix::Ptr> mixes;
+	std::list<waypoint>::const_iterator it;
+	for (it = o->profile().begin(); it != o->profile().end(); it++)
+		if (it->mix)
+			mixes.insert(it->mix);
+
+	result.insert(result.end(), mixes.begin(), mixes.end());
+	return result;
+}
+
+std::string ProfileMapper::selectColumns() const
+{
+	return columns;
+}
+
+std::string ProfileMapper::tableName() const
+{
+	return "profiles";
+}
+
+const AbstractMapper::column_def * ProfileMapper::updateColumns() const
+{
+	return update_columns;
+}
+
 std::vector<Profile::Ptr> ProfileMapper::find()
 {
 	m_find_all_stmt->reset();
@@ -169,17 +241,21 @@ std::vector<Profile::Ptr> ProfileMapper::find()
 	return loadAll(c);
 }
 
+void ProfileMapper::find(IFinder<Profile>::Visitor v)
+{
+	m_find_all_stmt->reset();
+	dbapi::cursor::ptr c = m_find_all_stmt->exec();
+
+	loadEach(c, v);
+}
+
 Profile::Ptr ProfileMapper::find(int64_t id)
 {
 	m_find_id_stmt->reset();
 	m_find_id_stmt->bind(1, id);
 
 	dbapi::cursor::ptr c = m_find_id_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::Profile::Ptr();
-
-	return load(r);
+	return loadOne(c);
 }
 
 std::vector<Profile::Ptr> ProfileMapper::findByDive(int64_t dive_id)
@@ -529,7 +605,7 @@ std::string ProfileMapper::profileToJSON(const std::list<waypoint> & profile) co
 	return result;
 }
 
-std::list<waypoint> ProfileMapper::profileFromJSON(const std::string & json) const
+std::list<waypoint> ProfileMapper::profileFromJSON(const dbapi::text_ref & json) const
 {
 	std::list<waypoint> profile;
 	pfj_parse_context ctx;
@@ -547,7 +623,7 @@ std::list<waypoint> ProfileMapper::profileFromJSON(const std::string & json) con
 	ctx.err = "";
 
 	yajl_handle hand = yajl_alloc(& pfj_cb, NULL, & ctx);
-	yajl_status stat = yajl_parse(hand, (const unsigned char *)json.c_str(), json.size());
+	yajl_status stat = yajl_parse(hand, (const unsigned char *)json.data, json.size);
 
 	if (stat != yajl_status_ok)
 	{
@@ -567,3 +643,244 @@ std::list<waypoint> ProfileMapper::profileFromJSON(const std::string & json) con
 
 	return profile;
 }
+
+/*
+ * Profile Statistics SQL Functions
+ *
+ * These functions compute statistics directly from the JSON profile column
+ * so that queries such as "select max(profile_max_depth(profile)) from
+ * profiles" run inside SQLite without loading Profile objects.  The parser
+ * below only extracts the time and depth of each waypoint and does not look
+ * up mixes, so it is much cheaper than profileFromJSON().
+ */
+
+typedef std::vector<std::pair<double, double> > depth_samples;
+
+struct pds_parse_context
+{
+	depth_samples *		samples;
+	std::string			cur_key;
+	int					level;
+
+	double				time;
+	double				depth;
+	bool				hasTime;
+	bool				hasDepth;
+};
+
+int pds_parse_number(pds_parse_context * jctx, double v)
+{
+	// Only direct members of a waypoint are of interest
+	if (jctx->level != 2)
+		return 1;
+
+	if (jctx->cur_key == "time")
+	{
+		jctx->time = v;
+		jctx->hasTime = true;
+	}
+	else if (jctx->cur_key == "depth")
+	{
+		jctx->depth = v;
+		jctx->hasDepth = true;
+	}
+
+	return 1;
+}
+
+int pds_parse_int(void * ctx, long long i)
+{
+	return pds_parse_number((pds_parse_context *)(ctx), (double)i);
+}
+
+int pds_parse_dbl(void * ctx, double d)
+{
+	return pds_parse_number((pds_parse_context *)(ctx), d);
+}
+
+int pds_start_container(void * ctx)
+{
+	pds_parse_context * jctx = (pds_parse_context *)(ctx);
+
+	jctx->level++;
+	if (jctx->level == 2)
+	{
+		jctx->hasTime = false;
+		jctx->hasDepth = false;
+	}
+
+	return 1;
+}
+
+int pds_map_key(void * ctx, const unsigned char * stringVal, size_t stringLen)
+{
+	pds_parse_context * jctx = (pds_parse_context *)(ctx);
+
+	jctx->cur_key.assign((const char *)stringVal, stringLen);
+	for (size_t i = 0; i < jctx->cur_key.size(); i++)
+		jctx->cur_key[i] = tolower(jctx->cur_key[i]);
+
+	return 1;
+}
+
+int pds_end_map(void * ctx)
+{
+	pds_parse_context * jctx = (pds_parse_context *)(ctx);
+
+	if ((jctx->level == 2) && jctx->hasTime && jctx->hasDepth)
+		jctx->samples->push_back(std::make_pair(jctx->time, jctx->depth));
+
+	jctx->level--;
+	return 1;
+}
+
+int pds_end_array(void * ctx)
+{
+	pds_parse_context * jctx = (pds_parse_context *)(ctx);
+
+	jctx->level--;
+	return 1;
+}
+
+static yajl_callbacks pds_cb = {
+	NULL,
+	NULL,
+	pds_parse_int,
+	pds_parse_dbl,
+	NULL,
+	NULL,
+	pds_start_container,
+	pds_map_key,
+	pds_end_map,
+	pds_start_container,
+	pds_end_array
+};
+
+//! Read the (time, depth) Samples from a JSON Profile
+static depth_samples pds_read(const dbapi::text_ref & json)
+{
+	depth_samples samples;
+	if (! json.data || (json.size == 0))
+		return samples;
+
+	pds_parse_context ctx;
+	ctx.samples = & samples;
+	ctx.level = 0;
+	ctx.time = 0;
+	ctx.depth = 0;
+	ctx.hasTime = false;
+	ctx.hasDepth = false;
+
+	yajl_handle hand = yajl_alloc(& pds_cb, NULL, & ctx);
+	yajl_status stat = yajl_parse(hand, (const unsigned char *)json.data, json.size);
+	if (stat == yajl_status_ok)
+		stat = yajl_complete_parse(hand);
+	yajl_free(hand);
+
+	if (stat != yajl_status_ok)
+		throw std::runtime_error("Failed to parse JSON profile data: " + std::string(yajl_status_to_string(stat)));
+
+	return samples;
+}
+
+//! Maximum Depth of a Profile
+static boost::optional<double> profile_max_depth(const dbapi::text_ref & json)
+{
+	depth_samples s = pds_read(json);
+	if (s.empty())
+		return boost::none;
+
+	double result = s[0].second;
+	for (size_t i = 1; i < s.size(); i++)
+		result = std::max(result, s[i].second);
+
+	return result;
+}
+
+//! Time-Weighted Average Depth of a Profile
+static boost::optional<double> profile_avg_depth(const dbapi::text_ref & json)
+{
+	depth_samples s = pds_read(json);
+	if (s.empty())
+		return boost::none;
+	if (s.size() == 1)
+		return s[0].second;
+
+	double area = 0;
+	for (size_t i = 1; i < s.size(); i++)
+		area += (s[i].first - s[i - 1].first) * (s[i].second + s[i - 1].second) / 2;
+
+	double duration = s.back().first - s.front().first;
+	if (duration <= 0)
+		return s[0].second;
+
+	return area / duration;
+}
+
+//! Time between the first and last Samples deeper than a Depth
+static boost::optional<double> profile_bottom_time(const dbapi::text_ref & json, double min_depth)
+{
+	depth_samples s = pds_read(json);
+
+	size_t first = s.size();
+	size_t last = s.size();
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		if (s[i].second > min_depth)
+		{
+			if (first == s.size())
+				first = i;
+			last = i;
+		}
+	}
+
+	if (first == s.size())
+		return boost::none;
+
+	return s[last].first - s[first].first;
+}
+
+//! Time between the first and last Samples below the Surface
+static boost::optional<double> profile_bottom_time_any(const dbapi::text_ref & json)
+{
+	return profile_bottom_time(json, 0);
+}
+
+//! Time spent shallower than a Depth, interpolating between Samples
+static boost::optional<double> profile_time_above(const dbapi::text_ref & json, double depth)
+{
+	depth_samples s = pds_read(json);
+	if (s.empty())
+		return boost::none;
+
+	double result = 0;
+	for (size_t i = 1; i < s.size(); i++)
+	{
+		double dt = s[i].first - s[i - 1].first;
+		double d0 = s[i - 1].second;
+		double d1 = s[i].second;
+
+		if ((d0 < depth) && (d1 < depth))
+			result += dt;
+		else if ((d0 < depth) != (d1 < depth))
+			result += dt * ((d0 < depth) ? (depth - d0) : (depth - d1)) / fabs(d1 - d0);
+	}
+
+	return result;
+}
+
+void ProfileMapper::registerFunctions(dbapi::connection::ptr conn)
+{
+	typedef boost::optional<double> result_t;
+
+	conn->create_function("profile_max_depth",
+		boost::function<result_t (const dbapi::text_ref &)>(profile_max_depth));
+	conn->create_function("profile_avg_depth",
+		boost::function<result_t (const dbapi::text_ref &)>(profile_avg_depth));
+	conn->create_function("profile_bottom_time",
+		boost::function<result_t (const dbapi::text_ref &)>(profile_bottom_time_any));
+	conn->create_function("profile_bottom_time",
+		boost::function<result_t (const dbapi::text_ref &, double)>(profile_bottom_time));
+	conn->create_function("profile_time_above",
+		boost::function<result_t (const dbapi::text_ref &, double)>(profile_time_above));
+}
@@ -63,6 +63,8 @@ protected:
 	static std::string sql_update;			///< UPDATE Statement SQL String
 	static std::string sql_delete;			///< DELETE Statement SQL String
 
+	static const column_def update_columns[];	///< Columns for Partial UPDATE Statements
+
 	static std::string sql_find_all;		///< Find All Statement SQL String
 	static std::string sql_find_id;			///< Find By Id Statement SQL String
 	static std::string sql_find_dive;		///< Find For Dive Statement SQL String
@@ -85,6 +87,19 @@ public:
 	 */
 	virtual std::list<Persistent::Ptr> cascade_add(Persistent::Ptr o);
 
+	/**
+	 * @brief Return the Domain Model Classes this Mapper depends on
+	 * @return List of Referenced Classes
+	 */
+	virtual std::vector<const std::type_info *> dependencies() const;
+
+	/**
+	 * @brief Return the Persistent Objects referenced by an Object
+	 * @param[in] Domain Object
+	 * @return List of Referenced Objects
+	 */
+	virtual std::list<Persistent::Ptr> references(Persistent::Ptr o);
+
 public:
 
 	/**
@@ -93,6 +108,12 @@ public:
 	 */
 	virtual std::vector<Profile::Ptr> find();
 
+	/**
+	 * @brief Visit all Mapped Objects without building a List
+	 * @param[in] Visitor Function
+	 */
+	virtual void find(IFinder<Profile>::Visitor v);
+
 	/**
 	 * @brief Return a single Dive Site by its identifier
 	 * @param[in] Identifier
@@ -122,14 +143,34 @@ protected:
 	//! Bind an Object to the Update Statement
 	virtual void bindUpdate(statement::ptr s, Persistent::Ptr o) const;
 
+	/**
+	 * @brief Bind the Columns common to the Insert and Update Statements
+	 * @param[in] Statement
+	 * @param[in] Profile
+	 * @param[in] Skip serializing the Profile if it has not changed
+	 */
+	void bindColumns(statement::ptr s, Profile::Ptr o, bool changed_only) const;
+
 	//! Load an Object from a Result Set
-	virtual Profile::Ptr doLoad(int64_t id, dbapi::cursor::row_t r) const;
+	virtual Profile::Ptr doLoad(int64_t id, const dbapi::cursor::row_view & r) const;
+
+	//! @return Column List for SELECT Statements
+	virtual std::string selectColumns() const;
+
+	//! @return Mapped Table Name
+	virtual std::string tableName() const;
+
+	//! @return Updatable Columns
+	virtual const column_def * updateColumns() const;
 
 	//! Convert the Profile Data to JSON
 	std::string profileToJSON(const std::list<waypoint> & profile) const;
 
 	//! Convert JSON to Profile Data
-	std::list<waypoint> profileFromJSON(const std::string & json) const;
+	std::list<waypoint> profileFromJSON(const dbapi::text_ref & json) const;
+
+	//! Register the Profile Statistics SQL Functions on a Connection
+	static void registerFunctions(dbapi::connection::ptr conn);
 
 protected:
 	dbapi::statement::ptr		m_find_all_stmt;		///< Find All Prepared Statement
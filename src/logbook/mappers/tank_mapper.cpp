@@ -39,6 +39,14 @@ std::string TankMapper::sql_insert = "insert into tanks values (?1, ?2, ?3, ?4,
 std::string TankMapper::sql_update = "update tanks set name=?2, type=?3, pressure=?4, volume=?5 where id=?1";
 std::string TankMapper::sql_delete = "delete from tanks where id=?1";
 
+const AbstractMapper::column_def TankMapper::update_columns[] = {
+	{ "name", "name=?2" },
+	{ "type", "type=?3" },
+	{ "pressure", "pressure=?4" },
+	{ "volume", "volume=?5" },
+	{ NULL, NULL }
+};
+
 std::string TankMapper::sql_find_all = "select " + columns + " from tanks";
 std::string TankMapper::sql_find_id = "select " + columns + " from tanks where id=?1";
 std::string TankMapper::sql_find_name = "select " + columns + " from tanks where upper(name) = upper(?1)";
@@ -74,24 +82,44 @@ void TankMapper::bindUpdate(statement::ptr s, Persistent::Ptr p) const
 	s->bind(5, o->volume());
 }
 
-#define SET_VARIANT(o, f, v, t) if ((v).is_null()) o->f(boost::none); else o->f(v.as<t>())
+bool TankMapper::cacheable() const
+{
+	return true;
+}
 
-Tank::Ptr TankMapper::doLoad(int64_t id, cursor::row_t r) const
+#define SET_COLUMN(o, f, r, i, t) if ((r).is_null(i)) o->f(boost::none); else o->f((r).as<t >(i))
+
+Tank::Ptr TankMapper::doLoad(int64_t id, const cursor::row_view & r) const
 {
 	Tank::Ptr o(new logbook::Tank);
 
 	mark_persistent_loading(o);
 
 	set_persistent_id(o, id);
-	SET_VARIANT(o, setName, r[1], std::string);
-	SET_VARIANT(o, setType, r[2], std::string);
+	SET_COLUMN(o, setName, r, 1, std::string);
+	SET_COLUMN(o, setType, r, 2, std::string);
 
-	o->setPressure(r[3].as<double>());
-	o->setVolume(r[4].as<double>());
+	o->setPressure(r.as<double>(3));
+	o->setVolume(r.as<double>(4));
 
 	return o;
 }
 
+std::string TankMapper::selectColumns() const
+{
+	return columns;
+}
+
+std::string TankMapper::tableName() const
+{
+	return "tanks";
+}
+
+const AbstractMapper::column_def * TankMapper::updateColumns() const
+{
+	return update_columns;
+}
+
 std::vector<Tank::Ptr> TankMapper::find()
 {
 	m_find_all_stmt->reset();
@@ -100,17 +128,17 @@ std::vector<Tank::Ptr> TankMapper::find()
 	return loadAll(c);
 }
 
-Tank::Ptr TankMapper::find(int64_t id)
+void TankMapper::find(IFinder<Tank>::Visitor v)
 {
-	m_find_id_stmt->reset();
-	m_find_id_stmt->bind(1, id);
+	m_find_all_stmt->reset();
+	dbapi::cursor::ptr c = m_find_all_stmt->exec();
 
-	dbapi::cursor::ptr c = m_find_id_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::Tank::Ptr();
+	loadEach(c, v);
+}
 
-	return load(r);
+Tank::Ptr TankMapper::find(int64_t id)
+{
+	return findById(id, m_find_id_stmt);
 }
 
 Tank::Ptr TankMapper::findByName(const std::string & name)
@@ -119,9 +147,5 @@ Tank::Ptr TankMapper::findByName(const std::string & name)
 	m_find_name_stmt->bind(1, name);
 
 	dbapi::cursor::ptr c = m_find_name_stmt->exec();
-	dbapi::cursor::row_t r = c->fetchone();
-	if (r.size() == 0)
-		return logbook::Tank::Ptr();
-
-	return load(r);
+	return loadOne(c);
 }
@@ -28,6 +28,9 @@
  * WITH THE SOFTWARE.
  */
 
+#include <atomic>
+#include <mutex>
+
 #include "benthos/logbook/config.hpp"
 #include "benthos/logbook/persistent.hpp"
 #include "benthos/logbook/session.hpp"
@@ -35,7 +38,7 @@
 using namespace benthos::logbook;
 
 Persistent::Persistent()
-	: m_deleted(false), m_dirty(false), m_loading(false), m_id(-1), m_session()
+	: m_deleted(false), m_dirty(false), m_loading(false), m_id(-1), m_changed(0), m_session()
 {
 }
 
@@ -63,11 +66,26 @@ int64_t Persistent::id() const
 	return m_id;
 }
 
+bool Persistent::is_changed(const std::string & name) const
+{
+	return (m_changed == 0) || ((m_changed & attribute_mask(name)) != 0);
+}
+
 void Persistent::mark_clean()
 {
+	bool was_dirty = m_dirty;
+
 	m_deleted = false;
 	m_dirty = false;
 	m_loading = false;
+	m_changed = 0;
+
+	if (was_dirty)
+	{
+		Session::Ptr s = m_session.lock();
+		if (s)
+			s->unregister_dirty(ptr());
+	}
 }
 
 void Persistent::mark_deleted()
@@ -77,7 +95,16 @@ void Persistent::mark_deleted()
 
 void Persistent::mark_dirty()
 {
+	bool was_dirty = m_dirty;
 	m_dirty = true;
+
+	// Register with the Session the first time the object is modified
+	if (! was_dirty && ! m_loading)
+	{
+		Session::Ptr s = m_session.lock();
+		if (s)
+			s->register_dirty(ptr());
+	}
 }
 
 void Persistent::mark_loading()
@@ -85,6 +112,18 @@ void Persistent::mark_loading()
 	m_loading = true;
 }
 
+uint32_t Persistent::next_type_id()
+{
+	static std::atomic<uint32_t> s_next_id(1);
+	return s_next_id++;
+}
+
+void Persistent::on_attr_set(Ptr o, const std::string & name, const boost::any &)
+{
+	if (o)
+		o->m_changed |= o->attribute_mask(name);
+}
+
 Persistent::Ptr Persistent::ptr()
 {
 	return shared_from_this();
@@ -95,6 +134,30 @@ Persistent::CPtr Persistent::ptr() const
 	return shared_from_this();
 }
 
+LazyReference * Persistent::reference(const std::string &)
+{
+	return NULL;
+}
+
+std::vector<std::string> Persistent::reference_names() const
+{
+	return std::vector<std::string>();
+}
+
+uint64_t Persistent::register_attribute(AttributeRegistry & registry, const std::string & name)
+{
+	static std::mutex s_mutex;
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	AttributeRegistry::const_iterator it = registry.find(name);
+	if (it != registry.end())
+		return it->second;
+
+	uint64_t bit = (registry.size() < 63) ? (1ULL << registry.size()) : (1ULL << 63);
+	registry[name] = bit;
+	return bit;
+}
+
 Session::Ptr Persistent::session() const
 {
 	return m_session.lock();
@@ -116,6 +179,13 @@ void Persistent::set_session(Session::Ptr p)
 		attached(p);
 }
 
+bool Persistent::track_changes(Events & events)
+{
+	// Record changes before any other handler sees the event
+	events.attr_set.connect(boost::signals2::at_front, & Persistent::on_attr_set);
+	return true;
+}
+
 #ifdef HAVE_CXXABI_H
 #include <cxxabi.h>
 #endif
@@ -28,13 +28,15 @@
  * WITH THE SOFTWARE.
  */
 
+#include <stdexcept>
+
 #include "benthos/logbook/profile.hpp"
 #include "benthos/logbook/session.hpp"
 
 using namespace benthos::logbook;
 
 Profile::Profile()
-	: TypedPersistent<Profile>()
+	: TypedPersistent<Profile>(), m_raw_loaded(true), m_raw_size(0)
 {
 }
 
@@ -46,9 +48,9 @@ void Profile::attached(Session::Ptr s)
 {
 	Persistent::attached(s);
 
-	m_evtComputerDel = s->mapper<DiveComputer>()->events().before_delete.connect(boost::bind(& Profile::evtDiveComputerDeleted, this, _1, _2));
-	m_evtDiveDel = s->mapper<Dive>()->events().before_delete.connect(boost::bind(& Profile::evtDiveDeleted, this, _1, _2));
-	m_evtMixDel = s->mapper<Mix>()->events().before_delete.connect(boost::bind(& Profile::evtMixDeleted, this, _1, _2));
+	m_evtComputerDel = s->mapper<DiveComputer>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& Profile::evtDiveComputerDeleted, this, _1, _2)));
+	m_evtDiveDel = s->mapper<Dive>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& Profile::evtDiveDeleted, this, _1, _2)));
+	m_evtMixDel = s->mapper<Mix>()->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& Profile::evtMixDeleted, this, _1, _2)));
 }
 
 void Profile::detached(Session::Ptr s)
@@ -60,17 +62,24 @@ void Profile::detached(Session::Ptr s)
 	Persistent::detached(s);
 }
 
+void Profile::deferRawProfile(size_t size)
+{
+	m_raw.clear();
+	m_raw_loaded = false;
+	m_raw_size = size;
+}
+
 void Profile::evtDiveComputerDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 {
 	DiveComputer::Ptr o = boost::dynamic_pointer_cast<DiveComputer>(obj);
-	if (o && (o == m_computer))
+	if (o && m_computer.refers_to(o))
 		setComputer(boost::none);
 }
 
 void Profile::evtDiveDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 {
 	Dive::Ptr o = boost::dynamic_pointer_cast<Dive>(obj);
-	if (o && (o == m_dive))
+	if (o && m_dive.refers_to(o))
 		setDive(boost::none);
 }
 
@@ -91,12 +100,12 @@ void Profile::evtMixDeleted(AbstractMapper::Ptr, Persistent::Ptr obj)
 
 DiveComputer::Ptr Profile::computer() const
 {
-	return m_computer;
+	return m_computer.get();
 }
 
 Dive::Ptr Profile::dive() const
 {
-	return m_dive;
+	return m_dive.get();
 }
 
 const boost::optional<time_t> & Profile::imported() const
@@ -119,11 +128,79 @@ const std::list<waypoint> & Profile::profile() const
 	return m_profile;
 }
 
+dbapi::blob::ptr Profile::openRawProfile() const
+{
+	if (m_raw_loaded || (m_raw_size == 0))
+		return dbapi::blob::ptr();
+
+	Session::Ptr s = session();
+	if (! s || (id() == -1))
+		throw std::runtime_error("Cannot load the raw profile; the Session has expired");
+
+	return dbapi::blob::ptr(new dbapi::blob(s->conn(), "profiles", "raw_profile", id()));
+}
+
+LazyReference * Profile::reference(const std::string & name)
+{
+	if (name == "computer")
+		return & m_computer;
+	if (name == "dive")
+		return & m_dive;
+
+	return Persistent::reference(name);
+}
+
+std::vector<std::string> Profile::reference_names() const
+{
+	std::vector<std::string> names;
+	names.push_back("computer");
+	names.push_back("dive");
+	return names;
+}
+
 const std::vector<unsigned char> & Profile::raw_profile() const
 {
+	if (! m_raw_loaded)
+	{
+		// Only mark the data loaded once it has really been read
+		dbapi::blob::ptr b = openRawProfile();
+		if (b)
+			m_raw = b->read_all();
+		else
+			m_raw.clear();
+		m_raw_loaded = true;
+	}
+
 	return m_raw;
 }
 
+size_t Profile::rawProfileSize() const
+{
+	return m_raw_loaded ? m_raw.size() : m_raw_size;
+}
+
+bool Profile::rawProfileLoaded() const
+{
+	return m_raw_loaded;
+}
+
+size_t Profile::readRawProfile(void * buf, size_t n, size_t offset) const
+{
+	if (! m_raw_loaded)
+	{
+		dbapi::blob::ptr b = openRawProfile();
+		return b ? b->read(buf, n, offset) : 0;
+	}
+
+	if (offset >= m_raw.size())
+		return 0;
+	if (n > m_raw.size() - offset)
+		n = m_raw.size() - offset;
+
+	std::copy(m_raw.begin() + offset, m_raw.begin() + offset + n, static_cast<unsigned char *>(buf));
+	return n;
+}
+
 const boost::optional<std::string> & Profile::vendor() const
 {
 	return m_vendor;
@@ -220,6 +297,7 @@ void Profile::setProfile(const std::list<waypoint> & value)
 void Profile::setRawProfile(const boost::none_t &)
 {
 	m_raw.clear();
+	m_raw_loaded = true;
 	mark_dirty();
 	events().attr_set(ptr(), "raw_profile", boost::any());
 }
@@ -227,6 +305,7 @@ void Profile::setRawProfile(const boost::none_t &)
 void Profile::setRawProfile(const std::vector<unsigned char> & value)
 {
 	m_raw.assign(value.begin(), value.end());
+	m_raw_loaded = true;
 	mark_dirty();
 	events().attr_set(ptr(), "raw_profile", boost::any(value));
 }
@@ -48,8 +48,8 @@ ProxyObject::ProxyObject(Persistent::Ptr obj)
 		if (! m_mapper)
 			throw std::runtime_error("Mapper for type " + obj->type_name() + " not registered");
 
-		m_cInserted = m_mapper->events().after_insert.connect(boost::bind(& ProxyObject::on_inserted, this, _1, _2));
-		m_cDeleted = m_mapper->events().before_delete.connect(boost::bind(& ProxyObject::on_deleted, this, _1, _2));
+		m_cInserted = m_mapper->events().after_insert_batch.connect(AbstractMapper::ForEach(boost::bind(& ProxyObject::on_inserted, this, _1, _2)));
+		m_cDeleted = m_mapper->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& ProxyObject::on_deleted, this, _1, _2)));
 	}
 	else
 	{
@@ -73,8 +73,8 @@ ProxyObject::ProxyObject(AbstractMapper::Ptr m, int64_t id, Persistent::Events &
 	m_cAttached = e.attached.connect(boost::bind(& ProxyObject::on_attached, this, _1, _2));
 	m_cDetached = e.detached.connect(boost::bind(& ProxyObject::on_detached, this, _1, _2));
 
-	m_cInserted = m_mapper->events().after_insert.connect(boost::bind(& ProxyObject::on_inserted, this, _1, _2));
-	m_cDeleted = m_mapper->events().before_delete.connect(boost::bind(& ProxyObject::on_deleted, this, _1, _2));
+	m_cInserted = m_mapper->events().after_insert_batch.connect(AbstractMapper::ForEach(boost::bind(& ProxyObject::on_inserted, this, _1, _2)));
+	m_cDeleted = m_mapper->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& ProxyObject::on_deleted, this, _1, _2)));
 }
 
 ProxyObject::~ProxyObject()
@@ -162,8 +162,8 @@ void ProxyObject::on_attached(Persistent::Ptr o, Session::Ptr s)
 		if (! m_mapper)
 			throw std::runtime_error("Mapper for type " + o->type_name() + " not registered");
 
-		m_cInserted = m_mapper->events().after_insert.connect(boost::bind(& ProxyObject::on_inserted, this, _1, _2));
-		m_cDeleted = m_mapper->events().before_delete.connect(boost::bind(& ProxyObject::on_deleted, this, _1, _2));
+		m_cInserted = m_mapper->events().after_insert_batch.connect(AbstractMapper::ForEach(boost::bind(& ProxyObject::on_inserted, this, _1, _2)));
+		m_cDeleted = m_mapper->events().before_delete_batch.connect(AbstractMapper::ForEach(boost::bind(& ProxyObject::on_deleted, this, _1, _2)));
 	}
 }
 
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2011 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <cstring>
+
+#include "benthos/logbook/reference_cache.hpp"
+
+using namespace benthos::logbook;
+
+/*
+ * The connection handlers hold weak references to the cache, so a cache
+ * which is no longer used by any Logbook is released even if its handlers
+ * are still installed on a connection.
+ */
+
+struct ReferenceCache::committed_handler
+{
+	typedef void result_type;
+
+	ReferenceCache::WPtr	cache;		///< Reference Cache
+	std::string				database;	///< Database File Name
+
+	committed_handler(ReferenceCache::WPtr c, const std::string & db)
+		: cache(c), database(db)
+	{
+	}
+
+	void operator() () const
+	{
+		ReferenceCache::Ptr c = cache.lock();
+		if (c)
+			c->end_transaction(database);
+	}
+};
+
+struct ReferenceCache::rollback_handler
+{
+	typedef void result_type;
+
+	ReferenceCache::WPtr	cache;		///< Reference Cache
+	std::string				database;	///< Database File Name
+
+	rollback_handler(ReferenceCache::WPtr c, const std::string & db)
+		: cache(c), database(db)
+	{
+	}
+
+	void operator() () const
+	{
+		ReferenceCache::Ptr c = cache.lock();
+		if (c)
+			c->end_transaction(database);
+	}
+};
+
+struct ReferenceCache::update_handler
+{
+	typedef void result_type;
+
+	ReferenceCache::WPtr	cache;		///< Reference Cache
+	std::string				database;	///< Database File Name
+
+	update_handler(ReferenceCache::WPtr c, const std::string & db)
+		: cache(c), database(db)
+	{
+	}
+
+	void operator() (int, const char * dbname, const char * table, sqlite3_int64 rowid) const
+	{
+		if (std::strcmp(dbname, "main") != 0)
+			return;
+
+		ReferenceCache::Ptr c = cache.lock();
+		if (c)
+			c->invalidate(database, table, rowid);
+	}
+};
+
+ReferenceCache::ReferenceCache(size_t capacity)
+	: m_mutex(), m_capacity(capacity), m_size(0), m_lru(), m_map(), m_regions(), m_region_ids()
+{
+	std::memset(& m_stats, 0, sizeof(m_stats));
+}
+
+ReferenceCache::~ReferenceCache()
+{
+}
+
+void ReferenceCache::attach(dbapi::connection::ptr conn)
+{
+	std::string db(database(conn));
+	if (db.empty())
+		return;
+
+	WPtr self(shared_from_this());
+	conn->set_update_handler(update_handler(self, db));
+	conn->set_committed_handler(committed_handler(self, db));
+	conn->set_rollback_handler(rollback_handler(self, db));
+}
+
+size_t ReferenceCache::capacity() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_capacity;
+}
+
+void ReferenceCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_map.clear();
+	m_lru.clear();
+	m_size = 0;
+}
+
+std::string ReferenceCache::database(dbapi::connection::ptr conn)
+{
+	const char * filename = sqlite3_db_filename(conn->handle(), "main");
+	return filename ? std::string(filename) : std::string();
+}
+
+void ReferenceCache::detach(dbapi::connection::ptr conn)
+{
+	if (database(conn).empty())
+		return;
+
+	conn->set_update_handler(dbapi::connection::update_handler());
+	conn->set_committed_handler(dbapi::connection::committed_handler());
+	conn->set_rollback_handler(dbapi::connection::rollback_handler());
+}
+
+void ReferenceCache::end_transaction(const std::string & database)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	/*
+	 * This runs once the commit is visible to other connections.  Rows read
+	 * while the transaction was open may have been read from the state
+	 * before the transaction, so the generation changes again to keep put()
+	 * from caching them.
+	 */
+	std::vector<region_state>::iterator it;
+	for (it = m_regions.begin(); it != m_regions.end(); it++)
+	{
+		if (it->pending && (it->database == database))
+		{
+			it->pending = false;
+			it->generation++;
+		}
+	}
+}
+
+void ReferenceCache::evict()
+{
+	while ((m_size > m_capacity) && ! m_lru.empty())
+	{
+		const entry & e = m_lru.back();
+		m_map.erase(key_type(e.region, e.id));
+		m_size -= e.size;
+		m_lru.pop_back();
+		m_stats.n_evictions++;
+	}
+}
+
+ReferenceCache::Region ReferenceCache::find_region(const std::string & database, const std::string & table)
+{
+	std::pair<std::string, std::string> key(database, table);
+	region_map::const_iterator it = m_region_ids.find(key);
+	if (it != m_region_ids.end())
+		return it->second;
+
+	region_state r;
+	r.database = database;
+	r.table = table;
+	r.generation = 0;
+	r.pending = false;
+
+	Region id = (Region)m_regions.size();
+	m_regions.push_back(r);
+	m_region_ids[key] = id;
+	return id;
+}
+
+uint64_t ReferenceCache::generation(Region region) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_regions.at(region).generation;
+}
+
+ReferenceCache::RowPtr ReferenceCache::get(Region region, int64_t id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	map_type::iterator it = m_map.find(key_type(region, id));
+	if (it == m_map.end())
+	{
+		m_stats.n_misses++;
+		return RowPtr();
+	}
+
+	m_lru.splice(m_lru.begin(), m_lru, it->second);
+	m_stats.n_hits++;
+	return it->second->row;
+}
+
+ReferenceCache::Ptr ReferenceCache::instance()
+{
+	static ReferenceCache::Ptr s_instance(new ReferenceCache);
+	return s_instance;
+}
+
+void ReferenceCache::invalidate(const std::string & database, const std::string & table, int64_t id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	/*
+	 * Tables which have never been looked up have no cached Rows, but the
+	 * region is still marked, since a Session may look it up and read it
+	 * before this transaction is committed.
+	 */
+	Region region = find_region(database, table);
+	region_state & r = m_regions[region];
+	r.generation++;
+	r.pending = true;
+
+	map_type::iterator it = m_map.find(key_type(region, id));
+	if (it == m_map.end())
+		return;
+
+	m_size -= it->second->size;
+	m_lru.erase(it->second);
+	m_map.erase(it);
+	m_stats.n_invalidations++;
+}
+
+bool ReferenceCache::put(Region region, int64_t id, const dbapi::row_view & row, uint64_t generation)
+{
+	// Copy the Row before taking the Lock
+	boost::shared_ptr<Row> copy(new Row);
+	copy->reserve(row.column_count());
+
+	size_t size = sizeof(entry) + sizeof(Row) + 4 * sizeof(void *);
+	for (int i = 0; i < row.column_count(); i++)
+	{
+		copy->push_back(row.value(i));
+		size += sizeof(dbapi::variant);
+
+		const dbapi::variant & v = copy->back();
+		if ((v.type() == dbapi::variant::text_type) && (v.text().size > dbapi::variant::small_capacity))
+			size += v.text().size;
+		else if ((v.type() == dbapi::variant::blob_type) && (v.blob().size > dbapi::variant::small_capacity))
+			size += v.blob().size;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const region_state & r = m_regions.at(region);
+	if (r.pending || (r.generation != generation))
+	{
+		m_stats.n_rejected++;
+		return false;
+	}
+
+	key_type key(region, id);
+	map_type::iterator it = m_map.find(key);
+	if (it != m_map.end())
+	{
+		m_size -= it->second->size;
+		m_lru.erase(it->second);
+		m_map.erase(it);
+	}
+
+	entry e;
+	e.region = region;
+	e.id = id;
+	e.row = copy;
+	e.size = size;
+
+	m_lru.push_front(e);
+	m_map[key] = m_lru.begin();
+	m_size += size;
+
+	evict();
+	return m_map.find(key) != m_map.end();
+}
+
+ReferenceCache::Region ReferenceCache::region(const std::string & database, const std::string & table)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return find_region(database, table);
+}
+
+void ReferenceCache::set_capacity(size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_capacity = capacity;
+	evict();
+}
+
+ReferenceCache::Stats ReferenceCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Stats result(m_stats);
+	result.n_entries = m_map.size();
+	result.n_bytes = m_size;
+	return result;
+}
@@ -57,15 +57,15 @@ void Schema::create(dbapi::connection::ptr conn) const
 
 void Schema::drop(dbapi::connection::ptr conn) const
 {
-	conn->exec_sql("drop table computers");
-	conn->exec_sql("drop table dives");
-	conn->exec_sql("drop table divetags");
-	conn->exec_sql("drop table divetanks");
-	conn->exec_sql("drop table mixes");
-	conn->exec_sql("drop table profiles");
-	conn->exec_sql("drop table sites");
-	conn->exec_sql("drop table tanks");
-	conn->exec_sql("drop table version");
+	conn->exec_sql("drop table computers", false);
+	conn->exec_sql("drop table dives", false);
+	conn->exec_sql("drop table divetags", false);
+	conn->exec_sql("drop table divetanks", false);
+	conn->exec_sql("drop table mixes", false);
+	conn->exec_sql("drop table profiles", false);
+	conn->exec_sql("drop table sites", false);
+	conn->exec_sql("drop table tanks", false);
+	conn->exec_sql("drop table version", false);
 }
 
 void Schema::upgrade(dbapi::connection::ptr conn, int version) const
@@ -95,12 +95,12 @@ void Schema::create_computers_tbl(dbapi::connection::ptr conn) const
 		"model varchar, "
 		"hw_version varchar, "
 		"sw_version varchar "
-	")");
+	")", false);
 
 	conn->exec_sql("create unique index computers_device "
 		"on computers ("
 			"driver, serial"
-		")");
+		")", false);
 }
 
 void Schema::create_dives_tbl(dbapi::connection::ptr conn) const
@@ -143,15 +143,15 @@ void Schema::create_dives_tbl(dbapi::connection::ptr conn) const
 		"foreign key (computer_id) references computers(id) on delete set null deferrable initially deferred, "
 		"foreign key (mix_id) references mixes(id) on delete set null deferrable initially deferred, "
 		"foreign key (tank_id) references tanks(id) on delete set null deferrable initially deferred "
-	")");
+	")", false);
 
-	conn->exec_sql("create index dive_site on dives (site_id)");
-	conn->exec_sql("create index dive_computer on dives (computer_id)");
-	conn->exec_sql("create index dive_mix on dives (mix_id)");
-	conn->exec_sql("create index dive_tank on dives (tank_id)");
+	conn->exec_sql("create index dive_site on dives (site_id)", false);
+	conn->exec_sql("create index dive_computer on dives (computer_id)", false);
+	conn->exec_sql("create index dive_mix on dives (mix_id)", false);
+	conn->exec_sql("create index dive_tank on dives (tank_id)", false);
 
-	conn->exec_sql("create index dive_datetime on dives (dive_datetime)");
-	conn->exec_sql("create index dive_number on dives (dive_number)");
+	conn->exec_sql("create index dive_datetime on dives (dive_datetime)", false);
+	conn->exec_sql("create index dive_number on dives (dive_number)", false);
 }
 
 void Schema::create_divetags_tbl(dbapi::connection::ptr conn) const
@@ -160,11 +160,11 @@ void Schema::create_divetags_tbl(dbapi::connection::ptr conn) const
 		"dive_id integer not null, "
 		"tag varchar not null, "
 		"foreign key (dive_id) references dives(id) on delete cascade deferrable initially deferred"
-	")");
+	")", false);
 
-	conn->exec_sql("create unique index divetags_index on divetags (dive_id, tag)");
-	conn->exec_sql("create index divetags_dive on divetags (dive_id)");
-	conn->exec_sql("create index divetags_tag on divetags (tag)");
+	conn->exec_sql("create unique index divetags_index on divetags (dive_id, tag)", false);
+	conn->exec_sql("create index divetags_dive on divetags (dive_id)", false);
+	conn->exec_sql("create index divetags_tag on divetags (tag)", false);
 }
 
 void Schema::create_divetanks_tbl(dbapi::connection::ptr conn) const
@@ -180,13 +180,13 @@ void Schema::create_divetanks_tbl(dbapi::connection::ptr conn) const
 		"foreign key (dive_id) references dives(id) on delete cascade deferrable initially deferred, "
 		"foreign key (tank_id) references tanks(id) on delete set null deferrable initially deferred, "
 		"foreign key (mix_id) references mixes(id) on delete set null deferrable initially deferred"
-	")");
+	")", false);
 
-	conn->exec_sql("create unique index divetanks_index on divetanks (dive_id, tank_idx)");
-	conn->exec_sql("create index divetanks_dive on divetanks(dive_id)");
-	conn->exec_sql("create index divetanks_idx on divetanks(tank_idx)");
-	conn->exec_sql("create index divetanks_tank on divetanks(tank_id)");
-	conn->exec_sql("create index divetanks_mix on divetanks(mix_id)");
+	conn->exec_sql("create unique index divetanks_index on divetanks (dive_id, tank_idx)", false);
+	conn->exec_sql("create index divetanks_dive on divetanks(dive_id)", false);
+	conn->exec_sql("create index divetanks_idx on divetanks(tank_idx)", false);
+	conn->exec_sql("create index divetanks_tank on divetanks(tank_id)", false);
+	conn->exec_sql("create index divetanks_mix on divetanks(mix_id)", false);
 }
 
 void Schema::create_mixes_tbl(dbapi::connection::ptr conn) const
@@ -199,7 +199,7 @@ void Schema::create_mixes_tbl(dbapi::connection::ptr conn) const
 		"h2 integer not null default 0, "
 		"ar integer not null default 0, "
 		"check (o2 + he + h2 + ar <= 1000)"
-	")");
+	")", false);
 }
 
 void Schema::create_profiles_tbl(dbapi::connection::ptr conn) const
@@ -215,11 +215,11 @@ void Schema::create_profiles_tbl(dbapi::connection::ptr conn) const
 		"raw_profile blob, "
 		"foreign key (dive_id) references dives(id) on delete set null deferrable initially deferred, "
 		"foreign key (computer_id) references computers(id) on delete set null deferrable initially deferred"
-	")");
+	")", false);
 
-	conn->exec_sql("create unique index profiles_device on profiles (dive_id, computer_id)");
-	conn->exec_sql("create index profiles_dive on profiles (dive_id)");
-	conn->exec_sql("create index profiles_computer on profiles (computer_id)");
+	conn->exec_sql("create unique index profiles_device on profiles (dive_id, computer_id)", false);
+	conn->exec_sql("create index profiles_dive on profiles (dive_id)", false);
+	conn->exec_sql("create index profiles_computer on profiles (computer_id)", false);
 }
 
 void Schema::create_sites_tbl(dbapi::connection::ptr conn) const
@@ -238,7 +238,7 @@ void Schema::create_sites_tbl(dbapi::connection::ptr conn) const
 		"salinity varchar check (salinity in (\"fresh\",\"salt\")), "
 		"timezone varchar, "
 		"comments text"
-	")");
+	")", false);
 }
 
 void Schema::create_tanks_tbl(dbapi::connection::ptr conn) const
@@ -249,7 +249,7 @@ void Schema::create_tanks_tbl(dbapi::connection::ptr conn) const
 		"type varchar check (type in (\"aluminum\",\"steel\")), "
 		"pressure float check (pressure >= 1), "
 		"volume float check (volume >= 0)"
-	")");
+	")", false);
 }
 
 void Schema::create_version_tbl(dbapi::connection::ptr conn) const
@@ -259,10 +259,10 @@ void Schema::create_version_tbl(dbapi::connection::ptr conn) const
 		"program varchar, "
 		"version integer, "
 		"schema integer not null"
-	")");
+	")", false);
 
 	// Fill in the singleton row with the creator, library version and schema version
-	dbapi::statement::ptr s(new dbapi::statement(conn, "insert into version values (?1, ?2, ?3)"));
+	dbapi::statement::ptr s = conn->prepare("insert into version values (?1, ?2, ?3)");
 	s->bind(1);
 	s->bind(2);
 	s->bind(3, SCHEMA_VERSION);
@@ -273,13 +273,13 @@ void Schema::create_version_tbl(dbapi::connection::ptr conn) const
 		"before insert on version "
 		"begin "
 			"select raise(ABORT, 'Cannot insert rows into table \"version\"'); "
-		"end");
+		"end", false);
 
 	conn->exec_sql("create trigger version_delete "
 		"before delete on version "
 		"begin "
 			"select raise(ABORT, 'Cannot delete rows from table \"version\"');"
-		"end");
+		"end", false);
 }
 
 
@@ -43,22 +43,27 @@
 using namespace benthos::logbook;
 
 Session::Session(connection::ptr conn)
-	: m_conn(conn), m_mappers(), m_logger(logging::getLogger("orm.session"))
+	: m_conn(conn), m_mappers(), m_logger(logging::getLogger("orm.session")),
+	  m_readonly(conn->is_readonly()), m_new(), m_deleted(), m_dirty(), m_idmap(), m_order(),
+	  m_nmarked(0), m_nupdated(0), m_refcache(), m_refdb()
 {
 	// Ensure Foreign Key Checks are enabled
-	m_conn->exec_sql("pragma foreign_keys=1");
+	m_conn->exec_sql("pragma foreign_keys=1", false);
 
-	// Prepare Savepoint Statements
-	char hash[100];
-	sprintf(hash, "__session_flush_%p", this);
-	std::string spname(hash);
+	/*
+	 * Prepare Savepoint Statements.  The savepoint name is the same for all
+	 * sessions so that the statements can be reused from the connection's
+	 * statement cache; SQLite resolves duplicate names to the innermost
+	 * savepoint, so this is safe even if flushes were ever nested.
+	 */
+	std::string spname("__session_flush");
 	std::string _begin("SAVEPOINT ");
 	std::string _release("RELEASE SAVEPOINT ");
 	std::string _rollback("ROLLBACK TO SAVEPOINT ");
 
-	m_beginsp = statement::ptr(new statement(m_conn, _begin + spname));
-	m_releasesp = statement::ptr(new statement(m_conn, _release + spname));
-	m_rollbacksp = statement::ptr(new statement(m_conn, _rollback + spname));
+	m_beginsp = m_conn->prepare(_begin + spname);
+	m_releasesp = m_conn->prepare(_release + spname);
+	m_rollbacksp = m_conn->prepare(_rollback + spname);
 }
 
 Session::Ptr Session::Create(connection::ptr conn)
@@ -94,6 +99,9 @@ void Session::add(Persistent::Ptr p)
 	if (! p)
 		return;
 
+	if (m_readonly)
+		throw std::runtime_error("Cannot add objects to a read-only Session");
+
 	if (m_mappers.find(p->type_info()) == m_mappers.end())
 		throw std::runtime_error(std::string("No mapper found for class ") + p->type_name());
 
@@ -113,15 +121,19 @@ void Session::attach(Persistent::Ptr p)
 	if (p->session() && (p->session().get() != this))
 		throw std::runtime_error("Object is already registered with a different Session");
 
-	id_key_type key(p->type_info(), p->id());
-	if ((p->id() != -1) && (m_idmap.find(key) != m_idmap.end()) &&
-		! m_idmap[key].expired() && (m_idmap[key].lock() != p))
+	Persistent::Ptr e = (p->id() != -1) ? m_idmap.find(p->type_id(), p->id()) : Persistent::Ptr();
+	if (e && (e != p))
 	{
 		throw std::runtime_error("Cannot register instance; another instance with "
 				"the same key is already registered");
 	}
 
 	set_persistent_session(p, shared_from_this());
+
+	// Objects modified while detached are registered as dirty on attachment
+	if ((p->id() != -1) && p->is_dirty() && ! p->is_loading())
+		register_dirty(p);
+
 	m_events.after_attach(shared_from_this(), p);
 }
 
@@ -133,6 +145,138 @@ void Session::begin()
 		throw std::runtime_error("A transaction is already active");
 }
 
+size_t Session::bulk_import(const AbstractMapper::Batch & objects, bool keep, bool defer_fk)
+{
+	if (objects.empty())
+		return 0;
+
+	if (m_readonly)
+		throw std::runtime_error("Cannot import objects into a read-only Session");
+
+	/*
+	 * Collect the new objects along with the new objects they refer to.  A
+	 * shared reference such as a Mix or Dive Site is visited once no matter
+	 * how many objects in the batch refer to it.
+	 */
+	std::set<Persistent::Ptr> seen;
+	std::list<Persistent::Ptr> pending(objects.begin(), objects.end());
+	AbstractMapper::Batch imported;
+
+	const flush_order_map & order = flush_order();
+	flush_plan groups(order.size());
+
+	flush_order_map::const_iterator oit;
+	for (oit = order.begin(); oit != order.end(); oit++)
+		groups[oit->second].mapper = m_mappers[oit->first];
+
+	while (! pending.empty())
+	{
+		Persistent::Ptr p = pending.front();
+		pending.pop_front();
+
+		if (! p || (p->id() != -1) || ! seen.insert(p).second)
+			continue;
+
+		if (p->session() && (p->session().get() != this))
+			throw std::runtime_error("Object is already registered with a different Session");
+
+		oit = order.find(p->type_info());
+		if ((oit == order.end()) || ! groups[oit->second].mapper)
+			throw std::runtime_error(std::string("No mapper found for class ") + p->type_name());
+
+		flush_group & g = groups[oit->second];
+		g.inserted.push_back(p);
+		imported.push_back(p);
+
+		std::list<Persistent::Ptr> refs = g.mapper->references(p);
+		pending.insert(pending.end(), refs.begin(), refs.end());
+	}
+
+	flush_plan plan;
+	flush_plan::iterator git;
+	for (git = groups.begin(); git != groups.end(); git++)
+		if (! git->inserted.empty())
+			plan.push_back(* git);
+
+	m_logger->debug("Importing %u objects in %u groups", imported.size(), plan.size());
+
+	/*
+	 * Foreign key enforcement can only be switched off outside a transaction;
+	 * within one the checks are deferred to the commit instead.  Either way
+	 * the imported tables are validated before the import is released.
+	 */
+	bool own_txn = ! m_conn->transaction_active();
+	bool fk_off = defer_fk && own_txn;
+
+	if (fk_off)
+		m_conn->exec_sql("pragma foreign_keys=0", false);
+	else if (defer_fk)
+		m_conn->exec_sql("pragma defer_foreign_keys=1", false);
+
+	try
+	{
+		if (own_txn)
+			m_conn->begin();
+		m_beginsp->exec();
+
+		try
+		{
+			run_flush(plan);
+			if (defer_fk)
+				check_foreign_keys(plan);
+			m_releasesp->exec();
+		}
+		catch (std::exception & e)
+		{
+			m_rollbacksp->exec();
+			throw;
+		}
+
+		if (own_txn)
+			m_conn->commit();
+	}
+	catch (std::exception & e)
+	{
+		if (own_txn)
+			rollback();
+		if (fk_off)
+			m_conn->exec_sql("pragma foreign_keys=1", false);
+
+		// Return the objects to the transient state
+		AbstractMapper::Batch::iterator it;
+		for (it = imported.begin(); it != imported.end(); it++)
+		{
+			m_idmap.erase(* it);
+			set_persistent_id(* it, -1);
+		}
+
+		throw;
+	}
+
+	if (fk_off)
+		m_conn->exec_sql("pragma foreign_keys=1", false);
+
+	/*
+	 * Only objects which stay with the Session are attached, which connects
+	 * their event handlers; the rest are left detached and are dropped from
+	 * the identity map so that nothing outlives the caller's references.
+	 */
+	AbstractMapper::Batch::iterator it;
+	for (it = imported.begin(); it != imported.end(); it++)
+	{
+		mark_persistent_clean(* it);
+
+		if ((* it)->session())
+			m_new.erase(* it);
+		else if (keep)
+			attach(* it);
+		else
+			m_idmap.erase(* it);
+	}
+
+	return imported.size();
+}
+
 typedef std::list<Persistent::Ptr> (AbstractMapper::*pmfCascade)(Persistent::Ptr);
 
 void walk_cascade_tree(Persistent::Ptr p, std::set<Persistent::Ptr> & set_, pmfCascade fn, Session::Ptr s, logging::logger * l)
@@ -187,6 +331,27 @@ std::list<Persistent::Ptr> Session::cascade_detach(Persistent::Ptr p)
 	return std::list<Persistent::Ptr>(result.begin(), result.end());
 }
 
+void Session::check_foreign_keys(const flush_plan & plan)
+{
+	flush_plan::const_iterator it;
+	for (it = plan.begin(); it != plan.end(); it++)
+	{
+		std::string table(it->mapper->tableName());
+		if (table.empty())
+			continue;
+
+		statement::ptr s = m_conn->prepare("pragma foreign_key_check(" + table + ")", false);
+		cursor::ptr c = s->exec();
+		if (c->at_end())
+			continue;
+
+		char msg[255];
+		sprintf(msg, "Foreign key violation in %s[%ld]: no matching row in %s",
+			table.c_str(), c->current().as<int64_t>(1), c->current().as<std::string>(2).c_str());
+		throw std::runtime_error(std::string(msg));
+	}
+}
+
 void Session::commit()
 {
 	if (! m_conn->transaction_active())
@@ -201,6 +366,9 @@ void Session::delete_(Persistent::Ptr p)
 	if (! p)
 		return;
 
+	if (m_readonly)
+		throw std::runtime_error("Cannot delete objects from a read-only Session");
+
 	if (m_mappers.find(p->type_info()) == m_mappers.end())
 		throw std::runtime_error(std::string("No mapper found for class ") + p->type_name());
 
@@ -212,22 +380,20 @@ void Session::delete_(Persistent::Ptr p)
 
 	attach(p);
 
-	id_key_type key(p->type_info(), p->id());
 	std::list<Persistent::Ptr> cascade = cascade_delete(p);
 	std::list<Persistent::Ptr>::iterator it;
 
 	m_deleted.insert(p);
-	m_idmap.insert(std::pair<id_key_type, Persistent::WeakPtr>(key, Persistent::WeakPtr(p)));
+	m_idmap.insert(p);
 
 	for (it = cascade.begin(); it != cascade.end(); it++)
 	{
-		id_key_type itkey((* it)->type_info(), (* it)->id());
 		if (((* it)->id() == -1) || (m_deleted.find(* it) != m_deleted.end()))
 			continue;
 
 		attach(* it);
 		m_deleted.insert(* it);
-		m_idmap.insert(std::pair<id_key_type, Persistent::WeakPtr>(key, Persistent::WeakPtr(* it)));
+		m_idmap.insert(* it);
 	}
 }
 
@@ -242,6 +408,8 @@ void Session::detach(Persistent::Ptr p)
 		return;
 
 
+	m_dirty.erase(p);
+
 	if ((p->id() == -1) && (m_new.find(p) != m_new.end()))
 	{
 		m_new.erase(p);
@@ -250,8 +418,7 @@ void Session::detach(Persistent::Ptr p)
 		return;
 	}
 
-	id_key_type key(p->type_info(), p->id());
-	m_idmap.erase(key);
+	m_idmap.erase(p);
 	m_deleted.erase(p);
 
 	m_events.before_detach(shared_from_this(), p);
@@ -261,20 +428,21 @@ void Session::detach(Persistent::Ptr p)
 uow_registry Session::dirty() const
 {
 	uow_registry dirty;
-	identity_map::const_iterator it;
-	for (it = m_idmap.begin(); it != m_idmap.end(); it++)
+	uow_registry::const_iterator it;
+	for (it = m_dirty.begin(); it != m_dirty.end(); it++)
 	{
-		if (it->first.second == -1)
-			m_logger->warning("Found identity map entry with key of -1");
-
-		Persistent::Ptr p(it->second.lock());
-		if (p && (m_deleted.find(p) == m_deleted.end()) && p->is_dirty())
-			dirty.insert(p);
+		if ((m_deleted.find(* it) == m_deleted.end()) && (m_new.find(* it) == m_new.end()) && (* it)->is_dirty())
+			dirty.insert(* it);
 	}
 
 	return dirty;
 }
 
+size_t Session::dirty_count() const
+{
+	return m_dirty.size();
+}
+
 Session::Events & Session::events()
 {
 	return m_events;
@@ -291,7 +459,6 @@ void Session::expunge(Persistent::Ptr p)
 	if (! p->session() || (p->session().get() != this))
 		throw std::runtime_error("Object is not present within this session");
 
-	id_key_type key(p->type_info(), p->id());
 	std::list<Persistent::Ptr> cascade = cascade_detach(p);
 	std::list<Persistent::Ptr>::iterator it;
 
@@ -300,12 +467,12 @@ void Session::expunge(Persistent::Ptr p)
 		detach(* it);
 }
 
-void Session::finalize_flush(std::list<Persistent::Ptr> & objects)
+void Session::finalize_flush(AbstractMapper::Batch & objects)
 {
-	std::list<Persistent::Ptr>::iterator it;
+	AbstractMapper::Batch::iterator it;
 	for (it = objects.begin(); it != objects.end(); it++)
 	{
-		id_key_type key((* it)->type_info(), (* it)->id());
+		m_dirty.erase(* it);
 
 		if (m_deleted.find(* it) != m_deleted.end())
 		{
@@ -314,7 +481,7 @@ void Session::finalize_flush(std::list<Persistent::Ptr> & objects)
 			set_persistent_session(* it, Ptr());
 			mark_persistent_deleted(* it);
 
-			m_idmap.erase(key);
+			m_idmap.erase(* it);
 			m_deleted.erase(* it);
 		}
 		else if (m_new.find(* it) != m_new.end())
@@ -326,7 +493,7 @@ void Session::finalize_flush(std::list<Persistent::Ptr> & objects)
 
 			mark_persistent_clean(* it);
 
-			m_idmap.insert(std::pair<id_key_type, Persistent::WeakPtr>(key, Persistent::WeakPtr(* it)));
+			m_idmap.insert(* it);
 			m_new.erase(* it);
 		}
 		else
@@ -336,6 +503,80 @@ void Session::finalize_flush(std::list<Persistent::Ptr> & objects)
 	}
 }
 
+void Session::finalize_flush(flush_plan & plan)
+{
+	flush_plan::iterator it;
+	for (it = plan.begin(); it != plan.end(); it++)
+	{
+		finalize_flush(it->deleted);
+		finalize_flush(it->inserted);
+		finalize_flush(it->updated);
+	}
+}
+
+const flush_order_map & Session::flush_order()
+{
+	if (! m_order.empty())
+		return m_order;
+
+	std::map<const_typeinfo_ptr, size_t, typecmp> indegree;
+	std::map<const_typeinfo_ptr, std::list<const_typeinfo_ptr>, typecmp> dependents;
+
+	mapper_registry::const_iterator it;
+	for (it = m_mappers.begin(); it != m_mappers.end(); it++)
+	{
+		indegree[it->first] += 0;
+		if (! it->second)
+			continue;
+
+		std::vector<const_typeinfo_ptr> deps = it->second->dependencies();
+		std::vector<const_typeinfo_ptr>::const_iterator dit;
+		for (dit = deps.begin(); dit != deps.end(); dit++)
+		{
+			// Self-references and unmapped classes do not constrain the order
+			if ((** dit == * it->first) || (m_mappers.find(* dit) == m_mappers.end()))
+				continue;
+
+			indegree[it->first]++;
+			dependents[* dit].push_back(it->first);
+		}
+	}
+
+	std::list<const_typeinfo_ptr> ready;
+	std::map<const_typeinfo_ptr, size_t, typecmp>::const_iterator iit;
+	for (iit = indegree.begin(); iit != indegree.end(); iit++)
+		if (iit->second == 0)
+			ready.push_back(iit->first);
+
+	while (! ready.empty())
+	{
+		const_typeinfo_ptr ti = ready.front();
+		ready.pop_front();
+
+		size_t rank = m_order.size();
+		m_order[ti] = rank;
+
+		std::list<const_typeinfo_ptr>::const_iterator dit;
+		for (dit = dependents[ti].begin(); dit != dependents[ti].end(); dit++)
+			if (--indegree[* dit] == 0)
+				ready.push_back(* dit);
+	}
+
+	if (m_order.size() != indegree.size())
+	{
+		m_order.clear();
+		throw std::runtime_error("Mapper dependencies contain a cycle; cannot order the flush");
+	}
+
+	m_logger->debug("Computed flush order for %u mapped classes", m_order.size());
+	return m_order;
+}
+
+Persistent::Ptr Session::find_loaded(uint32_t type_id, int64_t id)
+{
+	return m_idmap.find(type_id, id);
+}
+
 void Session::flush()
 {
 	logging::logger * l = logging::getLogger("session");
@@ -346,19 +587,23 @@ void Session::flush()
 	if (m_new.empty() && m_deleted.empty() && dirty_.empty())
 		return;
 
+	if (m_readonly)
+		throw std::runtime_error("Cannot flush changes from a read-only Session");
+
 	m_logger->debug("Calling Session::flush with %u insertions, %u deletions and %u updates",
 		m_new.size(), m_deleted.size(), dirty_.size());
 
 	objs.insert(m_deleted.begin(), m_deleted.end());
 	objs.insert(m_new.begin(), m_new.end());
 	objs.insert(dirty_.begin(), dirty_.end());
+	size_t nupdated = dirty_.size();
 
 	/*
-	 * The idea here is to do a topological sort on all updates but maintaining
-	 * the delete-insert-update order so that updates to foreign keys persist
-	 * correctly in one shot.
+	 * Group the changes by mapper in dependency order, maintaining the
+	 * delete-insert-update order within each group so that updates to foreign
+	 * keys persist correctly in one shot.
 	 */
-	std::list<Persistent::Ptr> updates = sort(objs);
+	flush_plan plan = plan_flush(objs);
 
 	/*
 	 * Ensure the flush() call executes in a savepoint so that if there is an
@@ -367,10 +612,12 @@ void Session::flush()
 	try
 	{
 		m_beginsp->exec();
-		run_flush(updates);
-		finalize_flush(updates);
-		prune();
+		run_flush(plan);
+		finalize_flush(plan);
 		m_releasesp->exec();
+
+		// Only count updates which were actually written
+		m_nupdated += nupdated;
 	}
 	catch (std::exception & e)
 	{
@@ -379,25 +626,123 @@ void Session::flush()
 	}
 }
 
+Persistent::Ptr Session::get(const std::type_info & type, uint32_t type_id, int64_t id)
+{
+	// Lazy loads must not race with an executor which owns the Session
+	m_conn->check_thread();
+
+	Persistent::Ptr result = m_idmap.find(type_id, id);
+	if (result)
+		return result;
+
+	mapper_registry::const_iterator it = m_mappers.find(& type);
+	if ((it == m_mappers.end()) || ! it->second)
+		throw std::runtime_error(std::string("No mapper found for class ") + type.name());
+
+	AbstractMapper::Batch b = it->second->loadByIds(std::vector<int64_t>(1, id));
+	return b.empty() ? Persistent::Ptr() : b.front();
+}
+
 uow_registry Session::new_() const
 {
 	return m_new;
 }
 
-void Session::prune()
+size_t Session::prefetch(const AbstractMapper::Batch & objects)
 {
-	ssize_t sl = m_idmap.size();
+	std::set<std::string> names;
+	AbstractMapper::Batch::const_iterator it;
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		if (! * it)
+			continue;
+
+		std::vector<std::string> n = (* it)->reference_names();
+		names.insert(n.begin(), n.end());
+	}
 
-	identity_map::iterator it;
-	for (it = m_idmap.begin(); it != m_idmap.end(); )
+	size_t nloaded = 0;
+	std::set<std::string>::const_iterator nit;
+	for (nit = names.begin(); nit != names.end(); nit++)
 	{
-		if (it->second.expired())
-			it = m_idmap.erase(it);
+		AbstractMapper::Batch refs;
+		for (it = objects.begin(); it != objects.end(); it++)
+			if (* it && (* it)->reference(* nit))
+				refs.push_back(* it);
+
+		nloaded += prefetch(refs, * nit);
+	}
+
+	return nloaded;
+}
+
+size_t Session::prefetch(const AbstractMapper::Batch & objects, const std::string & name)
+{
+	m_conn->check_thread();
+
+	typedef std::map<int64_t, std::list<LazyReference *> > pending_refs;
+	std::map<const_typeinfo_ptr, pending_refs, typecmp> pending;
+
+	AbstractMapper::Batch::const_iterator it;
+	for (it = objects.begin(); it != objects.end(); it++)
+	{
+		if (! * it)
+			continue;
+
+		LazyReference * r = (* it)->reference(name);
+		if (! r)
+			throw std::runtime_error((* it)->type_name() + " has no reference named " + name);
+
+		if (r->is_loaded())
+			continue;
+
+		Persistent::Ptr e = m_idmap.find(r->type_id(), * r->id());
+		if (e)
+			r->resolve(e);
 		else
-			++it;
+			pending[& r->type()][* r->id()].push_back(r);
 	}
 
-	m_logger->debug("Pruned identity map (currently %u items, removed %u expired pointers)", m_idmap.size(), sl - m_idmap.size());
+	size_t nloaded = 0;
+	std::map<const_typeinfo_ptr, pending_refs, typecmp>::iterator pit;
+	for (pit = pending.begin(); pit != pending.end(); pit++)
+	{
+		mapper_registry::const_iterator mit = m_mappers.find(pit->first);
+		if ((mit == m_mappers.end()) || ! mit->second)
+			throw std::runtime_error(std::string("No mapper found for class ") + pit->first->name());
+
+		std::vector<int64_t> ids;
+		pending_refs::const_iterator rit;
+		for (rit = pit->second.begin(); rit != pit->second.end(); rit++)
+			ids.push_back(rit->first);
+
+		// References to rows which do not exist stay unresolved
+		AbstractMapper::Batch loaded = mit->second->loadByIds(ids);
+		AbstractMapper::Batch::const_iterator lit;
+		for (lit = loaded.begin(); lit != loaded.end(); lit++)
+		{
+			std::list<LazyReference *> & refs = pit->second[(* lit)->id()];
+			std::list<LazyReference *>::iterator r;
+			for (r = refs.begin(); r != refs.end(); r++)
+				(* r)->resolve(* lit);
+		}
+
+		nloaded += loaded.size();
+	}
+
+	return nloaded;
+}
+
+Session::Stats Session::stats() const
+{
+	Stats s;
+	s.n_dirty = m_dirty.size();
+	s.n_new = m_new.size();
+	s.n_deleted = m_deleted.size();
+	s.n_identity = m_idmap.size();
+	s.total_marked = m_nmarked;
+	s.total_updated = m_nupdated;
+	return s;
 }
 
 void Session::rollback()
@@ -406,6 +751,12 @@ void Session::rollback()
 		m_conn->rollback();
 }
 
+void Session::set_reference_cache(ReferenceCache::Ptr cache)
+{
+	m_refdb = cache ? ReferenceCache::database(m_conn) : std::string();
+	m_refcache = m_refdb.empty() ? ReferenceCache::Ptr() : cache;
+}
+
 void Session::register_(Persistent::Ptr p)
 {
 	if (! p)
@@ -417,20 +768,29 @@ void Session::register_(Persistent::Ptr p)
 		register_update(p);
 }
 
+void Session::register_dirty(Persistent::Ptr p)
+{
+	if (! p || (p->session().get() != this))
+		return;
+
+	if (m_dirty.insert(p).second)
+		m_nmarked++;
+}
+
 void Session::register_loaded(Persistent::Ptr p)
 {
 	if (! p)
 		return;
 
-	id_key_type key(p->type_info(), p->id());
-	if ((m_idmap.find(key) != m_idmap.end()) && (! m_idmap[key].expired()) && (m_idmap[key].lock() != p))
+	Persistent::Ptr e = m_idmap.find(p->type_id(), p->id());
+	if (e && (e != p))
 	{
 		char msg[255];
 		sprintf(msg, "Stale data detected in Identity Map: %s[%ld]", p->type_name().c_str(), p->id());
 		throw std::runtime_error(std::string(msg));
 	}
 
-	m_idmap.insert(std::pair<id_key_type, Persistent::WeakPtr>(key, Persistent::WeakPtr(p)));
+	m_idmap.insert(p);
 }
 
 void Session::register_new(Persistent::Ptr p)
@@ -455,8 +815,7 @@ void Session::register_update(Persistent::Ptr p)
 	if (p->id() == -1)
 		throw std::runtime_error("Object is not persisted");
 
-	id_key_type key(p->type_info(), p->id());
-	if ((m_idmap.find(key) != m_idmap.end()) && (m_deleted.find(p) == m_deleted.end()))
+	if (m_idmap.find(p->type_id(), p->id()) && (m_deleted.find(p) == m_deleted.end()))
 		return;
 
 	if (p->is_deleted())
@@ -465,88 +824,64 @@ void Session::register_update(Persistent::Ptr p)
 
 	attach(p);
 	m_deleted.erase(p);
-	m_idmap.insert(std::pair<id_key_type, Persistent::WeakPtr>(key, Persistent::WeakPtr(p)));
+	m_idmap.insert(p);
 }
 
-void Session::run_flush(std::list<Persistent::Ptr> & objects)
+void Session::unregister_dirty(Persistent::Ptr p)
 {
-	std::list<Persistent::Ptr>::iterator it;
-	for (it = objects.begin(); it != objects.end(); it++)
+	m_dirty.erase(p);
+}
+
+void Session::run_flush(flush_plan & plan)
+{
+	/*
+	 * Each group is executed as one batch per operation, so the mapper raises
+	 * its batch events once per group rather than once per object.
+	 */
+	flush_plan::iterator it;
+	for (it = plan.begin(); it != plan.end(); it++)
 	{
-		AbstractMapper::Ptr mapper(m_mappers[(* it)->type_info()]);
-		if (! mapper)
-			throw std::runtime_error(std::string("No mapper found for class ") + (* it)->type_name());
+		m_logger->debug("Flushing group %u with %u deletions, %u insertions and %u updates",
+			it - plan.begin(), it->deleted.size(), it->inserted.size(), it->updated.size());
 
-		if (m_deleted.find(* it) != m_deleted.end())
-		{
-			m_logger->debug("Calling remove() on %s[%d]", (* it)->type_name().c_str(), (* it)->id());
-			mapper->remove(* it);
-		}
-		else if (m_new.find(* it) != m_new.end())
-		{
-			m_logger->debug("Calling insert() on %s[%p]", (* it)->type_name().c_str(), (* it).get());
-			mapper->insert(* it);
-		}
-		else
-		{
-			m_logger->debug("Calling update() on %s[%d]", (* it)->type_name().c_str(), (* it)->id());
-			mapper->update(* it);
-		}
+		it->mapper->removeAll(it->deleted);
+		it->mapper->insertAll(it->inserted);
+		it->mapper->updateAll(it->updated);
 	}
 }
 
-std::list<Persistent::Ptr> Session::sort(const uow_registry & registry) const
+flush_plan Session::plan_flush(const uow_registry & registry)
 {
-	m_logger->debug("Sorting %u items in Session::sort()", registry.size());
-
-	/*
-	 * Hard-coded, inefficient topological sort.  This should be adequate for
-	 * most use cases but can certainly be improved.
-	 */
+	const flush_order_map & order = flush_order();
+	flush_plan groups(order.size());
 
-	std::list<Persistent::Ptr>::iterator it;
-	std::list<Persistent::Ptr> items(registry.begin(), registry.end());
-	std::list<Persistent::Ptr> result;
+	flush_order_map::const_iterator oit;
+	for (oit = order.begin(); oit != order.end(); oit++)
+		groups[oit->second].mapper = m_mappers[oit->first];
 
-	// Scan for Mix/Tank/DiveSite/DiveComputer
-	for (it = items.begin(); it != items.end(); )
+	uow_registry::const_iterator it;
+	for (it = registry.begin(); it != registry.end(); it++)
 	{
-		if (((* it)->type_info() == (& typeid(Mix))) ||
-			((* it)->type_info() == (& typeid(Tank))) ||
-			((* it)->type_info() == (& typeid(DiveSite))) ||
-			((* it)->type_info() == (& typeid(DiveComputer))))
-		{
-			result.push_back(* it);
-			it = items.erase(it);
-		}
-		else
-		{
-			++it;
-		}
-	}
+		oit = order.find((* it)->type_info());
+		if ((oit == order.end()) || ! groups[oit->second].mapper)
+			throw std::runtime_error(std::string("No mapper found for class ") + (* it)->type_name());
 
-	// Scan for Dive
-	for (it = items.begin(); it != items.end(); )
-	{
-		if ((* it)->type_info() == (& typeid(Dive)))
-		{
-			result.push_back(* it);
-			it = items.erase(it);
-		}
+		flush_group & g = groups[oit->second];
+		if (m_deleted.find(* it) != m_deleted.end())
+			g.deleted.push_back(* it);
+		else if (m_new.find(* it) != m_new.end())
+			g.inserted.push_back(* it);
 		else
-		{
-			++it;
-		}
+			g.updated.push_back(* it);
 	}
 
-	// Append remainder of the Items (Profiles, others)
-	for (it = items.begin(); it != items.end(); it++)
-		result.push_back(* it);
-
-	// Print how many items we ended up with
-	m_logger->debug("Sorted %u items in Session::sort()", result.size());
+	// Drop the groups with nothing to flush
+	flush_plan result;
+	flush_plan::iterator git;
+	for (git = groups.begin(); git != groups.end(); git++)
+		if (! git->deleted.empty() || ! git->inserted.empty() || ! git->updated.empty())
+			result.push_back(* git);
 
-	// Return sorted list
-	items.clear();
+	m_logger->debug("Planned flush of %u items in %u groups", registry.size(), result.size());
 	return result;
 }